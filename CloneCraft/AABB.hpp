@@ -17,6 +17,17 @@ public:
         dimensions = dim;
     }
 
+    bool IsEmpty() const {
+        return dimensions.x <= 0 || dimensions.y <= 0 || dimensions.z <= 0;
+    }
+
+    // boxes that only touch along a side don't count
+    bool Intersects(const AABB& other) const {
+        return position.x < other.position.x + other.dimensions.x && other.position.x < position.x + dimensions.x &&
+               position.y < other.position.y + other.dimensions.y && other.position.y < position.y + dimensions.y &&
+               position.z < other.position.z + other.dimensions.z && other.position.z < position.z + dimensions.z;
+    }
+
     bool operator==(const AABB& other) const {
         return position == other.position && dimensions == other.dimensions;
     }
@@ -46,17 +46,41 @@ namespace AppGlobals {
 	static int seed = -1;
 	static unsigned short renderDistance = 3; // render distance in chunks
 	static unsigned short asyncNumChunksPerFrame = 2; // max number of chunks to load per frame
+	static float tickRate = 60.0f; // game ticks per second. movement and physics always step by one tick however fast frames are drawn
+	static int maxTicksPerFrame = 5; // ticks a slow frame can run to catch up before the rest of its time is dropped
 	static float playerSpeed = 5.0f;
 	static float gravity = -9.81f * playerSpeed;
 	static float buildRange = 5.0f;
 	static float jumpHeight = 1.5f; // 1.5 blocks high
 	static float mouseSensitivity = 0.05f;
 	static float mouseBound = 89.0f;
+	static float dayLength = 1200.0f; // seconds for a full day and night
+	static float startTimeOfDay = 0.1f; // fraction of a day. 0 is sunrise, 0.25 is noon
+	static float nightSkyLight = 0.2f; // how much sky light is left in the middle of the night. 0 - 1
+	static bool builtInNoise = true; // generate terrain with the in-tree noise instead of libnoise. both give the same world
+	static int terrainRegionChunks = 4; // terrain heights are sampled this many chunks across at a time. 1 samples chunk by chunk
+	static int terrainCacheTiles = 256; // tiles of terrain heights and biomes kept in memory, so going back over chunks doesn't sample them again
+	static std::string terrainCacheFile = ""; // memory mapped file tiles are also kept in, in between runs. empty to only keep them in memory
+	static int terrainCacheFileTiles = 4096; // tiles the file has room for. a tile that lands on a taken slot replaces it
+	static bool densityTerrain = false; // carve the heightmap with 3d noise for overhangs and caves
+	static bool biomes = true; // reshape the terrain and pick its surface blocks by temperature and humidity
+	static bool caves = true; // carve worm tunnels out of the terrain after it's filled in
+	static int dirtDepth = 3; // blocks of dirt between the grass and the stone under it
+	static int bedrockDepth = 1; // layers of bedrock at the bottom of the world
+	static std::string worldFile = ""; // load chunks saved by the pregenerator from here instead of generating them. empty to always generate
+	static bool benchmarkTerrain = false; // time the terrain generator's image path against its direct path at startup. quits with an error if they don't agree
+	static bool benchmarkRaycast = false; // time casting rays one at a time against casting them as a batch at startup. quits with an error if they don't hit the same blocks
+	static bool benchmarkLight = false; // time relighting around glowstone put down and taken away at startup. quits with an error if any light comes out wrong
+	static bool benchmarkCollision = false; // check the player's collision against fast falls and corners, and time it, at startup. quits with an error if a check fails
 	static const int CHUNK_WIDTH = 16;
 	static const int CHUNK_HEIGHT = 256;
 }
 
 
+// the pregenerator only needs the config and the math, and no window to go with them
+#ifdef CLONECRAFT_HEADLESS
+#include "Math.hpp"
+#else
 // include window down here so that it has access to AppGlobals
 #include "Window.hpp" 
 namespace AppGlobals {
@@ -83,5 +107,6 @@ namespace AppGlobals {
 namespace AppGlobals {
 	static Player player;
 }
+#endif // CLONECRAFT_HEADLESS
 
 #endif // APPGLOBALS_HPP
\ No newline at end of file
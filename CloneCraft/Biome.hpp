@@ -0,0 +1,282 @@
+#ifndef BIOME_HPP
+#define BIOME_HPP
+
+
+#ifndef NOISE_STATIC
+#define NOISE_STATIC
+#endif
+#include "noise/noise.h"
+#include "NoiseProgram.hpp"
+#include "Block.hpp"
+#include <cmath>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+enum class Biome : unsigned char {
+	Plains = 0,
+	Forest = 1,
+	Desert = 2,
+	Mountains = 3,
+	Tundra = 4,
+
+	NUM_BIOMES // always leave this as the last enumeration
+};
+
+// where each biome sits in temperature and humidity, how it reshapes the height noise and what its ground is
+// made of. the height noise goes through value * heightScale + heightBias before it becomes a height.
+struct BiomeInfo {
+	float temperature;
+	float humidity;
+	float heightScale;
+	float heightBias;
+	BlockId surface; // the top block of every solid run
+	BlockId filler; // the dirtDepth blocks under the surface
+	float treeChance; // chance each of the decorator's tree attempts that lands in this biome grows one
+	float boulderChance; // same for boulders
+};
+
+// indexed by Biome
+static const BiomeInfo BIOMES[] = {
+	{  0.0f,  0.0f, 0.6f, -0.05f, BlockId::Grass, BlockId::Dirt, 0.15f, 0.1f },
+	{  0.1f,  0.5f, 1.0f,  0.05f, BlockId::Grass, BlockId::Dirt, 1.0f, 0.05f },
+	{  0.5f, -0.4f, 0.35f, -0.15f, BlockId::Sand, BlockId::Sand, 0.0f, 0.2f },
+	{ -0.3f, -0.4f, 1.5f,  0.25f, BlockId::Stone, BlockId::Stone, 0.0f, 0.5f },
+	{ -0.5f,  0.3f, 0.8f,  0.05f, BlockId::Snow, BlockId::Dirt, 0.1f, 0.05f },
+};
+
+static const float BIOME_BLEND_WIDTH = 0.45f; // how far from a biome's climate its heights still mix in
+
+struct BiomeStats {
+	unsigned long long tilesBuilt = 0;
+	unsigned long long tileHits = 0;
+};
+
+// Temperature and humidity from low frequency noise, sampled once per CELL_WIDTH x CELL_WIDTH blocks and
+// cached a tile at a time, separately from anything per chunk. Blocks in between are blended from the 4
+// samples around them, so a chunk never samples the climate noise itself and a tile covers 16 chunks.
+//
+// Each sample also keeps its biome's height scale and bias, already blended with the biomes nearby in
+// climate, so the terrain eases from one biome into the next instead of stepping.
+class BiomeMap {
+public:
+	static const int CELL_WIDTH = 4; // blocks between climate samples
+	static const int TILE_CELLS = 16; // cells across a tile. a tile keeps TILE_CELLS + 1 samples across
+	static const int TILE_WIDTH = CELL_WIDTH * TILE_CELLS;
+	static const int MAX_CACHED_TILES = 64; // the least recently used tile is dropped past this
+	static const int CLIMATE_SCALE = 512; // blocks per unit of climate noise
+
+	BiomeStats stats;
+
+	BiomeMap() {}
+
+	// recompiles the climate noise and forgets every tile made with the old seed
+	void SetSeed(int seed) {
+		temperatureModule.SetSeed(seed + 2);
+		temperatureModule.SetOctaveCount(2);
+		temperatureProgram.Compile(temperatureModule);
+		humidityModule.SetSeed(seed + 3);
+		humidityModule.SetOctaveCount(2);
+		humidityProgram.Compile(humidityModule);
+		Clear();
+	}
+
+	void Clear() {
+		tiles.clear();
+		useOrder.clear();
+	}
+
+	// the blended height scale and bias and the biome of each column in a width by height rectangle of blocks
+	// starting at lowX, lowZ. row major with x along a row. any of the outputs can be null.
+	void GetColumns(int lowX, int lowZ, int width, int height, float* scales, float* biases, Biome* biomes) {
+		int lowTileX = floorDiv(lowX, TILE_WIDTH);
+		int lowTileZ = floorDiv(lowZ, TILE_WIDTH);
+		int highTileX = floorDiv(lowX + width - 1, TILE_WIDTH);
+		int highTileZ = floorDiv(lowZ + height - 1, TILE_WIDTH);
+
+		for (int tileZ = lowTileZ; tileZ <= highTileZ; tileZ++) {
+			for (int tileX = lowTileX; tileX <= highTileX; tileX++) {
+				const Tile& tile = getTile(tileX, tileZ);
+				int startX = std::max(lowX, tileX * TILE_WIDTH);
+				int endX = std::min(lowX + width, (tileX + 1) * TILE_WIDTH);
+				int startZ = std::max(lowZ, tileZ * TILE_WIDTH);
+				int endZ = std::min(lowZ + height, (tileZ + 1) * TILE_WIDTH);
+
+				for (int z = startZ; z < endZ; z++) {
+					int cellZ = (z - tileZ * TILE_WIDTH) / CELL_WIDTH;
+					float tz = (float)((z - tileZ * TILE_WIDTH) % CELL_WIDTH) / CELL_WIDTH;
+
+					// blend the rows of samples either side of this row of blocks once, then only along the row
+					float rowScale[TILE_POINTS];
+					float rowBias[TILE_POINTS];
+					float rowTemperature[TILE_POINTS];
+					float rowHumidity[TILE_POINTS];
+					blendRows(tile.scale, cellZ, tz, rowScale);
+					blendRows(tile.bias, cellZ, tz, rowBias);
+					if (biomes) {
+						blendRows(tile.temperature, cellZ, tz, rowTemperature);
+						blendRows(tile.humidity, cellZ, tz, rowHumidity);
+					}
+
+					int rowStart = (z - lowZ) * width - lowX;
+					if (scales) {
+						blendAlong(rowScale, tileX, startX, endX, scales + rowStart);
+					}
+					if (biases) {
+						blendAlong(rowBias, tileX, startX, endX, biases + rowStart);
+					}
+					if (biomes) {
+						for (int x = startX; x < endX; x++) {
+							int cellX = (x - tileX * TILE_WIDTH) / CELL_WIDTH;
+							float tx = (float)((x - tileX * TILE_WIDTH) % CELL_WIDTH) / CELL_WIDTH;
+							float temperature = rowTemperature[cellX] + (rowTemperature[cellX + 1] - rowTemperature[cellX]) * tx;
+							float humidity = rowHumidity[cellX] + (rowHumidity[cellX + 1] - rowHumidity[cellX]) * tx;
+							biomes[rowStart + x] = closestBiome(temperature, humidity);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// the biome whose climate is nearest
+	static Biome closestBiome(float temperature, float humidity) {
+		int closest = 0;
+		float closestDistance = 1e30f;
+
+		for (int biome = 0; biome < static_cast<int>(Biome::NUM_BIOMES); biome++) {
+			float dt = temperature - BIOMES[biome].temperature;
+			float dh = humidity - BIOMES[biome].humidity;
+			float distance = dt * dt + dh * dh;
+			if (distance < closestDistance) {
+				closestDistance = distance;
+				closest = biome;
+			}
+		}
+
+		return static_cast<Biome>(closest);
+	}
+
+private:
+	static const int TILE_POINTS = TILE_CELLS + 1; // samples across a tile. the last ones are shared with the next tile
+
+	struct Tile {
+		std::vector<float> temperature; // TILE_POINTS * TILE_POINTS, row major with x along a row
+		std::vector<float> humidity;
+		std::vector<float> scale;
+		std::vector<float> bias;
+		std::list<long long>::iterator use; // where the tile is in useOrder
+	};
+
+	module::Perlin temperatureModule;
+	module::Perlin humidityModule;
+	NoiseProgram temperatureProgram;
+	NoiseProgram humidityProgram;
+	std::unordered_map<long long, Tile> tiles;
+	std::list<long long> useOrder; // most recently used first
+	std::vector<double> sampleX, sampleY, sampleZ;
+
+	static long long tileKey(int tileX, int tileZ) {
+		return ((long long)tileX << 32) | (unsigned int)tileZ;
+	}
+
+	// the samples tz of the way from row cellZ to the next one
+	static void blendRows(const std::vector<float>& values, int cellZ, float tz, float* row) {
+		const float* front = &values[cellZ * TILE_POINTS];
+		const float* back = front + TILE_POINTS;
+		for (int i = 0; i < TILE_POINTS; i++) {
+			row[i] = front[i] + (back[i] - front[i]) * tz;
+		}
+	}
+
+	// blocks startX to endX - 1 of a row, blended from the row's samples. out is indexed by x
+	static void blendAlong(const float* row, int tileX, int startX, int endX, float* out) {
+		for (int x = startX; x < endX; x++) {
+			int cellX = (x - tileX * TILE_WIDTH) / CELL_WIDTH;
+			float tx = (float)((x - tileX * TILE_WIDTH) % CELL_WIDTH) / CELL_WIDTH;
+			out[x] = row[cellX] + (row[cellX + 1] - row[cellX]) * tx;
+		}
+	}
+
+	const Tile& getTile(int tileX, int tileZ) {
+		long long key = tileKey(tileX, tileZ);
+		auto found = tiles.find(key);
+		if (found != tiles.end()) {
+			useOrder.splice(useOrder.begin(), useOrder, found->second.use);
+			stats.tileHits++;
+			return found->second;
+		}
+
+		if (tiles.size() >= MAX_CACHED_TILES) {
+			tiles.erase(useOrder.back());
+			useOrder.pop_back();
+		}
+
+		Tile& tile = tiles[key];
+		buildTile(tileX, tileZ, tile);
+		useOrder.push_front(key);
+		tile.use = useOrder.begin();
+		stats.tilesBuilt++;
+		return tile;
+	}
+
+	void buildTile(int tileX, int tileZ, Tile& tile) {
+		const int POINTS = TILE_POINTS * TILE_POINTS;
+		sampleX.resize(POINTS);
+		sampleY.assign(POINTS, 0.0);
+		sampleZ.resize(POINTS);
+		for (int j = 0; j < TILE_POINTS; j++) {
+			for (int i = 0; i < TILE_POINTS; i++) {
+				sampleX[j * TILE_POINTS + i] = (double)(tileX * TILE_WIDTH + i * CELL_WIDTH) / CLIMATE_SCALE;
+				sampleZ[j * TILE_POINTS + i] = (double)(tileZ * TILE_WIDTH + j * CELL_WIDTH) / CLIMATE_SCALE;
+			}
+		}
+
+		std::vector<double> temperature(POINTS);
+		std::vector<double> humidity(POINTS);
+		if (AppGlobals::builtInNoise) {
+			temperatureProgram.GetValues(sampleX.data(), sampleY.data(), sampleZ.data(), temperature.data(), POINTS);
+			humidityProgram.GetValues(sampleX.data(), sampleY.data(), sampleZ.data(), humidity.data(), POINTS);
+		}
+		else {
+			for (int i = 0; i < POINTS; i++) {
+				temperature[i] = temperatureModule.GetValue(sampleX[i], 0, sampleZ[i]);
+				humidity[i] = humidityModule.GetValue(sampleX[i], 0, sampleZ[i]);
+			}
+		}
+
+		tile.temperature.resize(POINTS);
+		tile.humidity.resize(POINTS);
+		tile.scale.resize(POINTS);
+		tile.bias.resize(POINTS);
+		for (int i = 0; i < POINTS; i++) {
+			tile.temperature[i] = (float)temperature[i];
+			tile.humidity[i] = (float)humidity[i];
+
+			// every biome close enough in climate pulls on the height, more the closer it is
+			float totalWeight = 0.f;
+			float scale = 0.f;
+			float bias = 0.f;
+			for (int biome = 0; biome < static_cast<int>(Biome::NUM_BIOMES); biome++) {
+				float dt = tile.temperature[i] - BIOMES[biome].temperature;
+				float dh = tile.humidity[i] - BIOMES[biome].humidity;
+				float falloff = std::max(0.f, 1.f - (dt * dt + dh * dh) / (BIOME_BLEND_WIDTH * BIOME_BLEND_WIDTH));
+				float weight = falloff * falloff;
+				totalWeight += weight;
+				scale += BIOMES[biome].heightScale * weight;
+				bias += BIOMES[biome].heightBias * weight;
+			}
+
+			if (totalWeight > 0.f) {
+				tile.scale[i] = scale / totalWeight;
+				tile.bias[i] = bias / totalWeight;
+			}
+			else {
+				Biome closest = closestBiome(tile.temperature[i], tile.humidity[i]);
+				tile.scale[i] = BIOMES[static_cast<int>(closest)].heightScale;
+				tile.bias[i] = BIOMES[static_cast<int>(closest)].heightBias;
+			}
+		}
+	}
+};
+#endif // BIOME_HPP
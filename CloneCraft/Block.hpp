@@ -7,6 +7,8 @@
 #include <string>
 #include <array>
 #include <unordered_map>
+#include <cmath>
+#include <cstdint>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -25,17 +27,92 @@ struct BlockTexture {
 enum class BlockId : unsigned char {
 	Air = 0,
 	Grass = 1,
+	Dirt = 2,
+	Stone = 3,
+	Bedrock = 4,
+	Sand = 5,
+	Snow = 6,
+	Log = 7,
+	Leaves = 8,
+	CoalOre = 9,
+	IronOre = 10,
+	Glowstone = 11,
 	
 	NUM_TYPES // always leave this as the last enumeration
 };
 
+// The six sides of a block plus any geometry that doesn't sit on one of them.
+enum class BlockFace : unsigned char {
+	NegX = 0,
+	PosX = 1,
+	NegY = 2,
+	PosY = 3,
+	NegZ = 4,
+	PosZ = 5,
+	Inner = 6,
+
+	NUM_FACES // always leave this as the last enumeration
+};
+
+// offset to the neighbouring block on the other side of each face. indexed by BlockFace.
+static const int FACE_OFFSETS[6][3] = {
+	{ -1,  0,  0 },
+	{  1,  0,  0 },
+	{  0, -1,  0 },
+	{  0,  1,  0 },
+	{  0,  0, -1 },
+	{  0,  0,  1 },
+};
+
+// which side of a block is on the other side of each face. indexed by BlockFace.
+static const BlockFace OPPOSITE_FACE[6] = {
+	BlockFace::PosX,
+	BlockFace::NegX,
+	BlockFace::PosY,
+	BlockFace::NegY,
+	BlockFace::PosZ,
+	BlockFace::NegZ,
+};
+
+// each side of a block is split into an 8x8 grid and a face's coverage mask has one bit per cell that its
+// triangles cover. a full cube side is every bit, a slab's side is the bottom half, a cross plant has none.
+static const int COVERAGE_GRID = 8;
+static const uint64_t FULL_COVERAGE = ~0ull;
+
+// The two blocks beside a vertex that can shade it for ambient occlusion, as offsets from the block the
+// face looks into. The corner block is the sum of the two.
+struct AONeighbours {
+	int side1[3];
+	int side2[3];
+};
+
+// A group of triangles from a block model that all belong to the same face.
+struct BlockFaceMesh {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<AONeighbours> aoNeighbours; // one per vertex. empty for Inner
+
+	// faces that are a single quad keep their corners in winding order so the mesher can pick which
+	// diagonal to split along
+	bool isQuad = false;
+	unsigned int quad[4] = {};
+
+	// cells of the block side this face covers. cells are indexed by the two axes after the face's own
+	// axis, in the same order findAONeighbours uses. 0 for Inner.
+	uint64_t coverage = 0;
+};
+
 class BlockData {
 private:
 	BlockId id;
 	BlockTexture texture;
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
+	BlockFaceMesh faces[static_cast<int>(BlockFace::NUM_FACES)];
 	bool collidable = false;
+	bool opaque = false; // blocks light and hides the faces of its neighbours
+	bool cutout = false; // texture has see-through holes (leaves, glass) so its faces never hide a neighbour's
+	unsigned char lightEmission = 0; // block light level this block gives off. 0 - 15
 
 	void generateBlockData(const std::string& modelPath, const std::string& texturePath)
 	{
@@ -56,39 +133,49 @@ private:
 		}
 
 		std::unordered_map<Vertex, unsigned int> uniqueVertices{};
+		std::unordered_map<Vertex, unsigned int> uniqueFaceVertices[static_cast<int>(BlockFace::NUM_FACES)];
 
 		for (const auto& shape : shapes)
 		{
-			for (const auto& index : shape.mesh.indices)
+			// obj faces are triangulated by tinyobj so every 3 indices is one triangle
+			for (size_t t = 0; t + 2 < shape.mesh.indices.size(); t += 3)
 			{
-				Vertex vertex{};
-
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2],
-					0.f
-				};
+				Vertex triangle[3];
 
-				vertex.texCoord = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
-					0.f,
-					0.f
-				};
-
-				//vertex.color = { 1.0f, 1.0f, 1.0f };
-
-				if (uniqueVertices.find(vertex) == uniqueVertices.end())
+				for (int i = 0; i < 3; i++)
 				{
-					uniqueVertices[vertex] = (int)vertices.size();
-					vertices.push_back(vertex);
+					auto& index = shape.mesh.indices[t + i];
+					Vertex& vertex = triangle[i];
+
+					vertex.pos = {
+						attrib.vertices[3 * index.vertex_index + 0],
+						attrib.vertices[3 * index.vertex_index + 1],
+						attrib.vertices[3 * index.vertex_index + 2],
+						0.f
+					};
+
+					vertex.texCoord = {
+						attrib.texcoords[2 * index.texcoord_index + 0],
+						1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
+						0.f,
+						0.f
+					};
+
+					if (uniqueVertices.find(vertex) == uniqueVertices.end())
+					{
+						uniqueVertices[vertex] = (int)vertices.size();
+						vertices.push_back(vertex);
+					}
+
+					indices.push_back(uniqueVertices[vertex]);
 				}
 
-				indices.push_back(uniqueVertices[vertex]);
+				addFaceTriangle(triangle, uniqueFaceVertices);
 			}
 		}
 
+		finishFaces();
+
 		// int size = vertices.size();
 
 
@@ -116,6 +203,188 @@ private:
 		texture.image = image;
 	}
 
+	// sorts a triangle into the face it lies on so the mesher can light and cull it per face
+	void addFaceTriangle(const Vertex (&triangle)[3], std::unordered_map<Vertex, unsigned int> (&uniqueFaceVertices)[static_cast<int>(BlockFace::NUM_FACES)])
+	{
+		int face = static_cast<int>(classifyTriangle(triangle));
+		auto& faceMesh = faces[face];
+		auto& faceVertices = uniqueFaceVertices[face];
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (faceVertices.find(triangle[i]) == faceVertices.end())
+			{
+				faceVertices[triangle[i]] = (int)faceMesh.vertices.size();
+				faceMesh.vertices.push_back(triangle[i]);
+			}
+
+			faceMesh.indices.push_back(faceVertices[triangle[i]]);
+		}
+	}
+
+	// once every triangle is sorted, works out what the mesher needs to know about each side
+	void finishFaces()
+	{
+		for (int face = 0; face < static_cast<int>(BlockFace::Inner); face++)
+		{
+			findAONeighbours(static_cast<BlockFace>(face), faces[face]);
+			findQuad(faces[face]);
+			findCoverage(static_cast<BlockFace>(face), faces[face]);
+		}
+	}
+
+	// works out which side of the unit cube a triangle sits on. anything that isn't flat against one of
+	// the six sides is Inner.
+	static BlockFace classifyTriangle(const Vertex (&triangle)[3])
+	{
+		const float epsilon = 0.0001f;
+		Vec4 a = triangle[1].pos - triangle[0].pos;
+		Vec4 b = triangle[2].pos - triangle[0].pos;
+		Vec4 normal = a.Cross(b);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int other1 = (axis + 1) % 3;
+			int other2 = (axis + 2) % 3;
+
+			if (fabsf(normal.data[axis]) <= epsilon || fabsf(normal.data[other1]) > epsilon || fabsf(normal.data[other2]) > epsilon)
+			{
+				continue;
+			}
+
+			// the side of the cube the normal points at has to be where the triangle actually is
+			bool positive = normal.data[axis] > 0;
+			float plane = positive ? 1.f : 0.f;
+
+			for (int i = 0; i < 3; i++)
+			{
+				if (fabsf(triangle[i].pos.data[axis] - plane) > epsilon)
+				{
+					return BlockFace::Inner;
+				}
+			}
+
+			return static_cast<BlockFace>(axis * 2 + (positive ? 1 : 0));
+		}
+
+		return BlockFace::Inner;
+	}
+
+	// each vertex is shaded by the blocks beside the corner it sits on, in the layer the face looks into
+	static void findAONeighbours(BlockFace face, BlockFaceMesh& faceMesh)
+	{
+		int axis = static_cast<int>(face) / 2;
+		int tangent1 = (axis + 1) % 3;
+		int tangent2 = (axis + 2) % 3;
+
+		for (auto& vertex : faceMesh.vertices)
+		{
+			AONeighbours neighbours = {};
+			neighbours.side1[tangent1] = vertex.pos.data[tangent1] < 0.5f ? -1 : 1;
+			neighbours.side2[tangent2] = vertex.pos.data[tangent2] < 0.5f ? -1 : 1;
+			faceMesh.aoNeighbours.push_back(neighbours);
+		}
+	}
+
+	// if a face is 2 triangles sharing an edge, store its 4 corners in winding order
+	static void findQuad(BlockFaceMesh& faceMesh)
+	{
+		if (faceMesh.vertices.size() != 4 || faceMesh.indices.size() != 6)
+		{
+			return;
+		}
+
+		const unsigned int* first = &faceMesh.indices[0];
+		const unsigned int* second = &faceMesh.indices[3];
+
+		auto inSecond = [&](unsigned int index) {
+			return index == second[0] || index == second[1] || index == second[2];
+		};
+
+		// rotate the first triangle so the corner it doesn't share comes first
+		int start = -1;
+		for (int i = 0; i < 3; i++)
+		{
+			if (!inSecond(first[i]))
+			{
+				start = i;
+			}
+		}
+
+		if (start == -1)
+		{
+			return;
+		}
+
+		unsigned int opposite = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			if (second[i] != first[0] && second[i] != first[1] && second[i] != first[2])
+			{
+				opposite = second[i];
+			}
+		}
+
+		faceMesh.quad[0] = first[start];
+		faceMesh.quad[1] = first[(start + 1) % 3];
+		faceMesh.quad[2] = opposite;
+		faceMesh.quad[3] = first[(start + 2) % 3];
+		faceMesh.isQuad = true;
+	}
+
+	// rasterizes the face's triangles onto the coverage grid by testing the centre of every cell. a cell
+	// counts as covered if its centre is inside or on the edge of any triangle.
+	static void findCoverage(BlockFace face, BlockFaceMesh& faceMesh)
+	{
+		const float epsilon = 0.0001f;
+		int axis = static_cast<int>(face) / 2;
+		int tangent1 = (axis + 1) % 3;
+		int tangent2 = (axis + 2) % 3;
+
+		faceMesh.coverage = 0;
+
+		for (size_t t = 0; t + 2 < faceMesh.indices.size(); t += 3)
+		{
+			float u[3];
+			float v[3];
+			for (int i = 0; i < 3; i++)
+			{
+				const Vec4& pos = faceMesh.vertices[faceMesh.indices[t + i]].pos;
+				u[i] = pos.data[tangent1];
+				v[i] = pos.data[tangent2];
+			}
+
+			float area = (u[1] - u[0]) * (v[2] - v[0]) - (u[2] - u[0]) * (v[1] - v[0]);
+			if (fabsf(area) <= epsilon * epsilon)
+			{
+				continue;
+			}
+			float sign = area > 0 ? 1.f : -1.f;
+
+			for (int cellU = 0; cellU < COVERAGE_GRID; cellU++)
+			{
+				for (int cellV = 0; cellV < COVERAGE_GRID; cellV++)
+				{
+					float pu = (cellU + 0.5f) / COVERAGE_GRID;
+					float pv = (cellV + 0.5f) / COVERAGE_GRID;
+					bool inside = true;
+
+					for (int i = 0; i < 3 && inside; i++)
+					{
+						int j = (i + 1) % 3;
+						float edge = (u[j] - u[i]) * (pv - v[i]) - (pu - u[i]) * (v[j] - v[i]);
+						inside = edge * sign >= -epsilon;
+					}
+
+					if (inside)
+					{
+						faceMesh.coverage |= 1ull << (cellU * COVERAGE_GRID + cellV);
+					}
+				}
+			}
+		}
+	}
+
 public:
 	BlockData()
 	{
@@ -134,11 +403,97 @@ public:
 				modelPath = "";
 				texturePath = "";
 				collidable = false;
+				opaque = false;
+				cutout = false;
+				lightEmission = 0;
 				break;
 			case BlockId::Grass:
 				modelPath = "models/Block.obj";
 				texturePath = "textures/GrassBlock.png";
 				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 0;
+				break;
+			case BlockId::Dirt:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/DirtBlock.png";
+				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 0;
+				break;
+			case BlockId::Stone:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/StoneBlock.png";
+				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 0;
+				break;
+			case BlockId::Bedrock:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/BedrockBlock.png";
+				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 0;
+				break;
+			case BlockId::Sand:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/SandBlock.png";
+				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 0;
+				break;
+			case BlockId::Snow:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/SnowBlock.png";
+				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 0;
+				break;
+			case BlockId::Log:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/LogBlock.png";
+				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 0;
+				break;
+			case BlockId::Leaves:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/LeavesBlock.png";
+				collidable = true;
+				opaque = false;
+				cutout = true;
+				lightEmission = 0;
+				break;
+			case BlockId::CoalOre:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/CoalOreBlock.png";
+				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 0;
+				break;
+			case BlockId::IronOre:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/IronOreBlock.png";
+				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 0;
+				break;
+			case BlockId::Glowstone:
+				modelPath = "models/Block.obj";
+				texturePath = "textures/GlowstoneBlock.png";
+				collidable = true;
+				opaque = true;
+				cutout = false;
+				lightEmission = 15;
 				break;
 			default:
 				throw std::exception("Failed to create block data: invalid block id.");
@@ -156,13 +511,142 @@ public:
 	BlockTexture& getTexture() { return texture; }
 	std::vector<Vertex>& getVertices() { return vertices; }
 	std::vector<unsigned int>& getIndices() { return indices; }
+	BlockFaceMesh& getFace(BlockFace face) { return faces[static_cast<int>(face)]; }
 	bool isCollidable() { return collidable; }
+	bool isOpaque() { return opaque; }
+	bool isCutout() { return cutout; }
+	uint64_t getFaceCoverage(BlockFace face) { return faces[static_cast<int>(face)].coverage; }
+
+	// a face can be skipped when the neighbour's touching side covers every cell this face covers. both
+	// sides are in the same grid because opposite faces share the same tangent axes.
+	bool isFaceHiddenBy(BlockFace face, BlockData& neighbour)
+	{
+		if (neighbour.isOpaque())
+		{
+			return true;
+		}
+
+		// cutout textures have holes in them so they can't hide anything
+		uint64_t covered = neighbour.isCutout() ? 0 : neighbour.getFaceCoverage(OPPOSITE_FACE[static_cast<int>(face)]);
+		if (covered == 0)
+		{
+			return false;
+		}
+
+		return (getFaceCoverage(face) & ~covered) == 0;
+	}
+	unsigned char getLightEmission() { return lightEmission; }
+
+	// every block in the game is a full cube so far, so this builds a cube, a bottom slab and a cross plant in
+	// code and checks their coverage masks hide the faces they should and only those. none of them are opaque
+	// so the masks are what decides. throws if any check fails
+	static void checkCoverageMasks()
+	{
+		BlockData cube = fromQuads(boxQuads(1.f));
+		BlockData slab = fromQuads(boxQuads(0.5f));
+		BlockData plant = fromQuads({
+			{ Vec4(0.f, 0.f, 0.f, 0.f), Vec4(1.f, 0.f, 1.f, 0.f), Vec4(1.f, 1.f, 1.f, 0.f), Vec4(0.f, 1.f, 0.f, 0.f) },
+			{ Vec4(1.f, 0.f, 0.f, 0.f), Vec4(0.f, 0.f, 1.f, 0.f), Vec4(0.f, 1.f, 1.f, 0.f), Vec4(1.f, 1.f, 0.f, 0.f) },
+		});
+
+		std::string failed;
+		auto check = [&](const char* name, bool passed) {
+			if (!passed)
+			{
+				failed += failed.empty() ? name : std::string(", ") + name;
+			}
+		};
+		auto cellsCovered = [](uint64_t coverage) {
+			int count = 0;
+			for (; coverage; coverage &= coverage - 1)
+			{
+				count++;
+			}
+			return count;
+		};
+
+		const BlockFace sides[4] = { BlockFace::NegX, BlockFace::PosX, BlockFace::NegZ, BlockFace::PosZ };
+		bool cubeFull = true;
+		bool plantEmpty = plant.getFace(BlockFace::Inner).indices.size() == 12;
+		bool plantHides = false;
+		for (int face = 0; face < static_cast<int>(BlockFace::Inner); face++)
+		{
+			cubeFull = cubeFull && cube.getFaceCoverage(static_cast<BlockFace>(face)) == FULL_COVERAGE;
+			plantEmpty = plantEmpty && plant.getFaceCoverage(static_cast<BlockFace>(face)) == 0;
+			plantHides = plantHides || cube.isFaceHiddenBy(static_cast<BlockFace>(face), plant);
+		}
+		bool slabSidesHalf = true;
+		bool slabHidesCubeSide = false;
+		bool slabSideHidden = true;
+		for (BlockFace side : sides)
+		{
+			slabSidesHalf = slabSidesHalf && cellsCovered(slab.getFaceCoverage(side)) == COVERAGE_GRID * COVERAGE_GRID / 2;
+			slabHidesCubeSide = slabHidesCubeSide || cube.isFaceHiddenBy(side, slab);
+			slabSideHidden = slabSideHidden && slab.isFaceHiddenBy(side, cube) && slab.isFaceHiddenBy(side, slab);
+		}
+
+		check("every side of a cube is covered", cubeFull);
+		check("a cube's side is hidden by a cube", cube.isFaceHiddenBy(BlockFace::PosX, cube));
+		check("a slab's bottom is covered", slab.getFaceCoverage(BlockFace::NegY) == FULL_COVERAGE);
+		check("a slab's top is inside the block", slab.getFaceCoverage(BlockFace::PosY) == 0 && slab.getFace(BlockFace::Inner).indices.size() == 6);
+		check("a slab's sides cover half", slabSidesHalf);
+		check("a slab doesn't hide a cube's side", !slabHidesCubeSide);
+		check("a slab's side is hidden by a cube or a slab", slabSideHidden);
+		check("a slab on a cube hides its top", cube.isFaceHiddenBy(BlockFace::PosY, slab));
+		check("a slab under a cube doesn't hide its bottom", !cube.isFaceHiddenBy(BlockFace::NegY, slab));
+		check("a cross plant covers nothing", plantEmpty);
+		check("a cross plant hides nothing", !plantHides);
+
+		if (!failed.empty())
+		{
+			throw std::exception(("coverage mask checks failed: " + failed).c_str());
+		}
+	}
+
+private:
+	typedef std::array<Vec4, 4> Quad; // corners in winding order, facing out of the block
+
+	// the 6 sides of a box over the whole block from the bottom up to top
+	static std::vector<Quad> boxQuads(float top)
+	{
+		return {
+			{ Vec4(0.f, 0.f, 0.f, 0.f), Vec4(0.f, 0.f, 1.f, 0.f), Vec4(0.f, top, 1.f, 0.f), Vec4(0.f, top, 0.f, 0.f) },
+			{ Vec4(1.f, 0.f, 0.f, 0.f), Vec4(1.f, top, 0.f, 0.f), Vec4(1.f, top, 1.f, 0.f), Vec4(1.f, 0.f, 1.f, 0.f) },
+			{ Vec4(0.f, 0.f, 0.f, 0.f), Vec4(1.f, 0.f, 0.f, 0.f), Vec4(1.f, 0.f, 1.f, 0.f), Vec4(0.f, 0.f, 1.f, 0.f) },
+			{ Vec4(0.f, top, 0.f, 0.f), Vec4(0.f, top, 1.f, 0.f), Vec4(1.f, top, 1.f, 0.f), Vec4(1.f, top, 0.f, 0.f) },
+			{ Vec4(0.f, 0.f, 0.f, 0.f), Vec4(0.f, top, 0.f, 0.f), Vec4(1.f, top, 0.f, 0.f), Vec4(1.f, 0.f, 0.f, 0.f) },
+			{ Vec4(0.f, 0.f, 1.f, 0.f), Vec4(1.f, 0.f, 1.f, 0.f), Vec4(1.f, top, 1.f, 0.f), Vec4(0.f, top, 1.f, 0.f) },
+		};
+	}
+
+	// a model made of quads instead of loaded from an obj, sorted into faces the same way
+	static BlockData fromQuads(const std::vector<Quad>& quads)
+	{
+		BlockData block;
+		std::unordered_map<Vertex, unsigned int> uniqueFaceVertices[static_cast<int>(BlockFace::NUM_FACES)];
+		for (auto& quad : quads)
+		{
+			Vertex corners[4];
+			for (int i = 0; i < 4; i++)
+			{
+				corners[i].pos = quad[i];
+			}
+
+			Vertex first[3] = { corners[0], corners[1], corners[2] };
+			Vertex second[3] = { corners[0], corners[2], corners[3] };
+			block.addFaceTriangle(first, uniqueFaceVertices);
+			block.addFaceTriangle(second, uniqueFaceVertices);
+		}
+		block.finishFaces();
+		return block;
+	}
 };
 
 
 class BlockDatabase {
 public:
 	BlockDatabase() {
+		BlockData::checkCoverageMasks();
 		for (size_t i = 0; i < static_cast<int>(BlockId::NUM_TYPES); i++) {
 			blockDatas[i] = static_cast<BlockId>(i);
 		}
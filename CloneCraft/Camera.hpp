@@ -49,14 +49,15 @@ public:
 		projMatrix = VulkanProjectionMatrix();
 	}
 
-	void Update() {
+	// follows the entity, alpha of the way from where it was before the last tick to where it is now
+	void Update(float alpha = 1.f) {
 		assert(pEntity);
-		position = pEntity->position;
-		position.y += pEntity->height - 0.05f;
+		position = pEntity->previousPosition + (pEntity->position - pEntity->previousPosition) * alpha;
+		position.y += pEntity->GetEyeHeight();
 		rotation.y = pEntity->rotation.y;
 
 		viewMatrix = MakeViewMatrix(*this);
-		projViewMatrix = projMatrix * viewMatrix;
+		projViewMatrix = viewMatrix * projMatrix; // row vectors, so the view goes on first. the shader's proj * view is the same thing transposed
 		frustum.update(projViewMatrix);
 	}
 
@@ -0,0 +1,386 @@
+#ifndef CAVES_HPP
+#define CAVES_HPP
+
+
+#ifndef NOISE_STATIC
+#define NOISE_STATIC
+#endif
+#include "noise/noise.h"
+#include "Chunk.hpp"
+#include "Random.hpp"
+#include <chrono>
+#include <cmath>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// one straight piece of a tunnel, in world coords. everything within radius of the line from start to end is
+// carved out. the box around it is worked out once so chunks can skip the segments that don't reach them
+struct CaveSegment {
+	float x0, y0, z0;
+	float x1, y1, z1;
+	float radius;
+	int lowX, lowY, lowZ; // blocks the segment can touch, inclusive
+	int highX, highY, highZ;
+};
+
+struct CaveStats {
+	unsigned long long regionsBuilt = 0;
+	unsigned long long regionHits = 0;
+	unsigned long long segmentsCarved = 0; // segments that reached a chunk they were carving
+};
+
+// Perlin worm caves. Each region of REGION_CHUNKS by REGION_CHUNKS chunks gets its worms from its own random
+// stream, and each worm wanders by following 1d slices of Perlin noise for its turns, its pitch and its width.
+// A region's worms are worked out once, as a list of segments, and kept, so a chunk only carves the segments
+// whose boxes reach it instead of running every worm that could reach it all over again.
+//
+// Worms never wander more than MAX_REACH blocks outside their region, so a chunk only has to look at the
+// regions around it. Built regions never change and the cache is locked, so Carve can be called for different
+// chunks on as many threads at once as you like.
+class CaveCarver {
+public:
+	static const int REGION_CHUNKS = 8;
+	static const int REGION_WIDTH = REGION_CHUNKS * AppGlobals::CHUNK_WIDTH;
+	static const int MAX_REACH = 64; // furthest a worm can get past the edge of its region
+	static const int WORM_ATTEMPTS = 4; // worms per region that might start, each with WORM_CHANCE
+	static const int MAX_CACHED_REGIONS = 64; // the least recently used region is dropped past this
+	static const int MIN_Y = 8;
+	static const int MAX_Y = 80;
+	static const int MIN_STEPS = 40;
+	static const int MAX_STEPS = 120;
+	static const int NUMBERS_PER_WORM = 8; // random numbers each worm attempt uses
+
+	CaveStats stats;
+
+	CaveCarver() {}
+
+	// the tunnel noise only gets set up once per seed, and forgets every region made with the old one
+	void SetSeed(int seed) {
+		std::lock_guard<std::mutex> lock(regionLock);
+		if (appliedSeed == seed) {
+			return;
+		}
+
+		wormNoise.SetSeed(seed + 5);
+		wormNoise.SetOctaveCount(2);
+		appliedSeed = seed;
+		regions.clear();
+		useOrder.clear();
+	}
+
+	// carves every worm that reaches the chunk out of it. only touches blocks above the bedrock
+	void Carve(Chunk& chunk, int bedrockTop) {
+		carveChunk(chunk, bedrockTop, false);
+	}
+
+	// the segments that reach column x, z, in world coords, without touching a chunk. uses the same cached
+	// regions Carve does. with IsCarved it answers for any block in the column
+	void GetColumnSegments(int x, int z, std::vector<CaveSegment>& segments) {
+		segments.clear();
+		for (int regionX = floorDiv(x - MAX_REACH, REGION_WIDTH); regionX <= floorDiv(x + MAX_REACH, REGION_WIDTH); regionX++) {
+			for (int regionZ = floorDiv(z - MAX_REACH, REGION_WIDTH); regionZ <= floorDiv(z + MAX_REACH, REGION_WIDTH); regionZ++) {
+				std::shared_ptr<const std::vector<CaveSegment>> region = getRegion(regionX, regionZ);
+				for (const CaveSegment& segment : *region) {
+					if (x >= segment.lowX && x <= segment.highX && z >= segment.lowZ && z <= segment.highZ) {
+						segments.push_back(segment);
+					}
+				}
+			}
+		}
+	}
+
+	// whether Carve takes block x, y, z out, given the segments that reach its column
+	static bool IsCarved(const std::vector<CaveSegment>& segments, int x, int y, int z, int bedrockTop) {
+		if (y < bedrockTop || y >= AppGlobals::CHUNK_HEIGHT) {
+			return false;
+		}
+
+		for (const CaveSegment& segment : segments) {
+			if (y >= segment.lowY && y <= segment.highY && contains(segment, x, y, z)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// every segment in a region, worked out the same way Carve does but without keeping it
+	std::vector<CaveSegment> BuildRegion(int regionX, int regionZ) const {
+		std::vector<CaveSegment> segments;
+		uint32_t numbers[WORM_ATTEMPTS * NUMBERS_PER_WORM];
+		RandomStream(appliedSeed, regionX, regionZ, RandomFeature::Caves).Fill(0, numbers, WORM_ATTEMPTS * NUMBERS_PER_WORM);
+
+		for (int worm = 0; worm < WORM_ATTEMPTS; worm++) {
+			const uint32_t* number = &numbers[worm * NUMBERS_PER_WORM];
+			if (RandomStream::toUnit(number[0]) >= WORM_CHANCE) {
+				continue;
+			}
+
+			float x = (float)(regionX * REGION_WIDTH + RandomStream::toRange(number[1], REGION_WIDTH)) + 0.5f;
+			float y = (float)(MIN_Y + RandomStream::toRange(number[2], MAX_Y - MIN_Y)) + 0.5f;
+			float z = (float)(regionZ * REGION_WIDTH + RandomStream::toRange(number[3], REGION_WIDTH)) + 0.5f;
+			float yaw = RandomStream::toUnit(number[4]) * 2.f * PI;
+			int steps = MIN_STEPS + RandomStream::toRange(number[5], MAX_STEPS - MIN_STEPS);
+
+			// where along the noise this worm's slices are, so no two worms turn the same way
+			double slice = RandomStream::toUnit(number[6]) * 1000.0;
+			double lane = RandomStream::toUnit(number[7]) * 1000.0;
+
+			float regionLowX = (float)(regionX * REGION_WIDTH - MAX_REACH);
+			float regionLowZ = (float)(regionZ * REGION_WIDTH - MAX_REACH);
+			float regionHighX = (float)((regionX + 1) * REGION_WIDTH + MAX_REACH);
+			float regionHighZ = (float)((regionZ + 1) * REGION_WIDTH + MAX_REACH);
+
+			for (int step = 0; step < steps; step++) {
+				double t = slice + step * WORM_FREQUENCY;
+				yaw += (float)wormNoise.GetValue(t, lane, 0.0) * MAX_TURN;
+				float pitch = (float)wormNoise.GetValue(t, lane, 100.0) * MAX_PITCH;
+				float radius = MIN_RADIUS + (MAX_RADIUS - MIN_RADIUS) * 0.5f * (1.f + (float)wormNoise.GetValue(t, lane, 200.0));
+
+				float nextX = x + cosf(yaw) * cosf(pitch) * STEP_LENGTH;
+				float nextY = std::min(std::max(y + sinf(pitch) * STEP_LENGTH, (float)MIN_Y), (float)MAX_Y);
+				float nextZ = z + sinf(yaw) * cosf(pitch) * STEP_LENGTH;
+
+				// keep the whole tube inside the reach, so it can't carve a chunk that doesn't look at this region
+				if (nextX - radius < regionLowX || nextX + radius > regionHighX || nextZ - radius < regionLowZ || nextZ + radius > regionHighZ) {
+					break;
+				}
+
+				segments.push_back(makeSegment(x, y, z, nextX, nextY, nextZ, radius));
+				x = nextX;
+				y = nextY;
+				z = nextZ;
+			}
+		}
+
+		return segments;
+	}
+
+	// times carving the same chunks with the regions cached against working out every region that could reach
+	// each chunk over again for it, then carves them again spread over every core and checks all three agree.
+	// returns how many layers didn't
+	int Benchmark(int chunksAcross, int bedrockTop) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		int chunks = chunksAcross * chunksAcross;
+		std::vector<std::unique_ptr<Chunk>> resimulated(chunks);
+		std::vector<std::unique_ptr<Chunk>> cached(chunks);
+		std::vector<std::unique_ptr<Chunk>> threaded(chunks);
+		CaveStats oldStats = stats;
+
+		// every test carves the same solid stone, so only the carving gets timed
+		std::unique_ptr<Chunk> solid(new Chunk());
+		solid->fillLayers(0, H, BlockId::Stone);
+		for (int i = 0; i < chunks; i++) {
+			Vec4 position((float)(i / chunksAcross), 0.f, (float)(i % chunksAcross), 0.f);
+			resimulated[i].reset(new Chunk(*solid));
+			cached[i].reset(new Chunk(*solid));
+			threaded[i].reset(new Chunk(*solid));
+			resimulated[i]->position = position;
+			cached[i]->position = position;
+			threaded[i]->position = position;
+		}
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < chunks; i++) {
+			carveChunk(*resimulated[i], bedrockTop, true);
+		}
+		auto midTime = std::chrono::high_resolution_clock::now();
+		clearRegions();
+		for (int i = 0; i < chunks; i++) {
+			carveChunk(*cached[i], bedrockTop, false);
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		CaveStats cachedStats = stats;
+
+		clearRegions();
+		int threads = std::max(1, (int)std::thread::hardware_concurrency());
+		std::vector<std::thread> workers;
+		auto threadStart = std::chrono::high_resolution_clock::now();
+		for (int t = 0; t < threads; t++) {
+			workers.push_back(std::thread([&, t]() {
+				for (int i = t; i < chunks; i += threads) {
+					carveChunk(*threaded[i], bedrockTop, false);
+				}
+			}));
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		auto threadEnd = std::chrono::high_resolution_clock::now();
+
+		long long differing = 0;
+		long long carvedBlocks = 0;
+		for (int i = 0; i < chunks; i++) {
+			for (int y = 0; y < H; y++) {
+				carvedBlocks += W * W - cached[i]->layers[y].blockCount;
+				differing += memcmp(cached[i]->layers[y].blocks, resimulated[i]->layers[y].blocks, sizeof(cached[i]->layers[y].blocks)) != 0;
+				differing += memcmp(cached[i]->layers[y].blocks, threaded[i]->layers[y].blocks, sizeof(cached[i]->layers[y].blocks)) != 0;
+			}
+		}
+		stats = oldStats;
+		clearRegions();
+
+		double resimulateSeconds = std::chrono::duration<double>(midTime - startTime).count();
+		double cachedSeconds = std::chrono::duration<double>(endTime - midTime).count();
+		double threadSeconds = std::chrono::duration<double>(threadEnd - threadStart).count();
+		printf("cave benchmark: %d chunks, %lld blocks carved, %llu regions built\n", chunks, carvedBlocks, cachedStats.regionsBuilt - oldStats.regionsBuilt);
+		printf("  worms run again per chunk: %10.1f chunks/s\n", chunks / resimulateSeconds);
+		printf("  cached region segments:    %10.1f chunks/s  (%.2fx)\n", chunks / cachedSeconds, resimulateSeconds / cachedSeconds);
+		printf("  cached, on %2d threads:     %10.1f chunks/s  (%.2fx)\n", threads, chunks / threadSeconds, resimulateSeconds / threadSeconds);
+		printf("  layers that differ: %lld\n", differing);
+		return (int)differing;
+	}
+
+private:
+	static constexpr float WORM_CHANCE = 0.6f;
+	static constexpr float STEP_LENGTH = 2.f;
+	static constexpr float MAX_TURN = 0.35f; // radians a step can turn at most
+	static constexpr float MAX_PITCH = 0.6f;
+	static constexpr float MIN_RADIUS = 1.5f;
+	static constexpr float MAX_RADIUS = 3.5f;
+	static constexpr double WORM_FREQUENCY = 0.04; // how far along the noise each step moves
+
+	module::Perlin wormNoise;
+	int appliedSeed = -1;
+	std::mutex regionLock;
+	std::unordered_map<long long, std::pair<std::shared_ptr<const std::vector<CaveSegment>>, std::list<long long>::iterator>> regions;
+	std::list<long long> useOrder; // most recently used first
+
+	// with resimulate on, every region around the chunk is worked out again just for it instead of coming out
+	// of the cache. only the benchmark does that, to compare against
+	void carveChunk(Chunk& chunk, int bedrockTop, bool resimulate) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		int lowX = (int)chunk.position.x * W;
+		int lowZ = (int)chunk.position.z * W;
+		int lowRegionX = floorDiv(lowX - MAX_REACH, REGION_WIDTH);
+		int lowRegionZ = floorDiv(lowZ - MAX_REACH, REGION_WIDTH);
+		int highRegionX = floorDiv(lowX + W - 1 + MAX_REACH, REGION_WIDTH);
+		int highRegionZ = floorDiv(lowZ + W - 1 + MAX_REACH, REGION_WIDTH);
+		unsigned long long carved = 0;
+
+		for (int regionX = lowRegionX; regionX <= highRegionX; regionX++) {
+			for (int regionZ = lowRegionZ; regionZ <= highRegionZ; regionZ++) {
+				std::shared_ptr<const std::vector<CaveSegment>> segments = resimulate ?
+					std::make_shared<const std::vector<CaveSegment>>(BuildRegion(regionX, regionZ)) : getRegion(regionX, regionZ);
+				for (const CaveSegment& segment : *segments) {
+					if (segment.highX < lowX || segment.lowX >= lowX + W || segment.highZ < lowZ || segment.lowZ >= lowZ + W) {
+						continue;
+					}
+					carveSegment(chunk, segment, lowX, lowZ, bedrockTop);
+					carved++;
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(regionLock);
+		stats.segmentsCarved += carved;
+	}
+
+	static long long regionKey(int regionX, int regionZ) {
+		return ((long long)regionX << 32) | (unsigned int)regionZ;
+	}
+
+	void clearRegions() {
+		std::lock_guard<std::mutex> lock(regionLock);
+		regions.clear();
+		useOrder.clear();
+	}
+
+	// built outside the lock so other threads aren't held up. if two threads build the same region they get
+	// the same segments, and the first one in is kept
+	std::shared_ptr<const std::vector<CaveSegment>> getRegion(int regionX, int regionZ) {
+		long long key = regionKey(regionX, regionZ);
+		{
+			std::lock_guard<std::mutex> lock(regionLock);
+			auto found = regions.find(key);
+			if (found != regions.end()) {
+				useOrder.splice(useOrder.begin(), useOrder, found->second.second);
+				stats.regionHits++;
+				return found->second.first;
+			}
+		}
+
+		std::shared_ptr<const std::vector<CaveSegment>> segments = std::make_shared<const std::vector<CaveSegment>>(BuildRegion(regionX, regionZ));
+
+		std::lock_guard<std::mutex> lock(regionLock);
+		auto found = regions.find(key);
+		if (found != regions.end()) {
+			return found->second.first;
+		}
+		if (regions.size() >= MAX_CACHED_REGIONS) {
+			regions.erase(useOrder.back());
+			useOrder.pop_back();
+		}
+		useOrder.push_front(key);
+		regions[key] = std::make_pair(segments, useOrder.begin());
+		stats.regionsBuilt++;
+		return segments;
+	}
+
+	static CaveSegment makeSegment(float x0, float y0, float z0, float x1, float y1, float z1, float radius) {
+		CaveSegment segment;
+		segment.x0 = x0;
+		segment.y0 = y0;
+		segment.z0 = z0;
+		segment.x1 = x1;
+		segment.y1 = y1;
+		segment.z1 = z1;
+		segment.radius = radius;
+		segment.lowX = (int)floorf(std::min(x0, x1) - radius);
+		segment.lowY = (int)floorf(std::min(y0, y1) - radius);
+		segment.lowZ = (int)floorf(std::min(z0, z1) - radius);
+		segment.highX = (int)floorf(std::max(x0, x1) + radius);
+		segment.highY = (int)floorf(std::max(y0, y1) + radius);
+		segment.highZ = (int)floorf(std::max(z0, z1) + radius);
+		return segment;
+	}
+
+	// whether the middle of block x, y, z is inside the segment's tube
+	static bool contains(const CaveSegment& segment, int x, int y, int z) {
+		float dx = segment.x1 - segment.x0;
+		float dy = segment.y1 - segment.y0;
+		float dz = segment.z1 - segment.z0;
+		float lengthSquared = std::max(dx * dx + dy * dy + dz * dz, 1e-6f);
+		float px = x + 0.5f - segment.x0;
+		float py = y + 0.5f - segment.y0;
+		float pz = z + 0.5f - segment.z0;
+		float t = std::min(std::max((px * dx + py * dy + pz * dz) / lengthSquared, 0.f), 1.f);
+		float ox = px - dx * t;
+		float oy = py - dy * t;
+		float oz = pz - dz * t;
+		return ox * ox + oy * oy + oz * oz <= segment.radius * segment.radius;
+	}
+
+	// the tube is convex, so it crosses each column of blocks in one run. find the run's ends and carve it
+	static void carveSegment(Chunk& chunk, const CaveSegment& segment, int lowX, int lowZ, int bedrockTop) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		int startX = std::max(segment.lowX, lowX);
+		int endX = std::min(segment.highX, lowX + W - 1);
+		int startZ = std::max(segment.lowZ, lowZ);
+		int endZ = std::min(segment.highZ, lowZ + W - 1);
+		int bottom = std::max(segment.lowY, bedrockTop);
+		int top = std::min(segment.highY, AppGlobals::CHUNK_HEIGHT - 1);
+
+		for (int x = startX; x <= endX; x++) {
+			for (int z = startZ; z <= endZ; z++) {
+				int runBottom = bottom;
+				while (runBottom <= top && !contains(segment, x, runBottom, z)) {
+					runBottom++;
+				}
+				if (runBottom > top) {
+					continue;
+				}
+				int runTop = runBottom;
+				while (runTop + 1 <= top && contains(segment, x, runTop + 1, z)) {
+					runTop++;
+				}
+				chunk.carveColumn(x - lowX, z - lowZ, runBottom, runTop + 1);
+			}
+		}
+	}
+};
+#endif // CAVES_HPP
@@ -3,14 +3,25 @@
 
 
 #include "Layer.hpp"
+#include <algorithm>
+#include <cstring>
 
 class Chunk {
 public:
+	static const int SECTION_HEIGHT = 16;
+	static const int NUM_SECTIONS = AppGlobals::CHUNK_HEIGHT / SECTION_HEIGHT;
+
 	Layer layers[256];
 	Vec4 position;
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
+	unsigned int sectionFirstIndex[NUM_SECTIONS + 1] = {}; // where each section's triangles start in indices. the mesh is built bottom to top so they're all together
+	short heightMap[16][16] = {}; // y of the first block above the highest opaque block in each column
+	short columnBottom[16][16] = {}; // lowest block in each column that isn't air. only valid if columnTop > 0
+	short columnTop[16][16] = {}; // y of the first block above the highest block that isn't air. 0 if the column is empty
 	bool isLoaded = false;
+	bool isGenerated = false; // terrain and light are filled in. set before the first mesh is built
+	bool meshDirty = false; // something the mesh depends on changed since it was last built
 
 
 	Chunk() {}
@@ -30,6 +41,7 @@ public:
 	bool SetBlock(BlockId id, Vec4 blockPos) {
 		if (!IsBlockOutOfBounds(blockPos)) {
 			if (layers[(int)blockPos.y].SetBlock(id, blockPos)) {
+				updateColumn((int)blockPos.x, (int)blockPos.y, (int)blockPos.z, id);
 				return true;
 			}
 		}
@@ -37,6 +49,94 @@ public:
 		return false;
 	}
 
+	// for terrain generation. sets layers bottom to top - 1 to id all the way across with one memset each,
+	// since layers are what's contiguous. id can't be air.
+	void fillLayers(int bottom, int top, BlockId id) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		if (top <= bottom) {
+			return;
+		}
+
+		for (int y = bottom; y < top; y++) {
+			memset(layers[y].blocks, static_cast<int>(id), sizeof(layers[y].blocks));
+			layers[y].blockCount = W * W;
+		}
+
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				extendColumn(x, z, bottom, top);
+			}
+		}
+	}
+
+	// sets blocks bottom to top - 1 of one column to id, without the bounds checks and range updates SetBlock
+	// does for every block. id can't be air.
+	void fillColumn(int x, int z, int bottom, int top, BlockId id) {
+		if (top <= bottom) {
+			return;
+		}
+
+		for (int y = bottom; y < top; y++) {
+			BlockId& block = layers[y].blocks[x][z];
+			layers[y].blockCount += block == BlockId::Air;
+			block = id;
+		}
+
+		extendColumn(x, z, bottom, top);
+	}
+
+	// the opposite of fillColumn. sets blocks bottom to top - 1 of one column to air and shrinks the column's
+	// range if that took blocks off either end of it.
+	void carveColumn(int x, int z, int bottom, int top) {
+		if (top <= bottom) {
+			return;
+		}
+
+		for (int y = bottom; y < top; y++) {
+			BlockId& block = layers[y].blocks[x][z];
+			layers[y].blockCount -= block != BlockId::Air;
+			block = BlockId::Air;
+		}
+
+		if (columnTop[x][z] > 0 && (bottom <= columnBottom[x][z] || top >= columnTop[x][z])) {
+			shrinkColumn(x, z);
+		}
+		boundsDirty = true;
+	}
+
+	// unchecked versions for the hot loops. coords must already be inside the chunk.
+	BlockId getBlock(int x, int y, int z) {
+		return layers[y].blocks[x][z];
+	}
+
+	unsigned char getSkyLight(int x, int y, int z) {
+		return layers[y].GetSkyLight(x, z);
+	}
+
+	unsigned char getBlockLight(int x, int y, int z) {
+		return layers[y].GetBlockLight(x, z);
+	}
+
+	void setSkyLight(int x, int y, int z, unsigned char level) {
+		layers[y].SetSkyLight(x, z, level);
+	}
+
+	void setBlockLight(int x, int y, int z, unsigned char level) {
+		layers[y].SetBlockLight(x, z, level);
+	}
+
+	// smallest box in world coords around every block in the chunk that isn't air. empty if there are none
+	const AABB& getBounds() {
+		updateBounds();
+		return bounds;
+	}
+
+	// same but only for the blocks in one 16 high section
+	const AABB& getSectionBounds(int section) {
+		updateBounds();
+		return sectionBounds[section];
+	}
+
 	bool IsBlockOutOfBounds(Vec4 blockPos) {
 		if (blockPos.x >= AppGlobals::CHUNK_WIDTH)
 			return true;
@@ -56,5 +156,114 @@ public:
 
 		return false;
 	}
+
+private:
+	AABB bounds;
+	AABB sectionBounds[NUM_SECTIONS];
+	bool boundsDirty = true;
+
+	void updateColumn(int x, int y, int z, BlockId id) {
+		short& bottom = columnBottom[x][z];
+		short& top = columnTop[x][z];
+
+		if (id != BlockId::Air) {
+			bottom = top == 0 ? y : std::min<short>(bottom, y);
+			top = std::max<short>(top, y + 1);
+		}
+		// removing a block only changes the range if it was at one of the ends
+		else if (top > 0 && (y == bottom || y == top - 1)) {
+			shrinkColumn(x, z);
+		}
+
+		boundsDirty = true;
+	}
+
+	// pulls the ends of a column's range in past any air
+	void shrinkColumn(int x, int z) {
+		short& bottom = columnBottom[x][z];
+		short& top = columnTop[x][z];
+
+		while (top > bottom && layers[top - 1].blocks[x][z] == BlockId::Air) {
+			top--;
+		}
+		while (bottom < top && layers[bottom].blocks[x][z] == BlockId::Air) {
+			bottom++;
+		}
+		if (top == bottom) {
+			top = 0;
+			bottom = 0;
+		}
+	}
+
+	// grows a column's range to cover blocks bottom to top - 1 that were just filled in
+	void extendColumn(int x, int z, int bottom, int top) {
+		short& columnLow = columnBottom[x][z];
+		short& columnHigh = columnTop[x][z];
+
+		columnLow = columnHigh == 0 ? bottom : std::min<short>(columnLow, bottom);
+		columnHigh = std::max<short>(columnHigh, top);
+		boundsDirty = true;
+	}
+
+	// y comes from which layers have anything in them. x and z from the columns that reach into the section.
+	void updateBounds() {
+		if (!boundsDirty) {
+			return;
+		}
+
+		const int W = AppGlobals::CHUNK_WIDTH;
+		Vec4 origin(position.x * W, 0.f, position.z * W, 0.f);
+		int minX = W, minY = AppGlobals::CHUNK_HEIGHT, minZ = W;
+		int maxX = -1, maxY = -1, maxZ = -1;
+
+		for (int section = 0; section < NUM_SECTIONS; section++) {
+			int sectionBottom = section * SECTION_HEIGHT;
+			int sectionTop = sectionBottom + SECTION_HEIGHT;
+			int y0 = sectionTop, y1 = sectionBottom - 1;
+			int x0 = W, x1 = -1, z0 = W, z1 = -1;
+
+			for (int y = sectionBottom; y < sectionTop; y++) {
+				if (layers[y].blockCount > 0) {
+					y0 = std::min(y0, y);
+					y1 = y;
+				}
+			}
+
+			if (y1 >= y0) {
+				for (int x = 0; x < W; x++) {
+					for (int z = 0; z < W; z++) {
+						if (columnTop[x][z] > y0 && columnBottom[x][z] <= y1) {
+							x0 = std::min(x0, x);
+							x1 = std::max(x1, x);
+							z0 = std::min(z0, z);
+							z1 = std::max(z1, z);
+						}
+					}
+				}
+			}
+
+			if (x1 < x0) {
+				sectionBounds[section] = AABB(origin + Vec4(0.f, (float)sectionBottom, 0.f, 0.f));
+				continue;
+			}
+
+			sectionBounds[section] = AABB(origin + Vec4((float)x0, (float)y0, (float)z0, 0.f), Vec4((float)(x1 - x0 + 1), (float)(y1 - y0 + 1), (float)(z1 - z0 + 1), 0.f));
+			minX = std::min(minX, x0);
+			minY = std::min(minY, y0);
+			minZ = std::min(minZ, z0);
+			maxX = std::max(maxX, x1);
+			maxY = std::max(maxY, y1);
+			maxZ = std::max(maxZ, z1);
+		}
+
+		if (maxX < minX) {
+			bounds = AABB(origin);
+		}
+		else {
+			bounds = AABB(origin + Vec4((float)minX, (float)minY, (float)minZ, 0.f), Vec4((float)(maxX - minX + 1), (float)(maxY - minY + 1), (float)(maxZ - minZ + 1), 0.f));
+		}
+
+		boundsDirty = false;
+	}
 };
 #endif // CHUNK_HPP
\ No newline at end of file
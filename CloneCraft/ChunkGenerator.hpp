@@ -0,0 +1,175 @@
+#ifndef CHUNK_GENERATOR_HPP
+#define CHUNK_GENERATOR_HPP
+
+
+#include "Chunk.hpp"
+#include "TerrainGenerator.hpp"
+#include "Caves.hpp"
+#include "Decorator.hpp"
+#include <chrono>
+#include <vector>
+
+// where the time to generate chunks went, a stage at a time
+struct GenerationStats {
+	double terrainMilliseconds = 0; // biomes and the heights or density
+	double fillMilliseconds = 0;
+	double caveMilliseconds = 0;
+	double decorationMilliseconds = 0;
+	unsigned long long chunks = 0;
+
+	void add(const GenerationStats& other) {
+		terrainMilliseconds += other.terrainMilliseconds;
+		fillMilliseconds += other.fillMilliseconds;
+		caveMilliseconds += other.caveMilliseconds;
+		decorationMilliseconds += other.decorationMilliseconds;
+		chunks += other.chunks;
+	}
+};
+
+// Everything that goes into a new chunk before it's lit and meshed: the terrain, its strata, its caves and its
+// decorations. The world has one and the pregenerator runs one per thread, so a chunk comes out the same
+// whichever one made it. A generator keeps caches and scratch space, so each thread needs its own.
+class ChunkGenerator {
+public:
+	TerrainGenerator terrain;
+	CaveCarver caves;
+	Decorator decorator;
+	GenerationStats stats;
+
+	// fills in a chunk that's all air. the decoration blocks that land in the chunk go straight in, and the ones
+	// that land in the chunks around it are left in outgoing, in world coords, for whoever owns those chunks
+	void Generate(Chunk& chunk, std::vector<DecorationBlock>& outgoing) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		int chunkX = (int)chunk.position.x;
+		int chunkZ = (int)chunk.position.z;
+		Biome biomes[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+		int heights[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		terrain.GetBiomes(chunkX, chunkZ, biomes);
+		if (AppGlobals::densityTerrain) {
+			terrain.GetSolid(chunkX, chunkZ, solidBlocks);
+		}
+		else {
+			terrain.GetHeights(chunkX, chunkZ, heights);
+		}
+		auto terrainTime = std::chrono::high_resolution_clock::now();
+
+		if (AppGlobals::densityTerrain) {
+			fillStrata(chunk, solidBlocks, biomes);
+		}
+		else {
+			fillStrata(chunk, heights, biomes);
+		}
+		auto fillTime = std::chrono::high_resolution_clock::now();
+
+		if (AppGlobals::caves) {
+			caves.SetSeed(AppGlobals::seed);
+			caves.Carve(chunk, bedrockHeight());
+		}
+		auto caveTime = std::chrono::high_resolution_clock::now();
+
+		decorator.Decorate(chunk, biomes, decorationBlocks);
+		outgoing.clear();
+		for (auto& block : decorationBlocks) {
+			if (floorDiv(block.x, W) == chunkX && floorDiv(block.z, W) == chunkZ) {
+				mergeDecorationBlock(chunk, block);
+			}
+			else {
+				outgoing.push_back(block);
+			}
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		stats.terrainMilliseconds += std::chrono::duration<double, std::milli>(terrainTime - startTime).count();
+		stats.fillMilliseconds += std::chrono::duration<double, std::milli>(fillTime - terrainTime).count();
+		stats.caveMilliseconds += std::chrono::duration<double, std::milli>(caveTime - fillTime).count();
+		stats.decorationMilliseconds += std::chrono::duration<double, std::milli>(endTime - caveTime).count();
+		stats.chunks++;
+	}
+
+	// the biome's surface block on top, then dirtDepth blocks of its filler, then stone down to the bedrock
+	// layers at the bottom of the world. the bedrock and the stone that's under every column go in as whole
+	// layers, the rest a column run at a time.
+	void fillStrata(Chunk& chunk, const int (&heights)[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH], const Biome (&biomes)[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH]) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		int bedrockTop = bedrockHeight();
+		int sharedStoneTop = AppGlobals::CHUNK_HEIGHT;
+
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				sharedStoneTop = std::min(sharedStoneTop, heights[x][z] - AppGlobals::dirtDepth);
+			}
+		}
+		sharedStoneTop = std::max(sharedStoneTop, bedrockTop);
+
+		chunk.fillLayers(0, bedrockTop, BlockId::Bedrock);
+		chunk.fillLayers(bedrockTop, sharedStoneTop, BlockId::Stone);
+
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				fillRun(chunk, x, z, sharedStoneTop, std::min(heights[x][z] + 1, AppGlobals::CHUNK_HEIGHT), biomes[x][z]);
+			}
+		}
+	}
+
+	// same layering for density terrain, where a column can have any number of solid runs. every run gets its
+	// own surface and filler on top so overhangs and cave floors look like the surface.
+	void fillStrata(Chunk& chunk, const std::vector<unsigned char>& solid, const Biome (&biomes)[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH]) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		int bedrockTop = bedrockHeight();
+
+		chunk.fillLayers(0, bedrockTop, BlockId::Bedrock);
+
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				const unsigned char* column = &solid[(x * W + z) * H];
+				int y = H;
+
+				while (y > bedrockTop) {
+					while (y > bedrockTop && !column[y - 1]) {
+						y--;
+					}
+					int top = y;
+					while (y > bedrockTop && column[y - 1]) {
+						y--;
+					}
+					fillRun(chunk, x, z, y, top, biomes[x][z]);
+				}
+			}
+		}
+	}
+
+	// places a decoration block in a chunk that isn't generated yet, unless there's something of a higher
+	// rank there already
+	static void mergeDecorationBlock(Chunk& chunk, const DecorationBlock& block) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		Vec4 blockPos((float)(block.x - floorDiv(block.x, W) * W), (float)block.y, (float)(block.z - floorDiv(block.z, W) * W), 0.f);
+		if (outranks(block.id, chunk.getBlock(blockPos))) {
+			chunk.SetBlock(block.id, blockPos);
+		}
+	}
+
+	static int bedrockHeight() {
+		return std::min(std::max(AppGlobals::bedrockDepth, 0), (int)AppGlobals::CHUNK_HEIGHT);
+	}
+
+private:
+	std::vector<unsigned char> solidBlocks; // which blocks are solid in the chunk being generated with density terrain
+	std::vector<DecorationBlock> decorationBlocks; // trees and boulders from the chunk being generated
+
+	// one run of solid blocks from bottom to top - 1 with air above it
+	static void fillRun(Chunk& chunk, int x, int z, int bottom, int top, Biome biome) {
+		if (top <= bottom) {
+			return;
+		}
+
+		const BiomeInfo& info = BIOMES[static_cast<int>(biome)];
+		int fillerBottom = std::max(bottom, top - 1 - AppGlobals::dirtDepth);
+		chunk.fillColumn(x, z, bottom, fillerBottom, BlockId::Stone);
+		chunk.fillColumn(x, z, fillerBottom, top - 1, info.filler);
+		chunk.fillColumn(x, z, top - 1, top, info.surface);
+	}
+};
+#endif // CHUNK_GENERATOR_HPP
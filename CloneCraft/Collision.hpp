@@ -0,0 +1,294 @@
+#ifndef COLLISION_HPP
+#define COLLISION_HPP
+
+
+#include "World.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// where a box ended up after sweeping it through the blocks, and which way it was stopped on each axis. -1 means
+// it ran into something on the low side, 1 the high side and 0 that it wasn't stopped on that axis.
+struct SweepResult {
+	Vec4 low;
+	Vec4 high;
+	int hitX = 0;
+	int hitY = 0;
+	int hitZ = 0;
+	int cellsChecked = 0;
+};
+
+// Moves the box from low to high by displacement and stops it at the first solid block in its way, by walking the
+// leading faces of the box across the block grid in the order the box reaches each block boundary. When one axis
+// hits something the box is left flush against it, that axis stops, and the rest of the move carries on along the
+// others, so the box slides along walls and floors. Nothing can be skipped however far the box goes in one call,
+// and the cost only grows with the number of blocks it crosses, never with how the move is split over frames.
+//
+// solid(x, y, z) says whether a block stops the box. blocks the box already overlaps when it starts don't, so a box
+// stuck in something can always move out of it.
+template <typename Solid>
+static SweepResult sweepBox(const Vec4& low, const Vec4& high, const Vec4& displacement, Solid& solid) {
+	// lets positions that should be exactly on a block boundary be a float rounding off it
+	const double EPSILON = 1e-4;
+	double lo[3] = { low.x, low.y, low.z };
+	double hi[3] = { high.x, high.y, high.z };
+	double d[3] = { displacement.x, displacement.y, displacement.z };
+	int hits[3] = {};
+	int cellsChecked = 0;
+
+	// one pass for every axis that can be stopped, plus one to finish the move
+	for (int pass = 0; pass < 4; pass++) {
+		int step[3];
+		int leadCell[3]; // the cell the leading face is in on each moving axis
+		double tNext[3]; // when the leading face reaches the next boundary, as a fraction of d
+		double tDelta[3];
+		for (int i = 0; i < 3; i++) {
+			step[i] = d[i] > 0 ? 1 : (d[i] < 0 ? -1 : 0);
+			if (step[i] == 0) {
+				leadCell[i] = 0;
+				tNext[i] = INFINITY;
+				tDelta[i] = INFINITY;
+				continue;
+			}
+			double lead = step[i] > 0 ? hi[i] : lo[i];
+			double boundary = step[i] > 0 ? ceil(lead - EPSILON) : floor(lead + EPSILON);
+			leadCell[i] = step[i] > 0 ? (int)boundary - 1 : (int)boundary;
+			tNext[i] = std::max((boundary - lead) / d[i], 0.0);
+			tDelta[i] = 1.0 / fabs(d[i]);
+		}
+
+		int hitAxis = -1;
+		double hitTime = 1.0;
+		for (;;) {
+			int axis = tNext[0] <= tNext[1] ? (tNext[0] <= tNext[2] ? 0 : 2) : (tNext[1] <= tNext[2] ? 1 : 2);
+			double t = tNext[axis];
+			if (t > 1.0) {
+				break;
+			}
+			int cell = leadCell[axis] + step[axis];
+
+			// the blocks the leading face is about to enter. on the other moving axes the leading side is whatever
+			// cell that face has reached, so two faces crossing at once still see the block on the corner between them
+			int from[3], to[3];
+			for (int j = 0; j < 3; j++) {
+				if (j == axis) {
+					from[j] = to[j] = cell;
+				}
+				else if (step[j] == 0) {
+					from[j] = (int)floor(lo[j] + EPSILON);
+					to[j] = (int)ceil(hi[j] - EPSILON) - 1;
+				}
+				else {
+					double trail = (step[j] > 0 ? lo[j] : hi[j]) + d[j] * t;
+					int trailCell = step[j] > 0 ? (int)floor(trail + EPSILON) : (int)ceil(trail - EPSILON) - 1;
+					from[j] = std::min(trailCell, leadCell[j]);
+					to[j] = std::max(trailCell, leadCell[j]);
+				}
+			}
+
+			bool blocked = false;
+			for (int x = from[0]; x <= to[0] && !blocked; x++) {
+				for (int y = from[1]; y <= to[1] && !blocked; y++) {
+					for (int z = from[2]; z <= to[2] && !blocked; z++) {
+						blocked = solid(x, y, z);
+						cellsChecked++;
+					}
+				}
+			}
+			if (blocked) {
+				hitAxis = axis;
+				hitTime = t;
+				break;
+			}
+
+			leadCell[axis] = cell;
+			tNext[axis] += tDelta[axis];
+		}
+
+		for (int i = 0; i < 3; i++) {
+			lo[i] += d[i] * hitTime;
+			hi[i] += d[i] * hitTime;
+		}
+		if (hitAxis < 0) {
+			break;
+		}
+
+		// flush against the block that was hit, then carry on with what's left of the move on the other axes
+		double size = hi[hitAxis] - lo[hitAxis];
+		double boundary = step[hitAxis] > 0 ? leadCell[hitAxis] + 1 : leadCell[hitAxis];
+		lo[hitAxis] = step[hitAxis] > 0 ? boundary - size : boundary;
+		hi[hitAxis] = lo[hitAxis] + size;
+		hits[hitAxis] = step[hitAxis];
+		for (int i = 0; i < 3; i++) {
+			d[i] = i == hitAxis ? 0.0 : d[i] * (1.0 - hitTime);
+		}
+	}
+
+	SweepResult result;
+	result.low = Vec4((float)lo[0], (float)lo[1], (float)lo[2], 0.f);
+	result.high = Vec4((float)hi[0], (float)hi[1], (float)hi[2], 0.f);
+	result.hitX = hits[0];
+	result.hitY = hits[1];
+	result.hitZ = hits[2];
+	result.cellsChecked = cellsChecked;
+	return result;
+}
+
+// which blocks in the world stop things, for sweepBox. keeps the last chunk it looked in, since a sweep asks about
+// blocks next to each other, and a table of which block types are collidable. chunks that haven't been generated
+// are empty, and so is everything above and below the world.
+class WorldVoxels {
+public:
+	WorldVoxels(World& world) : world(world) {
+		for (int i = 0; i < static_cast<int>(BlockId::NUM_TYPES); i++) {
+			collidable[i] = world.blockdb.blockDataFor(static_cast<BlockId>(i)).isCollidable();
+		}
+	}
+
+	bool operator()(int x, int y, int z) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		if (y < 0 || y >= AppGlobals::CHUNK_HEIGHT) {
+			return false;
+		}
+
+		int chunkX = floorDiv(x, W);
+		int chunkZ = floorDiv(z, W);
+		if (!haveChunk || chunkX != lastChunkX || chunkZ != lastChunkZ) {
+			chunk = world.findGeneratedChunk(Vec4((float)chunkX, 0.f, (float)chunkZ, 0.f));
+			lastChunkX = chunkX;
+			lastChunkZ = chunkZ;
+			haveChunk = true;
+		}
+		return chunk && collidable[static_cast<int>(chunk->getBlock(x - chunkX * W, y, z - chunkZ * W))];
+	}
+
+private:
+	World& world;
+	Chunk* chunk = nullptr;
+	bool haveChunk = false;
+	int lastChunkX = 0, lastChunkZ = 0;
+	bool collidable[static_cast<int>(BlockId::NUM_TYPES)];
+};
+
+// runs sweepBox through fast falls and corners on made up blocks and checks where it stops, then times a fall at
+// a few frame rates to show the cost follows the distance fallen and not the number of frames.
+// returns how many checks failed
+static int benchmarkCollision() {
+	const float w = 0.25f; // the player's half width and height
+	const float h = 1.75f;
+	int failed = 0;
+
+	auto check = [&](const char* name, bool passed) {
+		printf("  %-44s %s\n", name, passed ? "ok" : "FAILED");
+		failed += !passed;
+	};
+	auto near = [](float a, float b) { return fabsf(a - b) < 1e-3f; };
+	auto box = [&](float x, float y, float z) { return std::make_pair(Vec4(x - w, y, z - w, 0.f), Vec4(x + w, y + h, z + w, 0.f)); };
+
+	printf("collision checks:\n");
+
+	// ground everywhere at y 63 and below
+	auto ground = [](int x, int y, int z) { return y <= 63; };
+	{
+		auto b = box(0.5f, 200.f, 0.5f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(0.f, -5000.f, 0.f, 0.f), ground);
+		check("falling 5000 blocks in one frame lands", near(r.low.y, 64.f) && r.hitY == -1);
+	}
+	{
+		auto b = box(-1000.3f, 64.f, -2000.7f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(3.f, -0.05f, -2.f, 0.f), ground);
+		check("walking on the ground with gravity slides", near(r.low.y, 64.f) && near(r.low.x, b.first.x + 3.f) && near(r.low.z, b.first.z - 2.f) && r.hitY == -1 && !r.hitX && !r.hitZ);
+	}
+
+	// one block at -5, 63, -7 with nothing under it
+	auto pillar = [](int x, int y, int z) { return x == -5 && y == 63 && z == -7; };
+	{
+		auto b = box(-4.5f, 300.f, -6.5f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(0.f, -1000.f, 0.f, 0.f), pillar);
+		check("fast fall onto one block in negative coords", near(r.low.y, 64.f) && r.hitY == -1);
+	}
+	{
+		auto b = box(-5.f - w + 0.01f, 300.f, -6.5f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(0.f, -1000.f, 0.f, 0.f), pillar);
+		check("fall just over the edge of a block lands", near(r.low.y, 64.f) && r.hitY == -1);
+	}
+	{
+		auto b = box(-5.f - w, 300.f, -6.5f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(0.f, -1000.f, 0.f, 0.f), pillar);
+		check("fall flush with the side of a block misses it", near(r.low.y, -700.f) && r.hitY == 0);
+	}
+
+	// walls at x 10 and z 10, and one block at 20, 64, 20 on its own
+	auto walls = [](int x, int y, int z) { return x == 10 || z == 10 || (x == 20 && y == 64 && z == 20); };
+	{
+		auto b = box(8.f, 64.f, 8.f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(5.f, 0.f, 5.f, 0.f), walls);
+		check("diagonal into an inside corner stops on both", near(r.high.x, 10.f) && near(r.high.z, 10.f) && r.hitX == 1 && r.hitZ == 1);
+	}
+	{
+		auto b = box(10.f - w, 64.f, 0.5f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(1.f, 0.f, -3.f, 0.f), walls);
+		check("pushing into a wall slides along it", near(r.high.x, 10.f) && near(r.low.z, b.first.z - 3.f) && r.hitX == 1);
+	}
+	{
+		// both leading faces reach the block's corner at the same time
+		Vec4 low(19.4f, 64.f, 19.4f, 0.f), high(19.9f, 65.f, 19.9f, 0.f);
+		SweepResult r = sweepBox(low, high, Vec4(1.f, 0.f, 1.f, 0.f), walls);
+		bool overlaps = r.high.x > 20.001f && r.high.z > 20.001f;
+		check("diagonal straight at a block's corner stops", !overlaps && (r.hitX || r.hitZ));
+	}
+	{
+		auto b = box(0.5f, 64.f, 0.5f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(100.f, 0.f, 0.f, 0.f), walls);
+		check("moving 100 blocks at a thin wall stops at it", near(r.high.x, 10.f) && r.hitX == 1);
+	}
+	{
+		auto b = box(-20.5f, 64.f, 0.5f);
+		auto wall = [](int x, int y, int z) { return x == -31; };
+		SweepResult r = sweepBox(b.first, b.second, Vec4(-100.f, 0.f, 0.f, 0.f), wall);
+		check("moving at a wall in negative coords stops", near(r.low.x, -30.f) && r.hitX == -1);
+	}
+
+	// a ceiling at y 66
+	auto ceiling = [](int x, int y, int z) { return y == 66 || y <= 63; };
+	{
+		auto b = box(0.5f, 64.f, 0.5f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(0.f, 2.f, 0.f, 0.f), ceiling);
+		check("jumping into a ceiling stops under it", near(r.high.y, 66.f) && r.hitY == 1);
+	}
+	{
+		auto b = box(0.5f, 63.5f, 0.5f);
+		SweepResult r = sweepBox(b.first, b.second, Vec4(0.f, 0.25f, 0.f, 0.f), ceiling);
+		check("a box stuck in a block can move out", near(r.low.y, 63.75f) && r.hitY == 0);
+	}
+
+	// a fall of 200 blocks to the ground split into frames at a few frame rates
+	printf("collision benchmark: falling 200 blocks\n");
+	const int REPEATS = 2000;
+	float speeds[] = { 10.f, 60.f, 240.f };
+	for (float fps : speeds) {
+		float dt = 1.f / fps;
+		long long cells = 0;
+		int frames = 0;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int repeat = 0; repeat < REPEATS; repeat++) {
+			auto b = box(0.5f, 264.f, 0.5f);
+			float fallingSpeed = -200.f; // fast enough that the fall is straight down at the same speed
+			for (;;) {
+				SweepResult r = sweepBox(b.first, b.second, Vec4(0.f, fallingSpeed * dt, 0.f, 0.f), ground);
+				b = std::make_pair(r.low, r.high);
+				cells += r.cellsChecked;
+				frames++;
+				if (r.hitY) {
+					break;
+				}
+			}
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		double microseconds = std::chrono::duration<double, std::micro>(endTime - startTime).count() / REPEATS;
+		printf("  %5.0f fps: %5d frames  %8.2f us per fall  %6lld cells checked per fall\n", fps, frames / REPEATS, microseconds, cells / REPEATS);
+	}
+
+	return failed;
+}
+#endif // COLLISION_HPP
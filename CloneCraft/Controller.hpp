@@ -66,6 +66,8 @@ public:
 		keys[G_KEY_SPACE] = GetKey(G_KEY_SPACE);
 		keys[G_KEY_CONTROL] = GetKey(G_KEY_CONTROL);
 		keys[G_KEY_LEFTSHIFT] = GetKey(G_KEY_LEFTSHIFT);
+		keys[G_KEY_1] = GetKey(G_KEY_1);
+		keys[G_KEY_2] = GetKey(G_KEY_2);
 		keys[G_BUTTON_LEFT] = GetKey(G_BUTTON_LEFT);
 		keys[G_BUTTON_RIGHT] = GetKey(G_BUTTON_RIGHT);
 
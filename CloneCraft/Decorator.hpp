@@ -0,0 +1,177 @@
+#ifndef DECORATOR_HPP
+#define DECORATOR_HPP
+
+
+#include "Chunk.hpp"
+#include "Biome.hpp"
+#include "Random.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+// one block a decoration wants to place, in world coords
+struct DecorationBlock {
+	int x;
+	int y;
+	int z;
+	BlockId id;
+};
+
+// which block stays when a decoration lands on something that's already there. the higher rank wins, so it
+// comes out the same whichever order the blocks arrive in. indexed by BlockId.
+static const unsigned char DECORATION_RANK[] = {
+	0, // Air
+	3, // Grass
+	4, // Dirt
+	7, // Stone
+	10, // Bedrock
+	5, // Sand
+	6, // Snow
+	2, // Log
+	1, // Leaves
+	8, // CoalOre
+	9, // IronOre
+	11, // Glowstone
+};
+static_assert(sizeof(DECORATION_RANK) == static_cast<size_t>(BlockId::NUM_TYPES), "every block needs a decoration rank");
+
+static bool outranks(BlockId id, BlockId existing) {
+	return DECORATION_RANK[static_cast<int>(id)] > DECORATION_RANK[static_cast<int>(existing)];
+}
+
+// Trees, boulders and ore veins, put on a chunk once its terrain is filled in.
+//
+// Ores stay inside the chunk and only replace stone, so they go straight in. Trees and boulders can hang over
+// into the chunks around it, so they're handed back as blocks in world coords for the world to place, now or
+// once the chunk they land in is generated.
+class Decorator {
+public:
+	static const int MAX_REACH = 2; // furthest a decoration can reach past the edge of its chunk
+	static const int TREE_ATTEMPTS = 8; // columns per chunk that might grow a tree, depending on their biome
+	static const int BOULDER_ATTEMPTS = 2;
+	static const int COAL_VEINS = 12;
+	static const int COAL_VEIN_SIZE = 8;
+	static const int COAL_MAX_Y = 128;
+	static const int IRON_VEINS = 6;
+	static const int IRON_VEIN_SIZE = 5;
+	static const int IRON_MAX_Y = 64;
+	static const int NUMBERS_PER_ATTEMPT = 4; // random numbers each tree or boulder attempt uses
+
+	// only looks at the chunk's own terrain, its biomes and its own random streams, so a chunk always gets the
+	// same decorations whichever order or thread chunks are generated on. blocks is cleared first.
+	void Decorate(Chunk& chunk, const Biome (&biomes)[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH], std::vector<DecorationBlock>& blocks) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		int chunkX = (int)chunk.position.x;
+		int chunkZ = (int)chunk.position.z;
+		blocks.clear();
+
+		// the top of the terrain before anything is put on it
+		int surface[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+		BlockId ground[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				surface[x][z] = chunk.columnTop[x][z] - 1;
+				ground[x][z] = surface[x][z] >= 0 ? chunk.getBlock(x, surface[x][z], z) : BlockId::Air;
+			}
+		}
+
+		RandomStream coal(AppGlobals::seed, chunkX, chunkZ, RandomFeature::CoalOre);
+		RandomStream iron(AppGlobals::seed, chunkX, chunkZ, RandomFeature::IronOre);
+		placeOres(chunk, coal, BlockId::CoalOre, COAL_VEINS, COAL_VEIN_SIZE, COAL_MAX_Y);
+		placeOres(chunk, iron, BlockId::IronOre, IRON_VEINS, IRON_VEIN_SIZE, IRON_MAX_Y);
+
+		// every attempt takes NUMBERS_PER_ATTEMPT numbers, all drawn in one go
+		uint32_t numbers[TREE_ATTEMPTS * NUMBERS_PER_ATTEMPT];
+		RandomStream(AppGlobals::seed, chunkX, chunkZ, RandomFeature::Trees).Fill(0, numbers, TREE_ATTEMPTS * NUMBERS_PER_ATTEMPT);
+		for (int attempt = 0; attempt < TREE_ATTEMPTS; attempt++) {
+			const uint32_t* number = &numbers[attempt * NUMBERS_PER_ATTEMPT];
+			int x = RandomStream::toRange(number[0], W);
+			int z = RandomStream::toRange(number[1], W);
+			float roll = RandomStream::toUnit(number[2]);
+			int trunkHeight = 4 + RandomStream::toRange(number[3], 3);
+			int y = surface[x][z];
+			bool soil = ground[x][z] == BlockId::Grass || ground[x][z] == BlockId::Dirt || ground[x][z] == BlockId::Snow;
+
+			if (soil && roll < BIOMES[static_cast<int>(biomes[x][z])].treeChance && y + trunkHeight + 2 < H) {
+				addTree(chunkX * W + x, y + 1, chunkZ * W + z, trunkHeight, blocks);
+			}
+		}
+
+		RandomStream(AppGlobals::seed, chunkX, chunkZ, RandomFeature::Boulders).Fill(0, numbers, BOULDER_ATTEMPTS * NUMBERS_PER_ATTEMPT);
+		for (int attempt = 0; attempt < BOULDER_ATTEMPTS; attempt++) {
+			const uint32_t* number = &numbers[attempt * NUMBERS_PER_ATTEMPT];
+			int x = RandomStream::toRange(number[0], W);
+			int z = RandomStream::toRange(number[1], W);
+			float roll = RandomStream::toUnit(number[2]);
+			int radius = 1 + RandomStream::toRange(number[3], MAX_REACH);
+			int y = surface[x][z];
+
+			if (y >= 0 && roll < BIOMES[static_cast<int>(biomes[x][z])].boulderChance && y + radius < H) {
+				addBoulder(chunkX * W + x, y, chunkZ * W + z, radius, blocks);
+			}
+		}
+	}
+
+private:
+	// random walks that turn the stone they pass through into ore. they're kept inside the chunk.
+	static void placeOres(Chunk& chunk, RandomStream& random, BlockId id, int veins, int veinSize, int maxY) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+
+		for (int vein = 0; vein < veins; vein++) {
+			int x = random.Range(W);
+			int y = random.Range(maxY);
+			int z = random.Range(W);
+
+			for (int i = 0; i < veinSize; i++) {
+				if (chunk.getBlock(x, y, z) == BlockId::Stone) {
+					chunk.SetBlock(id, Vec4(x, y, z, 0));
+				}
+
+				int step = random.Range(6);
+				x = std::min(std::max(x + FACE_OFFSETS[step][0], 0), W - 1);
+				y = std::min(std::max(y + FACE_OFFSETS[step][1], 0), maxY - 1);
+				z = std::min(std::max(z + FACE_OFFSETS[step][2], 0), W - 1);
+			}
+		}
+	}
+
+	// a trunk from y up with two wide layers of leaves around the top of it and two narrow ones above
+	static void addTree(int x, int y, int z, int trunkHeight, std::vector<DecorationBlock>& blocks) {
+		int top = y + trunkHeight; // first block above the trunk
+
+		for (int i = 0; i < trunkHeight; i++) {
+			blocks.push_back({ x, y + i, z, BlockId::Log });
+		}
+
+		for (int dy = -2; dy <= 1; dy++) {
+			int radius = dy < 0 ? MAX_REACH : 1;
+
+			for (int dx = -radius; dx <= radius; dx++) {
+				for (int dz = -radius; dz <= radius; dz++) {
+					bool corner = abs(dx) == radius && abs(dz) == radius;
+					bool trunk = dx == 0 && dz == 0 && dy < 0;
+					if (corner || trunk) {
+						continue;
+					}
+
+					blocks.push_back({ x + dx, top + dy, z + dz, BlockId::Leaves });
+				}
+			}
+		}
+	}
+
+	// a rough ball of stone half sunk into the ground
+	static void addBoulder(int x, int y, int z, int radius, std::vector<DecorationBlock>& blocks) {
+		for (int dx = -radius; dx <= radius; dx++) {
+			for (int dy = -radius; dy <= radius; dy++) {
+				for (int dz = -radius; dz <= radius; dz++) {
+					if (dx * dx + dy * dy + dz * dz <= radius * radius + radius && y + dy >= 0) {
+						blocks.push_back({ x + dx, y + dy, z + dz, BlockId::Stone });
+					}
+				}
+			}
+		}
+	}
+};
+#endif // DECORATOR_HPP
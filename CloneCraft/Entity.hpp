@@ -5,6 +5,7 @@
 class Entity {
 public:
 	Vec4 position = { 0, 0, 0, 0 };
+	Vec4 previousPosition = { 0, 0, 0, 0 }; // where the entity was before the last tick, to draw it in between
 	Vec4 rotation = { 0, 0, 0, 0 }; // the forward direction expressed as an angle of rotation around each axis
 	AABB bbox = AABB(Vec4(0, 0, 0, 0), Vec4(0, 0, 0, 0));
 	float height = 1.75f;
@@ -27,6 +28,16 @@ public:
 		bbox = box;
 	}
 
+	// how far above its feet the entity sees from
+	float GetEyeHeight() const {
+		return height - 0.05f;
+	}
+
+	// where the entity sees from, at its current position rather than where it's drawn
+	Vec4 GetEyePosition() const {
+		return Vec4(position.x, position.y + GetEyeHeight(), position.z, 0.f);
+	}
+
 	Vec4 GetForwardAxis() {
 		float a = rotation.y * RADIAN;
 		Vec4 r{ 0, 0, 1, 0 }; // +z axis is forward
@@ -2,6 +2,7 @@
 #define FRUSTUM_HPP
 
 #include <array>
+#include <cmath>
 
 class ViewFrustum {
 private:
@@ -17,119 +18,53 @@ private:
 	};
 
 public:
-	void update(Mat4& mat) // pass projViewMatrix to this function
+	// pass projViewMatrix to this function. it's row vector style like the rest of our matrices, so a point's clip
+	// coords are its dot products with the columns. each plane is which side of one of the clip bounds a point is
+	// on, with vulkan's 0 to w depth. a point is inside when x * plane.x + y * plane.y + z * plane.z + distance
+	// comes out positive for all six.
+	void update(Mat4& mat)
 	{
-		// left
-		m_planes[Planes::Left].distance = mat.row4.data[3] + mat.row4.data[0];
-		m_planes[Planes::Left].x = { mat.row1.data[3] - mat.row1.data[0] };
-		m_planes[Planes::Left].y = { mat.row2.data[3] - mat.row2.data[0] };
-		m_planes[Planes::Left].z = { mat.row3.data[3] - mat.row3.data[0] };
-
-		// right
-		m_planes[Planes::Right].distance = mat.row4.data[3] - mat.row4.data[0];
-		m_planes[Planes::Right].x = { mat.row1.data[3] - mat.row1.data[0] };
-		m_planes[Planes::Right].y = { mat.row2.data[3] - mat.row2.data[0] };
-		m_planes[Planes::Right].z = { mat.row3.data[3] - mat.row3.data[0] };
-
-		// bottom
-		m_planes[Planes::Bottom].distance = mat.row4.data[3] + mat.row4.data[1];
-		m_planes[Planes::Bottom].x = { mat.row1.data[3] + mat.row1.data[1] };
-		m_planes[Planes::Bottom].y = { mat.row2.data[3] + mat.row2.data[1] };
-		m_planes[Planes::Bottom].z = { mat.row3.data[3] - mat.row3.data[1] };
-
-		// top
-		m_planes[Planes::Top].distance = mat.row4.data[3] - mat.row4.data[1];
-		m_planes[Planes::Top].x = { mat.row1.data[3] + mat.row1.data[1] };
-		m_planes[Planes::Top].y = { mat.row2.data[3] + mat.row2.data[1] };
-		m_planes[Planes::Top].z = { mat.row3.data[3] - mat.row3.data[1] };
-
-		// near
-		m_planes[Planes::Near].distance = mat.row4.data[3] + mat.row4.data[2];
-		m_planes[Planes::Near].x = { mat.row1.data[3] + mat.row1.data[2] };
-		m_planes[Planes::Near].y = { mat.row2.data[3] + mat.row2.data[2] };
-		m_planes[Planes::Near].z = { mat.row3.data[3] + mat.row3.data[2] };
-
-		// far
-		m_planes[Planes::Far].distance = mat.row4.data[3] - mat.row4.data[2];
-		m_planes[Planes::Far].x = { mat.row1.data[3] - mat.row1.data[2] };
-		m_planes[Planes::Far].y = { mat.row2.data[3] - mat.row2.data[2] };
-		m_planes[Planes::Far].z = { mat.row3.data[3] - mat.row3.data[2] };
-
-		for (auto& plane : m_planes)
+		auto setPlane = [&](Planes which, int column, float sign, float w)
 		{
-			Vec4 normal( plane.x, plane.y, plane.z, 0.f );
-			float length = normal.Magnitude();
-			normal.x /= length;
-			normal.y /= length;
-			normal.z /= length;
+			auto& plane = m_planes[which];
+			plane.x = w * mat.row1.data[3] + sign * mat.row1.data[column];
+			plane.y = w * mat.row2.data[3] + sign * mat.row2.data[column];
+			plane.z = w * mat.row3.data[3] + sign * mat.row3.data[column];
+			plane.distance = w * mat.row4.data[3] + sign * mat.row4.data[column];
+
+			// normalized so the test below is a real distance
+			float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			plane.x /= length;
+			plane.y /= length;
+			plane.z /= length;
 			plane.distance /= length;
-		}
-	}
-
-	bool isBoxInFrustum(AABB& box)
-	{
-		auto getVNegative = [&](GW::MATH::GVECTORF& normal)
-		{
-			GW::MATH::GVECTORF res = { box.position.x, box.position.y, box.position.z, box.position.w };
-
-			if (normal.x < 0)
-			{
-				res.x += box.dimensions.x;
-			}
-			if (normal.y < 0)
-			{
-				res.y += box.dimensions.y;
-			}
-			if (normal.z < 0)
-			{
-				res.z += box.dimensions.z;
-			}
-
-			return res;
 		};
 
-		auto getVPositive = [&](GW::MATH::GVECTORF& normal)
-		{
-			GW::MATH::GVECTORF res = { box.position.x, box.position.y, box.position.z, box.position.w };
-
-			if (normal.x > 0)
-			{
-				res.x += box.dimensions.x;
-			}
-			if (normal.y > 0)
-			{
-				res.y += box.dimensions.y;
-			}
-			if (normal.z > 0)
-			{
-				res.z += box.dimensions.z;
-			}
-
-			return res;
-		};
-
-		bool result = true;
+		setPlane(Planes::Left, 0, 1.f, 1.f);		// -w <= x
+		setPlane(Planes::Right, 0, -1.f, 1.f);		// x <= w
+		setPlane(Planes::Bottom, 1, 1.f, 1.f);		// -w <= y
+		setPlane(Planes::Top, 1, -1.f, 1.f);		// y <= w
+		setPlane(Planes::Near, 2, 1.f, 0.f);		// 0 <= z
+		setPlane(Planes::Far, 2, -1.f, 1.f);		// z <= w
+	}
 
+	// false only if the box is all the way outside one of the planes. a box near a corner can still get through,
+	// which only means something gets drawn that didn't need to be
+	bool isBoxInFrustum(const AABB& box) const
+	{
 		for (auto& plane : m_planes)
 		{
-			float sqDistanceToPoint;
-			GW::MATH::GVECTORF normal = { plane.x, plane.y, plane.z, 0.f };
-			GW::MATH::GCollision::SqDistancePointToPlaneF(getVPositive(normal), plane, sqDistanceToPoint);
+			// the corner furthest along the plane's normal
+			float x = plane.x > 0 ? box.position.x + box.dimensions.x : box.position.x;
+			float y = plane.y > 0 ? box.position.y + box.dimensions.y : box.position.y;
+			float z = plane.z > 0 ? box.position.z + box.dimensions.z : box.position.z;
 
-			if (sqDistanceToPoint < 0)
+			if (x * plane.x + y * plane.y + z * plane.z + plane.distance < 0)
 			{
 				return false;
 			}
-			else
-			{
-				GW::MATH::GCollision::SqDistancePointToPlaneF(getVNegative(normal), plane, sqDistanceToPoint);
-				if (sqDistanceToPoint < 0)
-				{
-					result = true;
-				}
-			}
 		}
-		return result;
+		return true;
 	}
 
 	bool operator==(const ViewFrustum& other) const
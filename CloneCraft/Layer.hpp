@@ -6,6 +6,8 @@
 class Layer {
 public:
 	BlockId blocks[16][16];
+	unsigned char light[16][16]; // two nibbles per block. high: sky light, low: block light
+	unsigned short blockCount = 0; // how many blocks in this layer aren't air
 
 	Layer()
 	{
@@ -14,6 +16,7 @@ public:
 			for (size_t j = 0; j < AppGlobals::CHUNK_WIDTH; j++)
 			{
 				blocks[i][j] = BlockId::Air;
+				light[i][j] = 0;
 			}
 		}
 	}
@@ -27,8 +30,30 @@ public:
 
 	bool SetBlock(BlockId id, Vec4 blockPos)
 	{
-		blocks[(int)blockPos.x][(int)blockPos.z] = id;
+		BlockId& block = blocks[(int)blockPos.x][(int)blockPos.z];
+		blockCount += (id != BlockId::Air) - (block != BlockId::Air);
+		block = id;
 		return true;
 	}
+
+	unsigned char GetSkyLight(int x, int z)
+	{
+		return light[x][z] >> 4;
+	}
+
+	unsigned char GetBlockLight(int x, int z)
+	{
+		return light[x][z] & 0x0F;
+	}
+
+	void SetSkyLight(int x, int z, unsigned char level)
+	{
+		light[x][z] = (light[x][z] & 0x0F) | (level << 4);
+	}
+
+	void SetBlockLight(int x, int z, unsigned char level)
+	{
+		light[x][z] = (light[x][z] & 0xF0) | (level & 0x0F);
+	}
 };
 #endif // LAYER_HPP
\ No newline at end of file
@@ -0,0 +1,475 @@
+#ifndef LIGHTING_HPP
+#define LIGHTING_HPP
+
+
+#include "Chunk.hpp"
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+
+// A FIFO queue on top of a ring buffer. The storage is allocated once up front so flood filling light
+// doesn't touch the allocator on every push. It only grows (doubling) if a fill ever outruns it.
+template <typename T>
+class RingQueue {
+public:
+	RingQueue(size_t capacity) {
+		// keep the capacity a power of 2 so wrapping is a mask instead of a modulo
+		size_t size = 1;
+		while (size < capacity) {
+			size <<= 1;
+		}
+		buffer.resize(size);
+		mask = size - 1;
+	}
+
+	bool empty() const { return count == 0; }
+	size_t size() const { return count; }
+
+	void push(const T& value) {
+		if (count == buffer.size()) {
+			grow();
+		}
+
+		buffer[tail] = value;
+		tail = (tail + 1) & mask;
+		count++;
+	}
+
+	T pop() {
+		T value = buffer[head];
+		head = (head + 1) & mask;
+		count--;
+		return value;
+	}
+
+	void clear() {
+		head = tail = count = 0;
+	}
+
+private:
+	std::vector<T> buffer;
+	size_t mask = 0;
+	size_t head = 0;
+	size_t tail = 0;
+	size_t count = 0;
+
+	void grow() {
+		std::vector<T> bigger(buffer.size() * 2);
+		for (size_t i = 0; i < count; i++) {
+			bigger[i] = buffer[(head + i) & mask];
+		}
+
+		buffer.swap(bigger);
+		mask = buffer.size() - 1;
+		head = 0;
+		tail = count;
+	}
+};
+
+
+enum class LightChannel {
+	Sky,
+	Block
+};
+
+// a block in world coordinates waiting to be visited by a flood fill
+struct LightNode {
+	int x, y, z;
+	unsigned char level;
+};
+
+// how much work the light engine has done. kept for the last run and summed over the session.
+struct LightStats {
+	unsigned int lastCells = 0;
+	double lastMilliseconds = 0;
+	unsigned long long totalCells = 0;
+	double totalMilliseconds = 0;
+	unsigned int runs = 0;
+
+	double cellsPerSecond() const {
+		return totalMilliseconds > 0 ? totalCells / (totalMilliseconds / 1000.0) : 0;
+	}
+};
+
+
+// Keeps the sky light and block light of every generated chunk up to date.
+//
+// Sky light starts at 15 above the heightmap and spreads out from there. Block light starts at any
+// block that emits light. Both spread by breadth first flood fill, losing 1 level per block, except
+// that full sky light travels straight down without losing anything. Edits only flood the area the
+// edit can actually reach (at most 15 blocks in any direction) instead of relighting whole chunks.
+class LightEngine {
+public:
+	static const unsigned char MAX_LIGHT = 15;
+
+	LightStats chunkStats; // full chunk lighting when a chunk is generated
+	LightStats editStats; // incremental relighting after a block changes
+
+	LightEngine(std::unordered_map<Vec4, Chunk>& chunks, BlockDatabase& blockdb) :
+		chunkMap(chunks),
+		addQueue(1 << 16),
+		removeQueue(1 << 12) {
+		for (int i = 0; i < static_cast<int>(BlockId::NUM_TYPES); i++) {
+			opaque[i] = blockdb.blockDataFor(static_cast<BlockId>(i)).isOpaque();
+			emission[i] = blockdb.blockDataFor(static_cast<BlockId>(i)).getLightEmission();
+		}
+	}
+
+	// lights a freshly generated chunk and lets light flow between it and any generated neighbours.
+	// the chunk must already be marked as generated.
+	void initChunk(Chunk& chunk) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		cellsVisited = 0;
+		resetCache();
+
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		int chunkX = (int)chunk.position.x;
+		int chunkZ = (int)chunk.position.z;
+		int originX = chunkX * W;
+		int originZ = chunkZ * W;
+
+		// --- sky light --- //
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				chunk.heightMap[x][z] = findHeight(chunk, x, z, H);
+
+				for (int y = chunk.heightMap[x][z]; y < H; y++) {
+					chunk.setSkyLight(x, y, z, MAX_LIGHT);
+				}
+			}
+		}
+
+		// only the sky lit blocks that sit beside a taller column can light anything new, so only they
+		// need to be flooded from. everything else is already at 15 or has a 15 right above it.
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				int height = chunk.heightMap[x][z];
+				int highestNeighbour = height;
+
+				for (int face = 0; face < 6; face++) {
+					if (FACE_OFFSETS[face][1] != 0) {
+						continue;
+					}
+
+					int nx = originX + x + FACE_OFFSETS[face][0];
+					int nz = originZ + z + FACE_OFFSETS[face][2];
+					Chunk* neighbour = chunkAtWorld(nx, nz);
+					if (neighbour) {
+						int neighbourHeight = neighbour->heightMap[nx - floorDiv(nx, W) * W][nz - floorDiv(nz, W) * W];
+						if (neighbourHeight > highestNeighbour) {
+							highestNeighbour = neighbourHeight;
+						}
+					}
+				}
+
+				for (int y = height; y < highestNeighbour; y++) {
+					addQueue.push({ originX + x, y, originZ + z, MAX_LIGHT });
+				}
+			}
+		}
+
+		pullFromNeighbours(chunkX, chunkZ, LightChannel::Sky);
+		propagate(LightChannel::Sky);
+
+		// --- block light --- //
+		for (int y = 0; y < H; y++) {
+			for (int x = 0; x < W; x++) {
+				for (int z = 0; z < W; z++) {
+					unsigned char level = emission[static_cast<int>(chunk.getBlock(x, y, z))];
+					if (level > 0) {
+						chunk.setBlockLight(x, y, z, level);
+						addQueue.push({ originX + x, y, originZ + z, level });
+					}
+				}
+			}
+		}
+
+		pullFromNeighbours(chunkX, chunkZ, LightChannel::Block);
+		propagate(LightChannel::Block);
+
+		record(chunkStats, startTime);
+	}
+
+	// relights around a block that was just changed from oldId to newId. coords are world coords.
+	void updateBlock(int x, int y, int z, BlockId oldId, BlockId newId) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		cellsVisited = 0;
+		resetCache();
+
+		Chunk* chunk = chunkAtWorld(x, z);
+		if (!chunk || y < 0 || y >= AppGlobals::CHUNK_HEIGHT) {
+			return;
+		}
+
+		int lx = localCoord(x);
+		int lz = localCoord(z);
+		updateHeight(*chunk, lx, y, lz, newId);
+
+		bool newOpaque = opaque[static_cast<int>(newId)];
+
+		for (int c = 0; c < 2; c++) {
+			LightChannel channel = c == 0 ? LightChannel::Sky : LightChannel::Block;
+
+			// take away whatever light was here and everything that depended on it
+			unsigned char oldLevel = getLight(channel, *chunk, lx, y, lz);
+			if (oldLevel > 0) {
+				setLight(channel, *chunk, lx, y, lz, 0);
+				removeQueue.push({ x, y, z, oldLevel });
+				unpropagate(channel);
+			}
+
+			if (!newOpaque) {
+				if (channel == LightChannel::Sky && y >= chunk->heightMap[lx][lz]) {
+					// open to the sky
+					setLight(channel, *chunk, lx, y, lz, MAX_LIGHT);
+					addQueue.push({ x, y, z, MAX_LIGHT });
+				}
+				else {
+					// let the neighbours flow back in
+					for (int face = 0; face < 6; face++) {
+						int nx = x + FACE_OFFSETS[face][0];
+						int ny = y + FACE_OFFSETS[face][1];
+						int nz = z + FACE_OFFSETS[face][2];
+						if (ny < 0 || ny >= AppGlobals::CHUNK_HEIGHT) {
+							continue;
+						}
+
+						Chunk* neighbour = chunkAtWorld(nx, nz);
+						if (neighbour) {
+							unsigned char level = getLight(channel, *neighbour, localCoord(nx), ny, localCoord(nz));
+							if (level > 1) {
+								addQueue.push({ nx, ny, nz, level });
+							}
+						}
+					}
+				}
+			}
+
+			if (channel == LightChannel::Block && emission[static_cast<int>(newId)] > 0) {
+				unsigned char level = emission[static_cast<int>(newId)];
+				if (level > getLight(channel, *chunk, lx, y, lz)) {
+					setLight(channel, *chunk, lx, y, lz, level);
+				}
+				addQueue.push({ x, y, z, level });
+			}
+
+			propagate(channel);
+		}
+
+		chunk->meshDirty = true;
+		record(editStats, startTime);
+	}
+
+private:
+	std::unordered_map<Vec4, Chunk>& chunkMap;
+	RingQueue<LightNode> addQueue;
+	RingQueue<LightNode> removeQueue;
+	bool opaque[static_cast<int>(BlockId::NUM_TYPES)];
+	unsigned char emission[static_cast<int>(BlockId::NUM_TYPES)];
+	unsigned int cellsVisited = 0;
+
+	// flood fills tend to stay inside one chunk for long stretches, so remember the last one we found
+	Chunk* cachedChunk = nullptr;
+	int cachedChunkX = 0;
+	int cachedChunkZ = 0;
+	bool cacheValid = false;
+
+	void resetCache() {
+		cacheValid = false;
+		cachedChunk = nullptr;
+	}
+
+	static int localCoord(int worldCoord) {
+		return worldCoord - floorDiv(worldCoord, AppGlobals::CHUNK_WIDTH) * AppGlobals::CHUNK_WIDTH;
+	}
+
+	// returns the generated chunk that holds the world x/z coords, or nullptr if there isn't one
+	Chunk* chunkAtWorld(int x, int z) {
+		int chunkX = floorDiv(x, AppGlobals::CHUNK_WIDTH);
+		int chunkZ = floorDiv(z, AppGlobals::CHUNK_WIDTH);
+
+		if (cacheValid && chunkX == cachedChunkX && chunkZ == cachedChunkZ) {
+			return cachedChunk;
+		}
+
+		auto it = chunkMap.find(Vec4(chunkX, 0, chunkZ, 0));
+		cachedChunk = (it != chunkMap.end() && it->second.isGenerated) ? &it->second : nullptr;
+		cachedChunkX = chunkX;
+		cachedChunkZ = chunkZ;
+		cacheValid = true;
+		return cachedChunk;
+	}
+
+	unsigned char getLight(LightChannel channel, Chunk& chunk, int x, int y, int z) {
+		return channel == LightChannel::Sky ? chunk.getSkyLight(x, y, z) : chunk.getBlockLight(x, y, z);
+	}
+
+	void setLight(LightChannel channel, Chunk& chunk, int x, int y, int z, unsigned char level) {
+		if (channel == LightChannel::Sky) {
+			chunk.setSkyLight(x, y, z, level);
+		}
+		else {
+			chunk.setBlockLight(x, y, z, level);
+		}
+	}
+
+	// y of the first block above the highest opaque block in a column, searching down from startY
+	int findHeight(Chunk& chunk, int x, int z, int startY) {
+		int y = startY;
+		while (y > 0 && !opaque[static_cast<int>(chunk.getBlock(x, y - 1, z))]) {
+			y--;
+		}
+		return y;
+	}
+
+	void updateHeight(Chunk& chunk, int x, int y, int z, BlockId newId) {
+		short& height = chunk.heightMap[x][z];
+
+		if (opaque[static_cast<int>(newId)]) {
+			if (y + 1 > height) {
+				height = y + 1;
+			}
+		}
+		else if (y + 1 == height) {
+			height = findHeight(chunk, x, z, y);
+		}
+	}
+
+	// queues up the light sitting along the edges of generated neighbours so it can flow into a new chunk
+	void pullFromNeighbours(int chunkX, int chunkZ, LightChannel channel) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+
+		for (int face = 0; face < 6; face++) {
+			if (FACE_OFFSETS[face][1] != 0) {
+				continue;
+			}
+
+			int dx = FACE_OFFSETS[face][0];
+			int dz = FACE_OFFSETS[face][2];
+			Chunk* neighbour = chunkAtWorld((chunkX + dx) * W, (chunkZ + dz) * W);
+			if (!neighbour) {
+				continue;
+			}
+
+			for (int i = 0; i < W; i++) {
+				// the row of the neighbour that touches this chunk
+				int lx = dx == 0 ? i : (dx > 0 ? 0 : W - 1);
+				int lz = dz == 0 ? i : (dz > 0 ? 0 : W - 1);
+
+				for (int y = 0; y < AppGlobals::CHUNK_HEIGHT; y++) {
+					unsigned char level = getLight(channel, *neighbour, lx, y, lz);
+					if (level > 1) {
+						addQueue.push({ (chunkX + dx) * W + lx, y, (chunkZ + dz) * W + lz, level });
+					}
+				}
+			}
+		}
+	}
+
+	// breadth first flood fill out of everything in the add queue
+	void propagate(LightChannel channel) {
+		while (!addQueue.empty()) {
+			LightNode node = addQueue.pop();
+			Chunk* chunk = chunkAtWorld(node.x, node.z);
+			if (!chunk) {
+				continue;
+			}
+
+			// read the level back instead of trusting the node. it may have been raised since it was queued
+			unsigned char level = getLight(channel, *chunk, localCoord(node.x), node.y, localCoord(node.z));
+			if (level <= 1) {
+				continue;
+			}
+
+			for (int face = 0; face < 6; face++) {
+				int nx = node.x + FACE_OFFSETS[face][0];
+				int ny = node.y + FACE_OFFSETS[face][1];
+				int nz = node.z + FACE_OFFSETS[face][2];
+				if (ny < 0 || ny >= AppGlobals::CHUNK_HEIGHT) {
+					continue;
+				}
+
+				Chunk* neighbour = chunkAtWorld(nx, nz);
+				if (!neighbour) {
+					continue;
+				}
+
+				int lx = localCoord(nx);
+				int lz = localCoord(nz);
+				if (opaque[static_cast<int>(neighbour->getBlock(lx, ny, lz))]) {
+					continue;
+				}
+
+				bool straightDown = channel == LightChannel::Sky && face == static_cast<int>(BlockFace::NegY) && level == MAX_LIGHT;
+				unsigned char newLevel = straightDown ? MAX_LIGHT : level - 1;
+
+				if (getLight(channel, *neighbour, lx, ny, lz) < newLevel) {
+					setLight(channel, *neighbour, lx, ny, lz, newLevel);
+					neighbour->meshDirty = true;
+					addQueue.push({ nx, ny, nz, newLevel });
+					cellsVisited++;
+				}
+			}
+		}
+	}
+
+	// breadth first removal of everything in the remove queue. each node holds the level the block had
+	// before it went dark. any neighbour that couldn't have got its light from there is lit from
+	// somewhere else, so it goes in the add queue to refill the hole afterwards.
+	void unpropagate(LightChannel channel) {
+		while (!removeQueue.empty()) {
+			LightNode node = removeQueue.pop();
+
+			for (int face = 0; face < 6; face++) {
+				int nx = node.x + FACE_OFFSETS[face][0];
+				int ny = node.y + FACE_OFFSETS[face][1];
+				int nz = node.z + FACE_OFFSETS[face][2];
+				if (ny < 0 || ny >= AppGlobals::CHUNK_HEIGHT) {
+					continue;
+				}
+
+				Chunk* neighbour = chunkAtWorld(nx, nz);
+				if (!neighbour) {
+					continue;
+				}
+
+				int lx = localCoord(nx);
+				int lz = localCoord(nz);
+				unsigned char level = getLight(channel, *neighbour, lx, ny, lz);
+				if (level == 0) {
+					continue;
+				}
+
+				bool straightDown = channel == LightChannel::Sky && face == static_cast<int>(BlockFace::NegY) && node.level == MAX_LIGHT;
+
+				if (level < node.level || straightDown) {
+					setLight(channel, *neighbour, lx, ny, lz, 0);
+					neighbour->meshDirty = true;
+					removeQueue.push({ nx, ny, nz, level });
+					cellsVisited++;
+
+					// a dimmer light source still shines on its own, so it lights its part of the hole back up
+					unsigned char emitted = channel == LightChannel::Block ? emission[static_cast<int>(neighbour->getBlock(lx, ny, lz))] : 0;
+					if (emitted > 0) {
+						setLight(channel, *neighbour, lx, ny, lz, emitted);
+						addQueue.push({ nx, ny, nz, emitted });
+					}
+				}
+				else {
+					addQueue.push({ nx, ny, nz, level });
+				}
+			}
+		}
+	}
+
+	void record(LightStats& stats, std::chrono::high_resolution_clock::time_point startTime) {
+		auto endTime = std::chrono::high_resolution_clock::now();
+		stats.lastCells = cellsVisited;
+		stats.lastMilliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		stats.totalCells += cellsVisited;
+		stats.totalMilliseconds += stats.lastMilliseconds;
+		stats.runs++;
+	}
+};
+#endif // LIGHTING_HPP
@@ -0,0 +1,238 @@
+#ifndef MAP_RENDERER_HPP
+#define MAP_RENDERER_HPP
+
+
+#include "ChunkGenerator.hpp"
+#include "WorldSave.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// the chunks a map covers: a square or circle of chunks around a chunk, or every chunk if radius is -1
+struct MapRegion {
+	int centerX = 0;
+	int centerZ = 0;
+	int radius = -1;
+	bool circle = false;
+
+	bool Contains(int chunkX, int chunkZ) const {
+		if (radius < 0) {
+			return true;
+		}
+		int dx = chunkX - centerX;
+		int dz = chunkZ - centerZ;
+		if (circle) {
+			return dx * dx + dz * dz <= radius * radius;
+		}
+		return std::abs(dx) <= radius && std::abs(dz) <= radius;
+	}
+};
+
+// what a map pixel looks like for the top block of a column. indexed by BlockId.
+static const unsigned char MAP_COLORS[][3] = {
+	{ 0, 0, 0 }, // Air
+	{ 95, 159, 53 }, // Grass
+	{ 134, 96, 67 }, // Dirt
+	{ 125, 125, 125 }, // Stone
+	{ 50, 50, 50 }, // Bedrock
+	{ 219, 207, 163 }, // Sand
+	{ 240, 250, 250 }, // Snow
+	{ 102, 81, 51 }, // Log
+	{ 58, 110, 38 }, // Leaves
+	{ 90, 90, 90 }, // CoalOre
+	{ 150, 130, 115 }, // IronOre
+	{ 240, 200, 110 }, // Glowstone
+};
+static_assert(sizeof(MAP_COLORS) / sizeof(MAP_COLORS[0]) == static_cast<size_t>(BlockId::NUM_TYPES), "every block needs a map color");
+
+// Top-down pictures of the world, one pixel to a block, a tile of TILE_CHUNKS by TILE_CHUNKS chunks at a time.
+// Chunks come from a save, or from the generator if there's no save, and a tile never holds more than one chunk
+// at once: each chunk is boiled down to the height and block at the top of its columns as soon as it's loaded.
+// The chunks in a ring around the tile are looked at too, for the trees and boulders that reach into it, so a tile
+// comes out the same as the world would in game. A renderer keeps a generator, so each thread needs its own.
+class MapRenderer {
+public:
+	static const int TILE_CHUNKS = 16;
+	static const int TILE_PIXELS = TILE_CHUNKS * AppGlobals::CHUNK_WIDTH;
+
+	unsigned long long loadedChunks = 0;
+	unsigned long long generatedChunks = 0;
+
+	// chunks come from save if it isn't null, and from the generator otherwise. either way only chunks in region
+	MapRenderer(WorldSave* save, const MapRegion& region) : save(save), region(region) {}
+
+	bool HasChunk(int chunkX, int chunkZ) const {
+		return region.Contains(chunkX, chunkZ) && (!save || save->Has(chunkX, chunkZ));
+	}
+
+	// changes whenever anything the tile would be drawn from changes: which chunks there are in and around it
+	// and, for a save, which record each of them is. 0 if the tile has nothing in it.
+	uint32_t Fingerprint(int tileX, int tileZ) const {
+		uint32_t hash = 2166136261u;
+		bool any = false;
+		for (int chunkX = tileX * TILE_CHUNKS - 1; chunkX <= (tileX + 1) * TILE_CHUNKS; chunkX++) {
+			for (int chunkZ = tileZ * TILE_CHUNKS - 1; chunkZ <= (tileZ + 1) * TILE_CHUNKS; chunkZ++) {
+				if (!HasChunk(chunkX, chunkZ)) {
+					continue;
+				}
+				any |= inTile(tileX, tileZ, chunkX, chunkZ);
+				long long record = save ? save->GetRecordOffset(chunkX, chunkZ) : 0;
+				int32_t values[4] = { chunkX, chunkZ, (int32_t)record, (int32_t)(record >> 32) };
+				const unsigned char* bytes = (const unsigned char*)values;
+				for (size_t i = 0; i < sizeof(values); i++) {
+					hash = (hash ^ bytes[i]) * 16777619u;
+				}
+			}
+		}
+		return any ? (hash ? hash : 1) : 0;
+	}
+
+	// draws a tile into rgba, TILE_PIXELS square with x to the right and z down. columns of chunks that aren't
+	// there are left clear. returns false if none of the tile's chunks are there.
+	bool RenderTile(int tileX, int tileZ, std::vector<unsigned char>& rgba) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int B = BORDER_PIXELS;
+		heights.assign(BORDER_WIDTH * BORDER_WIDTH, NO_COLUMN);
+		tops.assign(BORDER_WIDTH * BORDER_WIDTH, BlockId::Air);
+		bool any = false;
+
+		// the tile's chunks and the ring around them. the ring only adds its decorations and the edge the shading
+		// needs, so the columns it fills in past the border are thrown away
+		decorations.clear();
+		for (int chunkX = tileX * TILE_CHUNKS - 1; chunkX <= (tileX + 1) * TILE_CHUNKS; chunkX++) {
+			for (int chunkZ = tileZ * TILE_CHUNKS - 1; chunkZ <= (tileZ + 1) * TILE_CHUNKS; chunkZ++) {
+				if (!HasChunk(chunkX, chunkZ)) {
+					continue;
+				}
+				std::unique_ptr<Chunk> chunk(new Chunk(Vec4((float)chunkX, 0.f, (float)chunkZ, 0.f)));
+				if (!getChunk(*chunk, outgoing)) {
+					continue;
+				}
+				any |= inTile(tileX, tileZ, chunkX, chunkZ);
+				decorations.insert(decorations.end(), outgoing.begin(), outgoing.end());
+
+				for (int x = 0; x < W; x++) {
+					for (int z = 0; z < W; z++) {
+						int px = (chunkX - tileX * TILE_CHUNKS) * W + x + B;
+						int pz = (chunkZ - tileZ * TILE_CHUNKS) * W + z + B;
+						if (px < 0 || pz < 0 || px >= BORDER_WIDTH || pz >= BORDER_WIDTH) {
+							continue;
+						}
+						int top = chunk->columnTop[x][z];
+						heights[px * BORDER_WIDTH + pz] = (short)top;
+						tops[px * BORDER_WIDTH + pz] = top > 0 ? chunk->getBlock(x, top - 1, z) : BlockId::Air;
+					}
+				}
+			}
+		}
+		if (!any) {
+			return false;
+		}
+
+		// decoration blocks only change the top of a column if they land on it or above it, and the same ranks as
+		// mergeDecorationBlock decide which one stays
+		for (auto& block : decorations) {
+			int px = block.x - tileX * TILE_PIXELS + B;
+			int pz = block.z - tileZ * TILE_PIXELS + B;
+			if (px < 0 || pz < 0 || px >= BORDER_WIDTH || pz >= BORDER_WIDTH || heights[px * BORDER_WIDTH + pz] == NO_COLUMN) {
+				continue;
+			}
+			short& height = heights[px * BORDER_WIDTH + pz];
+			BlockId& top = tops[px * BORDER_WIDTH + pz];
+			if (block.y >= height) {
+				height = (short)(block.y + 1);
+				top = block.id;
+			}
+			else if (block.y == height - 1 && outranks(block.id, top)) {
+				top = block.id;
+			}
+		}
+
+		rgba.assign(TILE_PIXELS * TILE_PIXELS * 4, 0);
+		for (int x = 0; x < TILE_PIXELS; x++) {
+			for (int z = 0; z < TILE_PIXELS; z++) {
+				int height = heights[(x + B) * BORDER_WIDTH + z + B];
+				if (height == NO_COLUMN || height == 0) {
+					continue;
+				}
+
+				// lit from the north west. a column the shading can't see past counts as level with this one
+				int west = heights[(x + B - 1) * BORDER_WIDTH + z + B];
+				int north = heights[(x + B) * BORDER_WIDTH + z + B - 1];
+				int slope = (west == NO_COLUMN ? 0 : height - west) + (north == NO_COLUMN ? 0 : height - north);
+				float shade = std::min(std::max(1.f + 0.08f * slope, 0.6f), 1.3f) * (0.8f + 0.4f * height / AppGlobals::CHUNK_HEIGHT);
+
+				const unsigned char* color = MAP_COLORS[static_cast<int>(tops[(x + B) * BORDER_WIDTH + z + B])];
+				unsigned char* pixel = &rgba[(z * TILE_PIXELS + x) * 4];
+				for (int c = 0; c < 3; c++) {
+					pixel[c] = (unsigned char)std::min(color[c] * shade, 255.f);
+				}
+				pixel[3] = 255;
+			}
+		}
+		return true;
+	}
+
+	// a tile of the next zoom level out from the four tiles under it, any of which can be null if it's empty.
+	// children go x then z: (0, 0), (1, 0), (0, 1), (1, 1). clear pixels don't count towards the color.
+	static void Downsample(const unsigned char* const children[4], std::vector<unsigned char>& rgba) {
+		const int half = TILE_PIXELS / 2;
+		rgba.assign(TILE_PIXELS * TILE_PIXELS * 4, 0);
+		for (int child = 0; child < 4; child++) {
+			if (!children[child]) {
+				continue;
+			}
+			int offsetX = (child & 1) * half;
+			int offsetZ = (child >> 1) * half;
+			for (int z = 0; z < half; z++) {
+				for (int x = 0; x < half; x++) {
+					int sum[4] = {};
+					for (int i = 0; i < 4; i++) {
+						const unsigned char* source = &children[child][((z * 2 + (i >> 1)) * TILE_PIXELS + x * 2 + (i & 1)) * 4];
+						for (int c = 0; c < 3; c++) {
+							sum[c] += source[c] * source[3];
+						}
+						sum[3] += source[3];
+					}
+					if (sum[3] == 0) {
+						continue;
+					}
+					unsigned char* pixel = &rgba[((offsetZ + z) * TILE_PIXELS + offsetX + x) * 4];
+					for (int c = 0; c < 3; c++) {
+						pixel[c] = (unsigned char)(sum[c] / sum[3]);
+					}
+					pixel[3] = (unsigned char)(sum[3] / 4);
+				}
+			}
+		}
+	}
+
+private:
+	static const int BORDER_PIXELS = 1; // past the tile on every side, for the shading
+	static const int BORDER_WIDTH = TILE_PIXELS + BORDER_PIXELS * 2;
+	static const short NO_COLUMN = -1; // a column of a chunk that isn't there
+
+	WorldSave* save;
+	MapRegion region;
+	ChunkGenerator generator;
+	std::vector<short> heights; // the top of every column in the tile and its border, x major
+	std::vector<BlockId> tops; // the block at the top of every column
+	std::vector<DecorationBlock> outgoing;
+	std::vector<DecorationBlock> decorations; // from every chunk looked at for the tile
+
+	static bool inTile(int tileX, int tileZ, int chunkX, int chunkZ) {
+		return floorDiv(chunkX, TILE_CHUNKS) == tileX && floorDiv(chunkZ, TILE_CHUNKS) == tileZ;
+	}
+
+	bool getChunk(Chunk& chunk, std::vector<DecorationBlock>& blocks) {
+		if (save) {
+			loadedChunks++;
+			return save->Load(chunk, blocks);
+		}
+		generator.Generate(chunk, blocks);
+		generatedChunks++;
+		return true;
+	}
+};
+#endif // MAP_RENDERER_HPP
@@ -47,4 +47,13 @@ float clamp(float value, float lowerBound, float upperBound) {
 	}
 }
 
+// integer division that rounds towards negative infinity. ie: -1 / 16 is -1, not 0
+int floorDiv(int value, int divisor) {
+	int quotient = value / divisor;
+	if ((value % divisor != 0) && ((value < 0) != (divisor < 0))) {
+		quotient--;
+	}
+	return quotient;
+}
+
 #endif // MATH_HPP
\ No newline at end of file
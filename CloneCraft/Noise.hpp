@@ -0,0 +1,380 @@
+#ifndef NOISE_HPP
+#define NOISE_HPP
+
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NOISE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOISE_SSE2
+#endif
+
+// the gradient table libnoise uses, wrapped in our own namespace so it can't clash with the copy in libnoise.lib
+namespace NoiseTables {
+#include "noise/vectortable.h"
+}
+
+// Multi octave gradient noise that gives exactly the same values as libnoise's module::Perlin with the same
+// settings, without going through a virtual call per point or needing libnoise at all. The batch functions
+// run 8 points at a time, as 2 lots of 4 doubles with AVX2 or 4 lots of 2 with SSE2. It has to be doubles
+// rather than 8 floats to land on the same values as libnoise.
+class PerlinNoise {
+public:
+	static const int BATCH_SIZE = 8;
+
+	enum class Quality {
+		Fast, // linear
+		Standard, // cubic s-curve
+		Best, // quintic s-curve
+	};
+
+	double frequency = 1.0;
+	double lacunarity = 2.0;
+	double persistence = 0.5;
+	int octaveCount = 6;
+	int seed = 0;
+	Quality quality = Quality::Standard;
+
+	// one point. this is libnoise's code almost line for line and is what the batches have to match.
+	double GetValue(double x, double y, double z) const {
+		double value = 0.0;
+		double curPersistence = 1.0;
+
+		x *= frequency;
+		y *= frequency;
+		z *= frequency;
+
+		for (int octave = 0; octave < octaveCount; octave++) {
+			double signal = gradientCoherentNoise(makeInt32Range(x), makeInt32Range(y), makeInt32Range(z), (seed + octave) & 0xffffffff);
+			value += signal * curPersistence;
+
+			x *= lacunarity;
+			y *= lacunarity;
+			z *= lacunarity;
+			curPersistence *= persistence;
+		}
+
+		return value;
+	}
+
+	// count points at a time. out can't be one of the inputs.
+	void GetValues(const double* x, const double* y, const double* z, double* out, int count) const {
+		int i = 0;
+
+		#if defined(NOISE_AVX2) || defined(NOISE_SSE2)
+		for (; i + BATCH_SIZE <= count; i += BATCH_SIZE) {
+			getBatch(x + i, y + i, z + i, out + i);
+		}
+		#endif
+
+		for (; i < count; i++) {
+			out[i] = GetValue(x[i], y[i], z[i]);
+		}
+	}
+
+	// one octave of gradient noise at coordinates that have already been scaled by the octave's frequency.
+	// Perlin, Billow and RidgedMulti are all sums of these. out can't be one of the inputs.
+	void GetOctaveValues(const double* x, const double* y, const double* z, double* out, int count, int octaveSeed) const {
+		int i = 0;
+
+		#if defined(NOISE_AVX2) || defined(NOISE_SSE2)
+		for (; i + LANE_WIDTH <= count; i += LANE_WIDTH) {
+			Lane lx = load(x + i);
+			Lane ly = load(y + i);
+			Lane lz = load(z + i);
+
+			if (laneInRange(lx) && laneInRange(ly) && laneInRange(lz)) {
+				store(out + i, gradientCoherentNoise(lx, ly, lz, octaveSeed));
+				continue;
+			}
+
+			for (int j = i; j < i + LANE_WIDTH; j++) {
+				out[j] = gradientCoherentNoise(makeInt32Range(x[j]), makeInt32Range(y[j]), makeInt32Range(z[j]), octaveSeed);
+			}
+		}
+		#endif
+
+		for (; i < count; i++) {
+			out[i] = gradientCoherentNoise(makeInt32Range(x[i]), makeInt32Range(y[i]), makeInt32Range(z[i]), octaveSeed);
+		}
+	}
+
+private:
+	static const int X_NOISE_GEN = 1619;
+	static const int Y_NOISE_GEN = 31337;
+	static const int Z_NOISE_GEN = 6971;
+	static const int SEED_NOISE_GEN = 1013;
+	static const int SHIFT_NOISE_GEN = 8;
+
+	// libnoise wraps coordinates into the int range before flooring them. the batches skip this and fall
+	// back to one point at a time if anything could get that big.
+	static double makeInt32Range(double n) {
+		if (n >= 1073741824.0) {
+			return (2.0 * fmod(n, 1073741824.0)) - 1073741824.0;
+		}
+		else if (n <= -1073741824.0) {
+			return (2.0 * fmod(n, 1073741824.0)) + 1073741824.0;
+		}
+		return n;
+	}
+
+	static double linearInterp(double n0, double n1, double a) {
+		return ((1.0 - a) * n0) + (a * n1);
+	}
+
+	double sCurve(double a) const {
+		switch (quality) {
+			case Quality::Fast:
+				return a;
+			case Quality::Standard:
+				return (a * a * (3.0 - 2.0 * a));
+			default: {
+				double a3 = a * a * a;
+				double a4 = a3 * a;
+				double a5 = a4 * a;
+				return (6.0 * a5) - (15.0 * a4) + (10.0 * a3);
+			}
+		}
+	}
+
+	static int hashIndex(int hash) {
+		hash ^= (hash >> SHIFT_NOISE_GEN);
+		return (hash & 0xff) << 2;
+	}
+
+	static double gradientNoise(double fx, double fy, double fz, int ix, int iy, int iz, int seed) {
+		// unsigned so the wrap around is defined. it's the same bits libnoise gets from its int maths.
+		unsigned int hash = (unsigned int)X_NOISE_GEN * ix + (unsigned int)Y_NOISE_GEN * iy + (unsigned int)Z_NOISE_GEN * iz + (unsigned int)SEED_NOISE_GEN * seed;
+		const double* gradient = &NoiseTables::noise::g_randomVectors[hashIndex((int)hash)];
+
+		double xvPoint = (fx - (double)ix);
+		double yvPoint = (fy - (double)iy);
+		double zvPoint = (fz - (double)iz);
+
+		return ((gradient[0] * xvPoint) + (gradient[1] * yvPoint) + (gradient[2] * zvPoint)) * 2.12;
+	}
+
+	double gradientCoherentNoise(double x, double y, double z, int seed) const {
+		// not floor. libnoise puts whole numbers <= 0 in the cell below
+		int x0 = (x > 0.0 ? (int)x : (int)x - 1);
+		int y0 = (y > 0.0 ? (int)y : (int)y - 1);
+		int z0 = (z > 0.0 ? (int)z : (int)z - 1);
+		int x1 = x0 + 1;
+		int y1 = y0 + 1;
+		int z1 = z0 + 1;
+
+		double xs = sCurve(x - (double)x0);
+		double ys = sCurve(y - (double)y0);
+		double zs = sCurve(z - (double)z0);
+
+		double n0, n1, ix0, ix1, iy0, iy1;
+		n0 = gradientNoise(x, y, z, x0, y0, z0, seed);
+		n1 = gradientNoise(x, y, z, x1, y0, z0, seed);
+		ix0 = linearInterp(n0, n1, xs);
+		n0 = gradientNoise(x, y, z, x0, y1, z0, seed);
+		n1 = gradientNoise(x, y, z, x1, y1, z0, seed);
+		ix1 = linearInterp(n0, n1, xs);
+		iy0 = linearInterp(ix0, ix1, ys);
+		n0 = gradientNoise(x, y, z, x0, y0, z1, seed);
+		n1 = gradientNoise(x, y, z, x1, y0, z1, seed);
+		ix0 = linearInterp(n0, n1, xs);
+		n0 = gradientNoise(x, y, z, x0, y1, z1, seed);
+		n1 = gradientNoise(x, y, z, x1, y1, z1, seed);
+		ix1 = linearInterp(n0, n1, xs);
+		iy1 = linearInterp(ix0, ix1, ys);
+		return linearInterp(iy0, iy1, zs);
+	}
+
+	// true if none of the coordinates can reach makeInt32Range's limit by the last octave
+	bool batchInRange(const double* x, const double* y, const double* z) const {
+		double scale = fabs(frequency);
+		for (int octave = 1; octave < octaveCount; octave++) {
+			scale *= fabs(lacunarity);
+		}
+
+		for (int i = 0; i < BATCH_SIZE; i++) {
+			if (fabs(x[i]) * scale >= 536870912.0 || fabs(y[i]) * scale >= 536870912.0 || fabs(z[i]) * scale >= 536870912.0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	#if defined(NOISE_AVX2)
+	typedef __m256d Lane;
+	static const int LANE_WIDTH = 4;
+
+	static Lane load(const double* p) { return _mm256_loadu_pd(p); }
+	static void store(double* p, Lane v) { _mm256_storeu_pd(p, v); }
+	static Lane set1(double v) { return _mm256_set1_pd(v); }
+	static Lane add(Lane a, Lane b) { return _mm256_add_pd(a, b); }
+	static Lane sub(Lane a, Lane b) { return _mm256_sub_pd(a, b); }
+	static Lane mul(Lane a, Lane b) { return _mm256_mul_pd(a, b); }
+
+	// the cell each point is in, using libnoise's rounding
+	static void cell(Lane v, __m128i& cellInt, Lane& cellDouble) {
+		__m128i truncated = _mm256_cvttpd_epi32(v);
+		__m128i positive = _mm256_cvttpd_epi32(_mm256_and_pd(_mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_GT_OQ), _mm256_set1_pd(1.0)));
+		cellInt = _mm_sub_epi32(_mm_add_epi32(truncated, positive), _mm_set1_epi32(1));
+		cellDouble = _mm256_cvtepi32_pd(cellInt);
+	}
+
+	// makeInt32Range leaves anything strictly inside +-2^30 alone
+	static bool laneInRange(Lane v) {
+		Lane magnitude = _mm256_andnot_pd(_mm256_set1_pd(-0.0), v);
+		return _mm256_movemask_pd(_mm256_cmp_pd(magnitude, _mm256_set1_pd(1073741824.0), _CMP_LT_OQ)) == 0xf;
+	}
+
+	static __m128i mulInt(__m128i a, int b) { return _mm_mullo_epi32(a, _mm_set1_epi32(b)); }
+	static __m128i addInt(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+
+	static void gradients(__m128i hash, Lane& gx, Lane& gy, Lane& gz) {
+		__m128i index = _mm_slli_epi32(_mm_and_si128(_mm_xor_si128(hash, _mm_srai_epi32(hash, SHIFT_NOISE_GEN)), _mm_set1_epi32(0xff)), 2);
+		const double* table = NoiseTables::noise::g_randomVectors;
+		gx = _mm256_i32gather_pd(table, index, 8);
+		gy = _mm256_i32gather_pd(table + 1, index, 8);
+		gz = _mm256_i32gather_pd(table + 2, index, 8);
+	}
+	#elif defined(NOISE_SSE2)
+	typedef __m128d Lane;
+	static const int LANE_WIDTH = 2;
+
+	static Lane load(const double* p) { return _mm_loadu_pd(p); }
+	static void store(double* p, Lane v) { _mm_storeu_pd(p, v); }
+	static Lane set1(double v) { return _mm_set1_pd(v); }
+	static Lane add(Lane a, Lane b) { return _mm_add_pd(a, b); }
+	static Lane sub(Lane a, Lane b) { return _mm_sub_pd(a, b); }
+	static Lane mul(Lane a, Lane b) { return _mm_mul_pd(a, b); }
+
+	static void cell(Lane v, __m128i& cellInt, Lane& cellDouble) {
+		__m128i truncated = _mm_cvttpd_epi32(v);
+		__m128i positive = _mm_cvttpd_epi32(_mm_and_pd(_mm_cmpgt_pd(v, _mm_setzero_pd()), _mm_set1_pd(1.0)));
+		cellInt = _mm_sub_epi32(_mm_add_epi32(truncated, positive), _mm_set1_epi32(1));
+		cellDouble = _mm_cvtepi32_pd(cellInt);
+	}
+
+	static bool laneInRange(Lane v) {
+		Lane magnitude = _mm_andnot_pd(_mm_set1_pd(-0.0), v);
+		return _mm_movemask_pd(_mm_cmplt_pd(magnitude, _mm_set1_pd(1073741824.0))) == 0x3;
+	}
+
+	// sse2 has no 32 bit multiply and only 2 lanes are in use, so do the hash maths one lane at a time
+	static __m128i mulInt(__m128i a, int b) {
+		alignas(16) unsigned int v[4];
+		_mm_store_si128((__m128i*)v, a);
+		return _mm_set_epi32(0, 0, (int)(v[1] * (unsigned int)b), (int)(v[0] * (unsigned int)b));
+	}
+	static __m128i addInt(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+
+	static void gradients(__m128i hash, Lane& gx, Lane& gy, Lane& gz) {
+		alignas(16) int h[4];
+		_mm_store_si128((__m128i*)h, hash);
+		const double* g0 = &NoiseTables::noise::g_randomVectors[hashIndex(h[0])];
+		const double* g1 = &NoiseTables::noise::g_randomVectors[hashIndex(h[1])];
+		gx = _mm_set_pd(g1[0], g0[0]);
+		gy = _mm_set_pd(g1[1], g0[1]);
+		gz = _mm_set_pd(g1[2], g0[2]);
+	}
+	#endif
+
+	#if defined(NOISE_AVX2) || defined(NOISE_SSE2)
+	Lane sCurve(Lane a) const {
+		switch (quality) {
+			case Quality::Fast:
+				return a;
+			case Quality::Standard:
+				return mul(mul(a, a), sub(set1(3.0), mul(set1(2.0), a)));
+			default: {
+				Lane a3 = mul(mul(a, a), a);
+				Lane a4 = mul(a3, a);
+				Lane a5 = mul(a4, a);
+				return add(sub(mul(set1(6.0), a5), mul(set1(15.0), a4)), mul(set1(10.0), a3));
+			}
+		}
+	}
+
+	static Lane linearInterp(Lane n0, Lane n1, Lane a) {
+		return add(mul(sub(set1(1.0), a), n0), mul(a, n1));
+	}
+
+	static Lane gradientNoise(Lane fx, Lane fy, Lane fz, Lane ix, Lane iy, Lane iz, __m128i hash) {
+		Lane gx, gy, gz;
+		gradients(hash, gx, gy, gz);
+		return mul(add(add(mul(gx, sub(fx, ix)), mul(gy, sub(fy, iy))), mul(gz, sub(fz, iz))), set1(2.12));
+	}
+
+	// the same steps as gradientCoherentNoise, a lane of points at a time
+	Lane gradientCoherentNoise(Lane x, Lane y, Lane z, int octaveSeed) const {
+		__m128i x0, y0, z0;
+		Lane x0d, y0d, z0d;
+		cell(x, x0, x0d);
+		cell(y, y0, y0d);
+		cell(z, z0, z0d);
+		Lane x1d = add(x0d, set1(1.0));
+		Lane y1d = add(y0d, set1(1.0));
+		Lane z1d = add(z0d, set1(1.0));
+
+		Lane xs = sCurve(sub(x, x0d));
+		Lane ys = sCurve(sub(y, y0d));
+		Lane zs = sCurve(sub(z, z0d));
+
+		// the hash is a sum of one term per axis, so work out each axis' terms once and add them up per corner
+		__m128i hx0 = mulInt(x0, X_NOISE_GEN);
+		__m128i hx1 = addInt(hx0, _mm_set1_epi32(X_NOISE_GEN));
+		__m128i hy0 = mulInt(y0, Y_NOISE_GEN);
+		__m128i hy1 = addInt(hy0, _mm_set1_epi32(Y_NOISE_GEN));
+		__m128i hz0 = addInt(mulInt(z0, Z_NOISE_GEN), _mm_set1_epi32((int)((unsigned int)SEED_NOISE_GEN * (unsigned int)octaveSeed)));
+		__m128i hz1 = addInt(hz0, _mm_set1_epi32(Z_NOISE_GEN));
+
+		Lane n0, n1, ix0, ix1, iy0, iy1;
+		n0 = gradientNoise(x, y, z, x0d, y0d, z0d, addInt(addInt(hx0, hy0), hz0));
+		n1 = gradientNoise(x, y, z, x1d, y0d, z0d, addInt(addInt(hx1, hy0), hz0));
+		ix0 = linearInterp(n0, n1, xs);
+		n0 = gradientNoise(x, y, z, x0d, y1d, z0d, addInt(addInt(hx0, hy1), hz0));
+		n1 = gradientNoise(x, y, z, x1d, y1d, z0d, addInt(addInt(hx1, hy1), hz0));
+		ix1 = linearInterp(n0, n1, xs);
+		iy0 = linearInterp(ix0, ix1, ys);
+		n0 = gradientNoise(x, y, z, x0d, y0d, z1d, addInt(addInt(hx0, hy0), hz1));
+		n1 = gradientNoise(x, y, z, x1d, y0d, z1d, addInt(addInt(hx1, hy0), hz1));
+		ix0 = linearInterp(n0, n1, xs);
+		n0 = gradientNoise(x, y, z, x0d, y1d, z1d, addInt(addInt(hx0, hy1), hz1));
+		n1 = gradientNoise(x, y, z, x1d, y1d, z1d, addInt(addInt(hx1, hy1), hz1));
+		ix1 = linearInterp(n0, n1, xs);
+		iy1 = linearInterp(ix0, ix1, ys);
+		return linearInterp(iy0, iy1, zs);
+	}
+
+	void getBatch(const double* x, const double* y, const double* z, double* out) const {
+		if (!batchInRange(x, y, z)) {
+			for (int i = 0; i < BATCH_SIZE; i++) {
+				out[i] = GetValue(x[i], y[i], z[i]);
+			}
+			return;
+		}
+
+		for (int lane = 0; lane < BATCH_SIZE; lane += LANE_WIDTH) {
+			Lane lx = mul(load(x + lane), set1(frequency));
+			Lane ly = mul(load(y + lane), set1(frequency));
+			Lane lz = mul(load(z + lane), set1(frequency));
+			Lane value = set1(0.0);
+			double curPersistence = 1.0;
+
+			for (int octave = 0; octave < octaveCount; octave++) {
+				Lane signal = gradientCoherentNoise(lx, ly, lz, (seed + octave) & 0xffffffff);
+				value = add(value, mul(signal, set1(curPersistence)));
+
+				lx = mul(lx, set1(lacunarity));
+				ly = mul(ly, set1(lacunarity));
+				lz = mul(lz, set1(lacunarity));
+				curPersistence *= persistence;
+			}
+
+			store(out + lane, value);
+		}
+	}
+	#endif
+};
+#endif // NOISE_HPP
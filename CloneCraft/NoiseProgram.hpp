@@ -0,0 +1,562 @@
+#ifndef NOISE_PROGRAM_HPP
+#define NOISE_PROGRAM_HPP
+
+
+#ifndef NOISE_STATIC
+#define NOISE_STATIC
+#endif
+#include "noise/noise.h"
+#include "Noise.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Flattens a tree of libnoise modules into a list of instructions that each run over a whole batch of points
+// at once. Every instruction reads and writes registers, which are arrays of one value per point, so there's
+// one switch per instruction per batch instead of a virtual call per module per point, and the generators get
+// to use the batched gradient noise. A module used in more than one place is only evaluated once.
+//
+// Gives exactly the same values as calling GetValue on the root module. Modules it doesn't know about are
+// still supported; they're called one point at a time.
+class NoiseProgram {
+public:
+	static const int MAX_BATCH = 256; // points per pass through the program. a chunk's worth of columns
+
+	NoiseProgram() {}
+
+	NoiseProgram(const noise::module::Module& root) {
+		Compile(root);
+	}
+
+	// throws noise::ExceptionNoModule if a module in the tree is missing a source module
+	void Compile(const noise::module::Module& root) {
+		instructions.clear();
+		compiled.clear();
+		registerCount = FIRST_FREE_REGISTER;
+		resultRegister = compileModule(root, INPUT_COORDS);
+		registers.assign(registerCount * MAX_BATCH, 0.0);
+	}
+
+	bool IsCompiled() const {
+		return !instructions.empty();
+	}
+
+	int GetInstructionCount() const {
+		return (int)instructions.size();
+	}
+
+	// out can be one of the inputs
+	void GetValues(const double* x, const double* y, const double* z, double* out, int count) {
+		for (int start = 0; start < count; start += MAX_BATCH) {
+			int n = count - start < MAX_BATCH ? count - start : MAX_BATCH;
+			std::copy(x + start, x + start + n, reg(INPUT_COORDS));
+			std::copy(y + start, y + start + n, reg(INPUT_COORDS + 1));
+			std::copy(z + start, z + start + n, reg(INPUT_COORDS + 2));
+			run(n);
+			std::copy(reg(resultRegister), reg(resultRegister) + n, out + start);
+		}
+	}
+
+	// fills a width by height grid on the y = 0 plane the same way NoiseMapBuilderPlane does, stepping with
+	// running sums so the sample points are bit for bit the same. dest is row major with x along a row.
+	void FillPlane(double lowX, double lowZ, double xDelta, double zDelta, int width, int height, float* dest) {
+		std::vector<double> xs(width);
+		std::vector<double> zs(height);
+		double xCur = lowX;
+		double zCur = lowZ;
+
+		for (int col = 0; col < width; col++) {
+			xs[col] = xCur;
+			xCur += xDelta;
+		}
+		for (int row = 0; row < height; row++) {
+			zs[row] = zCur;
+			zCur += zDelta;
+		}
+
+		FillGrid(xs.data(), width, zs.data(), height, dest);
+	}
+
+	// fills a width by height grid on the y = 0 plane where column i is at x = xs[i] and row j is at z = zs[j].
+	// dest is row major with x along a row.
+	void FillGrid(const double* xs, int width, const double* zs, int height, float* dest) {
+		gridX.resize(width * height);
+		gridY.assign(width * height, 0.0);
+		gridZ.resize(width * height);
+
+		for (int row = 0; row < height; row++) {
+			std::copy(xs, xs + width, &gridX[row * width]);
+			std::fill(&gridZ[row * width], &gridZ[row * width] + width, zs[row]);
+		}
+
+		GetValues(gridX.data(), gridY.data(), gridZ.data(), gridX.data(), width * height);
+
+		for (int i = 0; i < width * height; i++) {
+			dest[i] = (float)gridX[i];
+		}
+	}
+
+private:
+	enum class Op {
+		// generators
+		Perlin,
+		Billow,
+		RidgedMulti,
+		Const,
+
+		// combine value registers
+		Abs,
+		Invert,
+		ScaleBias,
+		Clamp,
+		Exponent,
+		Add,
+		Multiply,
+		Max,
+		Min,
+		Power,
+		Blend,
+		Select,
+
+		// make a new set of coordinate registers
+		TranslatePoint,
+		ScalePoint,
+		Displace,
+
+		// anything else. calls the module once per point
+		Module,
+	};
+
+	struct Instruction {
+		Op op;
+		int dest = -1; // value register, or the first of 3 coordinate registers
+		int sources[3] = { -1, -1, -1 }; // value registers
+		int coords = 0; // first of the 3 coordinate registers this reads
+		double params[3] = {};
+		PerlinNoise noise; // settings for the generators
+		std::vector<double> spectralWeights; // RidgedMulti only
+		const noise::module::Module* module = nullptr; // Op::Module only
+	};
+
+	// registers 0 - 2 are the input x, y and z. the next few are scratch space for the generators.
+	static const int INPUT_COORDS = 0;
+	static const int SCRATCH_X = 3;
+	static const int SCRATCH_Y = 4;
+	static const int SCRATCH_Z = 5;
+	static const int SCRATCH_SIGNAL = 6;
+	static const int SCRATCH_WEIGHT = 7;
+	static const int FIRST_FREE_REGISTER = 8;
+
+	std::vector<Instruction> instructions;
+	std::map<std::pair<const noise::module::Module*, int>, int> compiled; // (module, coords) -> value register
+	std::vector<double> registers;
+	int registerCount = FIRST_FREE_REGISTER;
+	int resultRegister = -1;
+	std::vector<double> gridX, gridY, gridZ; // FillGrid's sample points, kept between calls
+
+	double* reg(int index) {
+		return &registers[index * MAX_BATCH];
+	}
+
+	int allocate(int count) {
+		int first = registerCount;
+		registerCount += count;
+		return first;
+	}
+
+	static PerlinNoise::Quality toQuality(noise::NoiseQuality quality) {
+		switch (quality) {
+			case noise::QUALITY_FAST:
+				return PerlinNoise::Quality::Fast;
+			case noise::QUALITY_STD:
+				return PerlinNoise::Quality::Standard;
+			default:
+				return PerlinNoise::Quality::Best;
+		}
+	}
+
+	int emitValue(Instruction instruction) {
+		instruction.dest = allocate(1);
+		instructions.push_back(instruction);
+		return instruction.dest;
+	}
+
+	int emitCoords(Op op, int coords, double x, double y, double z) {
+		Instruction instruction;
+		instruction.op = op;
+		instruction.coords = coords;
+		instruction.params[0] = x;
+		instruction.params[1] = y;
+		instruction.params[2] = z;
+		instruction.dest = allocate(3);
+		instructions.push_back(instruction);
+		return instruction.dest;
+	}
+
+	int emitDisplace(int coords, int xSource, int ySource, int zSource, double power) {
+		Instruction instruction;
+		instruction.op = Op::Displace;
+		instruction.coords = coords;
+		instruction.sources[0] = xSource;
+		instruction.sources[1] = ySource;
+		instruction.sources[2] = zSource;
+		instruction.params[0] = power;
+		instruction.dest = allocate(3);
+		instructions.push_back(instruction);
+		return instruction.dest;
+	}
+
+	int emitPerlin(int coords, double frequency, double lacunarity, double persistence, int octaveCount, int seed, noise::NoiseQuality quality) {
+		Instruction instruction;
+		instruction.op = Op::Perlin;
+		instruction.coords = coords;
+		instruction.noise.frequency = frequency;
+		instruction.noise.lacunarity = lacunarity;
+		instruction.noise.persistence = persistence;
+		instruction.noise.octaveCount = octaveCount;
+		instruction.noise.seed = seed;
+		instruction.noise.quality = toQuality(quality);
+		return emitValue(instruction);
+	}
+
+	// returns the register the module's value ends up in
+	int compileModule(const noise::module::Module& module, int coords) {
+		using namespace noise::module;
+
+		auto key = std::make_pair(&module, coords);
+		auto found = compiled.find(key);
+		if (found != compiled.end()) {
+			return found->second;
+		}
+
+		Instruction instruction;
+		instruction.coords = coords;
+		int result = -1;
+
+		auto source = [&](int index) {
+			return compileModule(module.GetSourceModule(index), coords);
+		};
+
+		auto combine = [&](Op op, int sourceCount) {
+			instruction.op = op;
+			for (int i = 0; i < sourceCount; i++) {
+				instruction.sources[i] = source(i);
+			}
+			return emitValue(instruction);
+		};
+
+		if (auto perlin = dynamic_cast<const Perlin*>(&module)) {
+			result = emitPerlin(coords, perlin->GetFrequency(), perlin->GetLacunarity(), perlin->GetPersistence(), perlin->GetOctaveCount(), perlin->GetSeed(), perlin->GetNoiseQuality());
+		}
+		else if (auto billow = dynamic_cast<const Billow*>(&module)) {
+			instruction.op = Op::Billow;
+			instruction.noise.frequency = billow->GetFrequency();
+			instruction.noise.lacunarity = billow->GetLacunarity();
+			instruction.noise.persistence = billow->GetPersistence();
+			instruction.noise.octaveCount = billow->GetOctaveCount();
+			instruction.noise.seed = billow->GetSeed();
+			instruction.noise.quality = toQuality(billow->GetNoiseQuality());
+			result = emitValue(instruction);
+		}
+		else if (auto ridged = dynamic_cast<const RidgedMulti*>(&module)) {
+			instruction.op = Op::RidgedMulti;
+			instruction.noise.frequency = ridged->GetFrequency();
+			instruction.noise.lacunarity = ridged->GetLacunarity();
+			instruction.noise.octaveCount = ridged->GetOctaveCount();
+			instruction.noise.seed = ridged->GetSeed();
+			instruction.noise.quality = toQuality(ridged->GetNoiseQuality());
+
+			// same as RidgedMulti::CalcSpectralWeights
+			double frequency = 1.0;
+			for (int i = 0; i < instruction.noise.octaveCount; i++) {
+				instruction.spectralWeights.push_back(pow(frequency, -1.0));
+				frequency *= instruction.noise.lacunarity;
+			}
+			result = emitValue(instruction);
+		}
+		else if (auto constant = dynamic_cast<const Const*>(&module)) {
+			instruction.op = Op::Const;
+			instruction.params[0] = constant->GetConstValue();
+			result = emitValue(instruction);
+		}
+		else if (dynamic_cast<const Abs*>(&module)) {
+			result = combine(Op::Abs, 1);
+		}
+		else if (dynamic_cast<const Invert*>(&module)) {
+			result = combine(Op::Invert, 1);
+		}
+		else if (auto scaleBias = dynamic_cast<const ScaleBias*>(&module)) {
+			instruction.params[0] = scaleBias->GetScale();
+			instruction.params[1] = scaleBias->GetBias();
+			result = combine(Op::ScaleBias, 1);
+		}
+		else if (auto clamp = dynamic_cast<const Clamp*>(&module)) {
+			instruction.params[0] = clamp->GetLowerBound();
+			instruction.params[1] = clamp->GetUpperBound();
+			result = combine(Op::Clamp, 1);
+		}
+		else if (auto exponent = dynamic_cast<const Exponent*>(&module)) {
+			instruction.params[0] = exponent->GetExponent();
+			result = combine(Op::Exponent, 1);
+		}
+		else if (dynamic_cast<const Add*>(&module)) {
+			result = combine(Op::Add, 2);
+		}
+		else if (dynamic_cast<const Multiply*>(&module)) {
+			result = combine(Op::Multiply, 2);
+		}
+		else if (dynamic_cast<const Max*>(&module)) {
+			result = combine(Op::Max, 2);
+		}
+		else if (dynamic_cast<const Min*>(&module)) {
+			result = combine(Op::Min, 2);
+		}
+		else if (dynamic_cast<const Power*>(&module)) {
+			result = combine(Op::Power, 2);
+		}
+		else if (dynamic_cast<const Blend*>(&module)) {
+			result = combine(Op::Blend, 3);
+		}
+		else if (auto select = dynamic_cast<const Select*>(&module)) {
+			instruction.params[0] = select->GetLowerBound();
+			instruction.params[1] = select->GetUpperBound();
+			instruction.params[2] = select->GetEdgeFalloff();
+			result = combine(Op::Select, 3);
+		}
+		else if (dynamic_cast<const Cache*>(&module)) {
+			// the cache only remembers the last point, which the program does better anyway
+			result = source(0);
+		}
+		else if (auto translate = dynamic_cast<const TranslatePoint*>(&module)) {
+			int moved = emitCoords(Op::TranslatePoint, coords, translate->GetXTranslation(), translate->GetYTranslation(), translate->GetZTranslation());
+			result = compileModule(module.GetSourceModule(0), moved);
+		}
+		else if (auto scale = dynamic_cast<const ScalePoint*>(&module)) {
+			int moved = emitCoords(Op::ScalePoint, coords, scale->GetXScale(), scale->GetYScale(), scale->GetZScale());
+			result = compileModule(module.GetSourceModule(0), moved);
+		}
+		else if (dynamic_cast<const Displace*>(&module)) {
+			int moved = emitDisplace(coords, source(1), source(2), source(3), 1.0);
+			result = compileModule(module.GetSourceModule(0), moved);
+		}
+		else if (auto turbulence = dynamic_cast<const Turbulence*>(&module)) {
+			// turbulence is a displace by 3 perlin modules, each looking at its own offset copy of the point
+			static const double OFFSETS[3][3] = {
+				{ 12414.0 / 65536.0, 65124.0 / 65536.0, 31337.0 / 65536.0 },
+				{ 26519.0 / 65536.0, 18128.0 / 65536.0, 60493.0 / 65536.0 },
+				{ 53820.0 / 65536.0, 11213.0 / 65536.0, 44845.0 / 65536.0 },
+			};
+
+			int distort[3];
+			for (int axis = 0; axis < 3; axis++) {
+				int offsetCoords = emitCoords(Op::TranslatePoint, coords, OFFSETS[axis][0], OFFSETS[axis][1], OFFSETS[axis][2]);
+				distort[axis] = emitPerlin(offsetCoords, turbulence->GetFrequency(), noise::module::DEFAULT_PERLIN_LACUNARITY, noise::module::DEFAULT_PERLIN_PERSISTENCE,
+					turbulence->GetRoughnessCount(), turbulence->GetSeed() + axis, noise::module::DEFAULT_PERLIN_QUALITY);
+			}
+
+			int moved = emitDisplace(coords, distort[0], distort[1], distort[2], turbulence->GetPower());
+			result = compileModule(module.GetSourceModule(0), moved);
+		}
+		else {
+			instruction.op = Op::Module;
+			instruction.module = &module;
+			result = emitValue(instruction);
+		}
+
+		compiled[key] = result;
+		return result;
+	}
+
+	void run(int n) {
+		for (auto& instruction : instructions) {
+			double* dest = reg(instruction.dest);
+			const double* x = reg(instruction.coords);
+			const double* y = reg(instruction.coords + 1);
+			const double* z = reg(instruction.coords + 2);
+			const double* a = instruction.sources[0] >= 0 ? reg(instruction.sources[0]) : nullptr;
+			const double* b = instruction.sources[1] >= 0 ? reg(instruction.sources[1]) : nullptr;
+			const double* c = instruction.sources[2] >= 0 ? reg(instruction.sources[2]) : nullptr;
+			const double* params = instruction.params;
+
+			switch (instruction.op) {
+				case Op::Perlin:
+				case Op::Billow:
+				case Op::RidgedMulti:
+					runGenerator(instruction, n);
+					break;
+				case Op::Const:
+					std::fill(dest, dest + n, params[0]);
+					break;
+				case Op::Abs:
+					for (int i = 0; i < n; i++) dest[i] = fabs(a[i]);
+					break;
+				case Op::Invert:
+					for (int i = 0; i < n; i++) dest[i] = -a[i];
+					break;
+				case Op::ScaleBias:
+					for (int i = 0; i < n; i++) dest[i] = a[i] * params[0] + params[1];
+					break;
+				case Op::Clamp:
+					for (int i = 0; i < n; i++) dest[i] = a[i] < params[0] ? params[0] : (a[i] > params[1] ? params[1] : a[i]);
+					break;
+				case Op::Exponent:
+					for (int i = 0; i < n; i++) dest[i] = (pow(fabs((a[i] + 1.0) / 2.0), params[0]) * 2.0 - 1.0);
+					break;
+				case Op::Add:
+					for (int i = 0; i < n; i++) dest[i] = a[i] + b[i];
+					break;
+				case Op::Multiply:
+					for (int i = 0; i < n; i++) dest[i] = a[i] * b[i];
+					break;
+				case Op::Max:
+					for (int i = 0; i < n; i++) dest[i] = a[i] > b[i] ? a[i] : b[i];
+					break;
+				case Op::Min:
+					for (int i = 0; i < n; i++) dest[i] = a[i] < b[i] ? a[i] : b[i];
+					break;
+				case Op::Power:
+					for (int i = 0; i < n; i++) dest[i] = pow(a[i], b[i]);
+					break;
+				case Op::Blend:
+					for (int i = 0; i < n; i++) dest[i] = linearInterp(a[i], b[i], (c[i] + 1.0) / 2.0);
+					break;
+				case Op::Select:
+					for (int i = 0; i < n; i++) dest[i] = select(a[i], b[i], c[i], params[0], params[1], params[2]);
+					break;
+				case Op::TranslatePoint:
+					for (int i = 0; i < n; i++) {
+						dest[i] = x[i] + params[0];
+						dest[MAX_BATCH + i] = y[i] + params[1];
+						dest[2 * MAX_BATCH + i] = z[i] + params[2];
+					}
+					break;
+				case Op::ScalePoint:
+					for (int i = 0; i < n; i++) {
+						dest[i] = x[i] * params[0];
+						dest[MAX_BATCH + i] = y[i] * params[1];
+						dest[2 * MAX_BATCH + i] = z[i] * params[2];
+					}
+					break;
+				case Op::Displace:
+					for (int i = 0; i < n; i++) {
+						dest[i] = x[i] + (a[i] * params[0]);
+						dest[MAX_BATCH + i] = y[i] + (b[i] * params[0]);
+						dest[2 * MAX_BATCH + i] = z[i] + (c[i] * params[0]);
+					}
+					break;
+				case Op::Module:
+					for (int i = 0; i < n; i++) dest[i] = instruction.module->GetValue(x[i], y[i], z[i]);
+					break;
+			}
+		}
+	}
+
+	// the octave loops from Perlin, Billow and RidgedMulti, a whole batch at a time
+	void runGenerator(const Instruction& instruction, int n) {
+		const PerlinNoise& settings = instruction.noise;
+		double* dest = reg(instruction.dest);
+		double* sx = reg(SCRATCH_X);
+		double* sy = reg(SCRATCH_Y);
+		double* sz = reg(SCRATCH_Z);
+		double* signal = reg(SCRATCH_SIGNAL);
+		double* weight = reg(SCRATCH_WEIGHT);
+		const double* x = reg(instruction.coords);
+		const double* y = reg(instruction.coords + 1);
+		const double* z = reg(instruction.coords + 2);
+		double curPersistence = 1.0;
+
+		for (int i = 0; i < n; i++) {
+			sx[i] = x[i] * settings.frequency;
+			sy[i] = y[i] * settings.frequency;
+			sz[i] = z[i] * settings.frequency;
+			dest[i] = 0.0;
+			weight[i] = 1.0;
+		}
+
+		for (int octave = 0; octave < settings.octaveCount; octave++) {
+			if (instruction.op == Op::RidgedMulti) {
+				settings.GetOctaveValues(sx, sy, sz, signal, n, (settings.seed + octave) & 0x7fffffff);
+
+				// offset 1 and gain 2, like libnoise
+				double spectralWeight = instruction.spectralWeights[octave];
+				for (int i = 0; i < n; i++) {
+					double s = 1.0 - fabs(signal[i]);
+					s *= s;
+					s *= weight[i];
+					double w = s * 2.0;
+					weight[i] = w > 1.0 ? 1.0 : (w < 0.0 ? 0.0 : w);
+					dest[i] += (s * spectralWeight);
+				}
+			}
+			else {
+				settings.GetOctaveValues(sx, sy, sz, signal, n, (settings.seed + octave) & 0xffffffff);
+
+				if (instruction.op == Op::Billow) {
+					for (int i = 0; i < n; i++) {
+						dest[i] += (2.0 * fabs(signal[i]) - 1.0) * curPersistence;
+					}
+				}
+				else {
+					for (int i = 0; i < n; i++) {
+						dest[i] += signal[i] * curPersistence;
+					}
+				}
+			}
+
+			for (int i = 0; i < n; i++) {
+				sx[i] *= settings.lacunarity;
+				sy[i] *= settings.lacunarity;
+				sz[i] *= settings.lacunarity;
+			}
+			curPersistence *= settings.persistence;
+		}
+
+		if (instruction.op == Op::Billow) {
+			for (int i = 0; i < n; i++) dest[i] += 0.5;
+		}
+		else if (instruction.op == Op::RidgedMulti) {
+			for (int i = 0; i < n; i++) dest[i] = (dest[i] * 1.25) - 1.0;
+		}
+	}
+
+	static double linearInterp(double n0, double n1, double a) {
+		return ((1.0 - a) * n0) + (a * n1);
+	}
+
+	// Select::GetValue without the lazy evaluation, since both sources are already worked out
+	static double select(double source0, double source1, double control, double lowerBound, double upperBound, double edgeFalloff) {
+		if (edgeFalloff > 0.0) {
+			if (control < (lowerBound - edgeFalloff)) {
+				return source0;
+			}
+			else if (control < (lowerBound + edgeFalloff)) {
+				double lowerCurve = (lowerBound - edgeFalloff);
+				double upperCurve = (lowerBound + edgeFalloff);
+				double alpha = sCurve3((control - lowerCurve) / (upperCurve - lowerCurve));
+				return linearInterp(source0, source1, alpha);
+			}
+			else if (control < (upperBound - edgeFalloff)) {
+				return source1;
+			}
+			else if (control < (upperBound + edgeFalloff)) {
+				double lowerCurve = (upperBound - edgeFalloff);
+				double upperCurve = (upperBound + edgeFalloff);
+				double alpha = sCurve3((control - lowerCurve) / (upperCurve - lowerCurve));
+				return linearInterp(source1, source0, alpha);
+			}
+			return source0;
+		}
+
+		if (control < lowerBound || control > upperBound) {
+			return source0;
+		}
+		return source1;
+	}
+
+	static double sCurve3(double a) {
+		return (a * a * (3.0 - 2.0 * a));
+	}
+};
+#endif // NOISE_PROGRAM_HPP
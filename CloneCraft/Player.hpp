@@ -2,6 +2,7 @@
 #define PLAYER_HPP
 
 
+#include "Collision.hpp"
 #include "Entity.hpp"
 #include "Ray.hpp"
 #include <vector>
@@ -17,13 +18,18 @@ public:
 	bool canPlaceBlock = true;
 	bool canBreakBlock = true;
 	bool lastFlyingState = false;
+	BlockId heldBlock = BlockId::Grass; // what the right button puts down. 1 picks grass and 2 glowstone
 
 	Player() {
 		position = { 1000, 130, 1000, 0 }; // set spawn
+		previousPosition = position;
 		bbox.dimensions = { width, height, width, 0.0f };
 	}
 
+	// one tick of movement, building and physics. dt is always the tick length
 	void update(float dt, Entity& camera) {
+		previousPosition = position;
+
 		Window& window = AppGlobals::window;
 		auto& controller = AppGlobals::controller;
 		auto jumpHeight = AppGlobals::jumpHeight;
@@ -43,10 +49,8 @@ public:
 			speed = AppGlobals::playerSpeed;
 		}
 
-		position.x += moveDirection.x * speed * dt;
-		collide(Vec4(moveDirection.x, 0.f, 0.f, 0.f));
-		position.z += moveDirection.z * speed * dt;
-		collide(Vec4(0.f, 0.f, moveDirection.z, 0.f));
+		// moved together with the fall at the end, so walking and falling are stopped by the same sweep
+		Vec4 walk(moveDirection.x * speed * dt, 0.f, moveDirection.z * speed * dt, 0.f);
 
 
 		// toggle flying
@@ -59,24 +63,35 @@ public:
 		}
 
 
+		// blocks are picked from where the player is this tick, not from the camera, which is drawn partway between
+		// the last two ticks and so depends on the frame rate. the pitch is only kept on the camera, but it's set
+		// once a frame before the ticks so it's already current
+		Vec4 eye = GetEyePosition();
+		Vec4 lookDirection = Ray(eye, Vec4(camera.rotation.x, rotation.y, 0.f, 0.f)).GetDirection();
+
+
+		// pick what to build with
+		if (controller.keys[G_KEY_1]) {
+			heldBlock = BlockId::Grass;
+		}
+		else if (controller.keys[G_KEY_2]) {
+			heldBlock = BlockId::Glowstone;
+		}
+
+
 		// place block
 		if (controller.keys[G_BUTTON_LEFT] && canPlaceBlock) {
 			auto& world = AppGlobals::world;
+			RaycastHit hit;
 
-			for (Ray ray(camera.position, camera.rotation); ray.GetLength() <= buildRange; ray.Step(0.001f)) {
-				auto rayEnd = ray.GetEnd();
-				auto block = world.getBlock(rayEnd);
-
-				if (block != BlockId::Air) {
-					if (world.setBlock(BlockId::Air, rayEnd)) {
-						Vec4 xz = World::getChunkXZ(rayEnd);
-						world.updateChunk(world.getChunk(xz)->position);
-						break;
-					}
-					else {
-						__debugbreak();
-						throw new std::runtime_error("unable to destroy block!");
-					}
+			if (world.raycast(eye, lookDirection, buildRange, hit)) {
+				if (world.setBlock(BlockId::Air, hit.block)) {
+					Vec4 xz = World::getChunkXZ(hit.block);
+					world.updateChunk(world.getChunk(xz)->position);
+				}
+				else {
+					__debugbreak();
+					throw new std::runtime_error("unable to destroy block!");
 				}
 			}
 
@@ -89,27 +104,18 @@ public:
 
 		// break block
 		if (controller.keys[G_BUTTON_RIGHT] && canBreakBlock) {
-			Vec4 lastRayPosition{ 0, 0, 0, 0 };
 			auto& world = AppGlobals::world;
-
-			for (Ray ray(camera.position, camera.rotation); ray.GetLength() <= buildRange; ray.Step(0.001f)) {
-				auto rayEnd = ray.GetEnd();
-				auto block = world.getBlock(rayEnd);
-				auto blockPosition = lastRayPosition.AsInt();
-
-				if (block != BlockId::Air) {
-					if (!wouldCollide(blockPosition)) {
-						if (world.setBlock(BlockId::Grass, lastRayPosition)) {
-							Vec4 xz = World::getChunkXZ(lastRayPosition);
-							world.updateChunk(world.getChunk(xz)->position);
-							break;
-						}
-					}
-					else {
-						break;
+			RaycastHit hit;
+
+			// the new block goes against the face that was looked at. a ray that starts inside a block has no face
+			if (world.raycast(eye, lookDirection, buildRange, hit) && hit.normal != Vec4(0.f, 0.f, 0.f, 0.f)) {
+				Vec4 blockPosition = hit.block + hit.normal;
+				if (!wouldCollide(blockPosition) && blockPosition.y >= 0 && blockPosition.y < AppGlobals::CHUNK_HEIGHT) {
+					if (world.setBlock(heldBlock, blockPosition)) {
+						Vec4 xz = World::getChunkXZ(blockPosition);
+						world.updateChunk(world.getChunk(xz)->position);
 					}
 				}
-				lastRayPosition = ray.GetEnd();
 			}
 			canBreakBlock = false;
 		}
@@ -118,24 +124,6 @@ public:
 		}
 
 
-		// --- mouse look --- //
-		float dx = controller.mouseDelta.x;
-		float dy = controller.mouseDelta.y;
-
-		rotation.y += dx * AppGlobals::mouseSensitivity;
-		camera.rotation.x += dy * AppGlobals::mouseSensitivity;
-
-		if (camera.rotation.x > AppGlobals::mouseBound)
-			camera.rotation.x = AppGlobals::mouseBound;
-		else if (camera.rotation.x < -AppGlobals::mouseBound)
-			camera.rotation.x = -AppGlobals::mouseBound;
-
-		if (rotation.y > 360)
-			rotation.y = 0;
-		else if (rotation.y < 0)
-			rotation.y = 360;
-
-
 		// --- jumping --- //
 		if (controller.keys[G_KEY_SPACE] && canJump && !isFlying && onGround) {
 			// fall up lol
@@ -159,64 +147,66 @@ public:
 		// --- world wrap --- //
 		if (position.y < 0 && !isFlying) {
 			position.y = 260;
+			previousPosition = position; // don't draw the fall back up to the top
 		}
 
-		// collide() will set onGround
+		// move() will set onGround
 		onGround = false;
+		move(Vec4(walk.x, fallingSpeed * dt, walk.z, 0.f));
 
+		bbox.position = position;
+	}
 
-		
-		position.y += fallingSpeed * dt;
-		collide(Vec4(0.f, fallingSpeed, 0.f, 0.f));
 
-		bbox.position = position;
+	// turns the player and camera with the mouse. once a frame rather than once a tick so looking around is as
+	// smooth as the frame rate
+	void look(Entity& camera) {
+		auto& controller = AppGlobals::controller;
+		float dx = controller.mouseDelta.x;
+		float dy = controller.mouseDelta.y;
+
+		rotation.y += dx * AppGlobals::mouseSensitivity;
+		camera.rotation.x += dy * AppGlobals::mouseSensitivity;
+
+		if (camera.rotation.x > AppGlobals::mouseBound)
+			camera.rotation.x = AppGlobals::mouseBound;
+		else if (camera.rotation.x < -AppGlobals::mouseBound)
+			camera.rotation.x = -AppGlobals::mouseBound;
+
+		if (rotation.y > 360)
+			rotation.y = 0;
+		else if (rotation.y < 0)
+			rotation.y = 360;
 	}
 
 
-	void collide(const Vec4& vel) {
-		float xMin = position.x - bbox.dimensions.x;
-		float xMax = position.x + bbox.dimensions.x;
-		float yMin = position.y;
-		float yMax = position.y + bbox.dimensions.y; // "height" blocks above us
-		float zMin = position.z - bbox.dimensions.z;
-		float zMax = position.z + bbox.dimensions.z;
+	// moves by displacement, stopping at and sliding along any block in the way however far it is
+	void move(const Vec4& displacement) {
+		Vec4 low(position.x - bbox.dimensions.x, position.y, position.z - bbox.dimensions.z, 0.f);
+		Vec4 high(position.x + bbox.dimensions.x, position.y + bbox.dimensions.y, position.z + bbox.dimensions.z, 0.f);
 		auto& world = AppGlobals::world;
 
-		for (int x = xMin; x < xMax; x++) {
-			for (int y = yMin; y < yMax; y++) {
-				for (int z = zMin; z < zMax; z++) {
-					auto block = world.getBlock(Vec4(x, y, z, 0));
-
-					if (world.blockdb.blockDataFor(block).isCollidable()) {
-						if (vel.y > 0) {
-							position.y = y - bbox.dimensions.y;
-							fallingSpeed = 0;
-						}
-						else if (vel.y < 0) {
-							onGround = true;
-							position.y = y + 1;
-							fallingSpeed = 0;
-						}
-
-						if (vel.x > 0) {
-							position.x = x - bbox.dimensions.x;
-						}
-						else if (vel.x < 0) {
-							position.x = x + bbox.dimensions.x + 1;
-						}
-
-						if (vel.z > 0) {
-							position.z = z - bbox.dimensions.z;
-						}
-						else if (vel.z < 0) {
-							position.z = z + bbox.dimensions.z + 1;
-						}
-					}
-				}
-			}
+		// most of the time there's nothing but air anywhere along the way so skip checking every block
+		Vec4 sweptLow(floorf(fminf(low.x, low.x + displacement.x)), floorf(fminf(low.y, low.y + displacement.y)), floorf(fminf(low.z, low.z + displacement.z)), 0.f);
+		Vec4 sweptHigh(ceilf(fmaxf(high.x, high.x + displacement.x)), ceilf(fmaxf(high.y, high.y + displacement.y)), ceilf(fmaxf(high.z, high.z + displacement.z)), 0.f);
+		if (!world.mayHaveBlocksIn(AABB(sweptLow, sweptHigh - sweptLow))) {
+			position = position + displacement;
+			return;
+		}
+
+		WorldVoxels voxels(world);
+		SweepResult result = sweepBox(low, high, displacement, voxels);
+		position.x = (result.low.x + result.high.x) * 0.5f;
+		position.y = result.low.y;
+		position.z = (result.low.z + result.high.z) * 0.5f;
+
+		if (result.hitY) {
+			onGround = result.hitY < 0;
+			fallingSpeed = 0;
 		}
 	}
 
+
 	bool wouldCollide(Vec4 blockPosition) {
 		float xMin = position.x - bbox.dimensions.x;
 		float xMax = position.x + bbox.dimensions.x;
@@ -225,9 +215,10 @@ public:
 		float zMin = position.z - bbox.dimensions.z;
 		float zMax = position.z + bbox.dimensions.z;
 
-		for (int x = xMin; x < xMax; x++) {
-			for (int y = yMin; y < yMax; y++) {
-				for (int z = zMin; z < zMax; z++) {
+		// floor rather than truncate so blocks at negative coordinates line up too
+		for (int x = (int)floorf(xMin); x < xMax; x++) {
+			for (int y = (int)floorf(yMin); y < yMax; y++) {
+				for (int z = (int)floorf(zMin); z < zMax; z++) {
 					if (blockPosition == Vec4(x, y, z, 0 )) {
 						return true;
 					}
@@ -0,0 +1,201 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RANDOM_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RANDOM_SSE2
+#endif
+
+// picks a seed from the clock if AppGlobals::seed is -1. called once at startup before anything is generated,
+// so the generators only ever read the seed and can run on any thread.
+static void resolveSeed() {
+	if (AppGlobals::seed == -1) {
+		AppGlobals::seed = (int)time(NULL);
+	}
+}
+
+// what a stream of random numbers is used for. each feature of a chunk gets its own stream, so adding a
+// feature or changing how many numbers one uses never shifts any of the others.
+enum class RandomFeature : uint32_t {
+	CoalOre = 0,
+	IronOre = 1,
+	Trees = 2,
+	Boulders = 3,
+	Caves = 4, // keyed by cave region instead of chunk
+};
+
+// Counter-based random numbers. Number n of a stream is a hash of n and the stream's key, and the key is a hash
+// of (seed, chunkX, chunkZ, feature). Nothing is shared between streams and nothing depends on what was drawn
+// before, so a chunk gets the same numbers on any thread in any order, and any number can be worked out on its
+// own. Fill works out 8 at a time with AVX2 or 4 with SSE2, for scatter passes that want a lot at once.
+class RandomStream {
+public:
+	RandomStream(int seed, int chunkX, int chunkZ, RandomFeature feature) {
+		uint64_t key = mix64((uint64_t)(uint32_t)seed + 0x9E3779B97F4A7C15ull);
+		key = mix64(key ^ (((uint64_t)(uint32_t)chunkX << 32) | (uint32_t)chunkZ));
+		key = mix64(key ^ static_cast<uint32_t>(feature));
+		key0 = (uint32_t)key;
+		key1 = (uint32_t)(key >> 32);
+	}
+
+	// number index of the stream
+	uint32_t Get(uint32_t index) const {
+		return hash(index, key0, key1);
+	}
+
+	// the next number after the last one Next gave out
+	uint32_t Next() {
+		return Get(counter++);
+	}
+
+	// 0 to n - 1
+	int Range(int n) {
+		return toRange(Next(), n);
+	}
+
+	// 0 to just under 1
+	float Unit() {
+		return toUnit(Next());
+	}
+
+	// numbers first to first + count - 1, the same as calling Get on each
+	void Fill(uint32_t first, uint32_t* out, int count) const {
+		int i = 0;
+		#if defined(RANDOM_AVX2)
+		__m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		for (; i + 8 <= count; i += 8) {
+			__m256i x = _mm256_add_epi32(_mm256_set1_epi32((int)(first + i)), lane);
+			_mm256_storeu_si256((__m256i*)(out + i), hash8(x));
+		}
+		#elif defined(RANDOM_SSE2)
+		__m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+		for (; i + 4 <= count; i += 4) {
+			__m128i x = _mm_add_epi32(_mm_set1_epi32((int)(first + i)), lane);
+			_mm_storeu_si128((__m128i*)(out + i), hash4(x));
+		}
+		#endif
+		for (; i < count; i++) {
+			out[i] = Get(first + i);
+		}
+	}
+
+	// same as Fill but each number turned into 0 to just under 1
+	void FillUnit(uint32_t first, float* out, int count) const {
+		uint32_t bits[256];
+		for (int start = 0; start < count; start += 256) {
+			int n = count - start < 256 ? count - start : 256;
+			Fill(first + start, bits, n);
+			for (int i = 0; i < n; i++) {
+				out[start + i] = toUnit(bits[i]);
+			}
+		}
+	}
+
+	static int toRange(uint32_t bits, int n) {
+		return (int)(((uint64_t)bits * (uint32_t)n) >> 32);
+	}
+
+	static float toUnit(uint32_t bits) {
+		return (float)(bits >> 8) / 16777216.f;
+	}
+
+	// times Fill against calling Get one at a time and checks they agree. returns how many numbers didn't
+	static int Benchmark(int count) {
+		RandomStream stream(AppGlobals::seed, 0, 0, RandomFeature::Trees);
+		std::vector<uint32_t> single(count);
+		std::vector<uint32_t> batch(count);
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < count; i++) {
+			single[i] = stream.Get(i);
+		}
+		auto midTime = std::chrono::high_resolution_clock::now();
+		stream.Fill(0, batch.data(), count);
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		int mismatches = 0;
+		for (int i = 0; i < count; i++) {
+			mismatches += single[i] != batch[i];
+		}
+
+		double singleSeconds = std::chrono::duration<double>(midTime - startTime).count();
+		double batchSeconds = std::chrono::duration<double>(endTime - midTime).count();
+		printf("random stream benchmark: %d numbers\n", count);
+		printf("  one at a time:   %10.1f million/s\n", count / singleSeconds / 1e6);
+		printf("  batched:         %10.1f million/s  (%.2fx)\n", count / batchSeconds / 1e6, singleSeconds / batchSeconds);
+		printf("  mismatched numbers: %d\n", mismatches);
+		return mismatches;
+	}
+
+private:
+	uint32_t key0;
+	uint32_t key1;
+	uint32_t counter = 0;
+
+	// splitmix64's finalizer
+	static uint64_t mix64(uint64_t z) {
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// two rounds of a 32 bit integer hash with the key mixed in before each. 32 bits so it fits the simd lanes
+	static uint32_t mix32(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7FEB352Du;
+		x ^= x >> 15;
+		x *= 0x846CA68Bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	static uint32_t hash(uint32_t index, uint32_t k0, uint32_t k1) {
+		return mix32(mix32(index + k0) ^ k1);
+	}
+
+	#if defined(RANDOM_AVX2)
+	static __m256i mix8(__m256i x) {
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+		x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x7FEB352Du));
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+		x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x846CA68Bu));
+		return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+	}
+
+	__m256i hash8(__m256i index) const {
+		__m256i x = mix8(_mm256_add_epi32(index, _mm256_set1_epi32((int)key0)));
+		return mix8(_mm256_xor_si256(x, _mm256_set1_epi32((int)key1)));
+	}
+	#elif defined(RANDOM_SSE2)
+	// sse2 only multiplies the even lanes, so do the odd ones shifted down and put them back together
+	static __m128i mullo(__m128i a, __m128i b) {
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	static __m128i mix4(__m128i x) {
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+		x = mullo(x, _mm_set1_epi32((int)0x7FEB352Du));
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+		x = mullo(x, _mm_set1_epi32((int)0x846CA68Bu));
+		return _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+	}
+
+	__m128i hash4(__m128i index) const {
+		__m128i x = mix4(_mm_add_epi32(index, _mm_set1_epi32((int)key0)));
+		return mix4(_mm_xor_si128(x, _mm_set1_epi32((int)key1)));
+	}
+	#endif
+};
+#endif // RANDOM_HPP
@@ -2,6 +2,40 @@
 #define RAY_HPP
 
 #include <cmath>
+#include <vector>
+
+// what World::raycast found
+struct RaycastHit {
+    Vec4 block; // the block that was hit
+    Vec4 normal; // the face of the block the ray went in through, pointing back at the ray. all 0 if it started inside
+    float distance = 0; // along the ray to where it went into the block
+    BlockId id = BlockId::Air;
+};
+
+// rays for World::raycastBatch, one array for each part so they load straight into simd lanes
+struct RayBatch {
+    std::vector<float> originX, originY, originZ;
+    std::vector<float> directionX, directionY, directionZ;
+    std::vector<float> maxDistance;
+
+    void Add(const Vec4& origin, const Vec4& direction, float distance) {
+        originX.push_back(origin.x);
+        originY.push_back(origin.y);
+        originZ.push_back(origin.z);
+        directionX.push_back(direction.x);
+        directionY.push_back(direction.y);
+        directionZ.push_back(direction.z);
+        maxDistance.push_back(distance);
+    }
+
+    void Clear() {
+        originX.clear(); originY.clear(); originZ.clear();
+        directionX.clear(); directionY.clear(); directionZ.clear();
+        maxDistance.clear();
+    }
+
+    size_t Size() const { return originX.size(); }
+};
 
 class Ray {
 public:
@@ -28,6 +62,15 @@ public:
         return rayEnd;
     }
 
+    // the way Step goes, one unit long
+    Vec4 GetDirection() {
+        float yaw = RADIAN * (direction.y + 90);
+        float pitch = RADIAN * (direction.x);
+
+        Vec4 d(-cosf(yaw), -tanf(pitch), -sinf(yaw), 0.f);
+        return d * (1.f / sqrtf(d.x * d.x + d.y * d.y + d.z * d.z));
+    }
+
     float GetLength() {
         return sqrtf(powf((rayStart.x - rayEnd.x), 2) + powf((rayStart.y - rayEnd.y), 2) + powf((rayStart.z - rayEnd.z), 2));
     }
@@ -1,6 +1,7 @@
 #ifndef RENDERER_HPP
 #define RENDERER_HPP
 
+#include "SimulationClock.hpp"
 #include "UBO.hpp"
 #include <chrono>
 #include <fstream>
@@ -21,16 +22,23 @@ layout(binding = 0) uniform UniformBufferObject {
 	mat4 model;
 	mat4 view;
 	mat4 proj;
+	vec4 sky;
 } ubo;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in vec4 inLight;
 
 layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec2 fragLight; // x: light level, y: ambient occlusion
 
 void main() {
 	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
 	fragTexCoord = inTexCoord;
+
+	// the mesh keeps sky light and block light apart so the time of day can be applied here. 
+	// night falling only changes the uniform, it never rebuilds a chunk
+	fragLight = vec2(max(inLight.x * ubo.sky.x, inLight.y), inLight.z);
 }
 )";
 
@@ -42,6 +50,7 @@ const char* fragmentShaderCode = R"(
 layout(binding = 1) uniform sampler2D texSampler;
 
 layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) in vec2 fragLight;
 
 layout(location = 0) out vec4 outColor;
 
@@ -49,8 +58,20 @@ vec4 GammaCorrection (vec4 color, float gamma) {
   return pow(color, vec4(gamma));
 }
 
+// each light level is 80% as bright as the one above it. level 0 still gets a little so caves aren't pitch black
+float Brightness (float level) {
+  return max(pow(0.8, (1.0 - level) * 15.0), 0.05);
+}
+
+// 1 is open, 0 is tucked into a corner
+float Occlusion (float ao) {
+  return mix(0.4, 1.0, ao);
+}
+
 void main() {
-	outColor = GammaCorrection(texture(texSampler, fragTexCoord), 1 / 2.2);
+	vec4 color = texture(texSampler, fragTexCoord);
+	float light = Brightness(fragLight.x) * Occlusion(fragLight.y);
+	outColor = GammaCorrection(vec4(color.rgb * light, color.a), 1 / 2.2);
 }
 )";
 
@@ -65,6 +86,7 @@ class Renderer {
 	VkPhysicalDevice				physicalDevice;
 	std::vector<Vertex>				vertices;
 	std::vector<uint32_t>			indices;
+	std::vector<IndexRange>			visibleRanges; // the parts of indices the camera can see this frame
 	VkShaderModule					vertShaderModule;
 	VkShaderModule					fragShaderModule;
 	VkPipeline						graphicsPipeline;
@@ -89,6 +111,8 @@ class Renderer {
 	VkDeviceMemory					indexBufferMemory = NULL;
 
 	Camera							camera;
+	SimulationClock					clock = SimulationClock(AppGlobals::tickRate, AppGlobals::maxTicksPerFrame);
+	float							timeOfDay = AppGlobals::startTimeOfDay; // fraction of a day. 0 is sunrise, 0.25 is noon, 0.5 is sunset
 	
 
 
@@ -536,7 +560,15 @@ public:
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentImage], 0, nullptr);
-		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+
+		// only what's in view. if the world has no mesh yet the buffer holds just the player's chunk, so that all gets drawn
+		AppGlobals::world.getVisibleRanges(camera.getFrustum(), visibleRanges);
+		if (AppGlobals::world.getCullStats().sections == 0) {
+			vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+		}
+		for (auto& range : visibleRanges) {
+			vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, range.firstIndex, 0, 0);
+		}
 	}
 
 	void update(float deltaTime) {
@@ -544,14 +576,29 @@ public:
 		auto& player = AppGlobals::player;
 		auto& world = AppGlobals::world;
 		controller.update();
-		player.update(deltaTime, camera);
-		camera.Update();
+		player.look(camera);
+
+		// the game moves in fixed ticks however long the frame took, and the camera is drawn between the last two
+		int ticks = clock.Advance(deltaTime);
+		float tickLength = clock.GetTickLength();
+		for (int i = 0; i < ticks; i++) {
+			player.update(tickLength, camera);
+
+			// the time of day only feeds the uniform buffer, so it never costs a remesh
+			timeOfDay += tickLength / AppGlobals::dayLength;
+			timeOfDay -= floorf(timeOfDay);
+		}
+		camera.Update(clock.GetAlpha());
 
 		auto playerPosition = player.position;
 		auto playerBoxPosition = player.bbox.position;
 		auto cameraPosition = camera.position;
 
 		float fps = 1.f / deltaTime;
+		auto& chunkLight = world.getChunkLightStats();
+		auto& editLight = world.getEditLightStats();
+		auto& terrain = world.getTerrainStats();
+		auto& culling = world.getCullStats();
 #define PRINTPLS
 #ifdef PRINTPLS
 		SetStdOutCursorPosition(0, 0);
@@ -565,6 +612,13 @@ rotationCam:	x: %4f		y: %4f		z: %4f
 up pressed: %d										
 dt:		%f                                              
 fps:	%f                                         
+ticks:	%d this frame	%.2f between ticks	%llu total	%.2f s dropped		
+time of day:	%f	sky light: %f			
+terrain:		%8.3f ms	%10.1f chunks/s		
+terrain tiles:	%6llu generated	%6llu memory hits	%6llu disk hits		
+chunk light:	%6u cells	%8.3f ms	%12.0f cells/s		
+edit light:		%6u cells	%8.3f ms	%12.0f cells/s		
+culling:		%4u of %4u chunks	%5u of %5u sections	%5u draws		
 
 )",		playerPosition.x, playerPosition.y, playerPosition.z,
 		cameraPosition.x, cameraPosition.y, cameraPosition.z,
@@ -573,12 +627,28 @@ fps:	%f
 		camera.rotation.x, camera.rotation.y, camera.rotation.z,
 		controller.keys[G_KEY_SPACE],
 		deltaTime,
-		fps);
+		fps,
+		ticks, clock.GetAlpha(), clock.totalTicks, clock.droppedSeconds,
+		timeOfDay, GetSkyLight(),
+		terrain.lastMilliseconds, terrain.chunksPerSecond(),
+		terrain.regions, terrain.memoryHits, terrain.diskHits,
+		chunkLight.lastCells, chunkLight.lastMilliseconds, chunkLight.cellsPerSecond(),
+		editLight.lastCells, editLight.lastMilliseconds, editLight.cellsPerSecond(),
+		culling.chunksDrawn, culling.chunks, culling.sectionsDrawn, culling.sections, culling.draws);
 #endif // PRINTPLS
 		
 		world.update(camera, vertices, indices);
 	}
 
+	// how much of the sky light gets through right now. full during the day, nightSkyLight at night,
+	// with a smooth fade while the sun is near the horizon
+	float GetSkyLight() {
+		float sunHeight = sinf(2.f * PI * timeOfDay);
+		float t = clamp((sunHeight + 0.1f) / 0.3f, 0.f, 1.f);
+		t = t * t * (3.f - 2.f * t);
+		return AppGlobals::nightSkyLight + (1.f - AppGlobals::nightSkyLight) * t;
+	}
+
 private:
 	void SetStdOutCursorPosition(short CoordX, short CoordY)
 		//our function to set the cursor position.
@@ -647,7 +717,7 @@ private:
 		ubo.model = Mat4::IdentityMatrix();
 		ubo.view = camera.getViewMatrix();
 		ubo.proj = camera.getProjMatrix();
-
+		ubo.sky = Vec4(GetSkyLight(), 0.f, 0.f, 0.f);
 
 		// All of the transformations are defined now, so we can copy the data in the uniform buffer object to the current uniform
 		// buffer. This happens in exactly the same way as we did for vertex buffers, except without a staging buffer
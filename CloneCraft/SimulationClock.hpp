@@ -0,0 +1,47 @@
+#ifndef SIMULATION_CLOCK_HPP
+#define SIMULATION_CLOCK_HPP
+
+
+#include <algorithm>
+#include <cmath>
+
+// Splits the time between frames into ticks of the same length, so the game moves the same way however fast it's
+// drawn. Time that doesn't make a whole tick is carried over to the next frame, and how far it is into the next
+// tick is what the frame blends the last two ticks by. A frame that took so long it would need more than
+// maxTicksPerFrame ticks to catch up only gets that many and the rest of its time is dropped, so the game slows
+// down for a moment instead of falling further behind every frame.
+class SimulationClock {
+public:
+	unsigned long long totalTicks = 0;
+	double droppedSeconds = 0; // time that was too far behind to catch up on
+
+	SimulationClock(float ticksPerSecond, int maxTicksPerFrame) : tickLength(1.0 / ticksPerSecond), maxTicksPerFrame(maxTicksPerFrame) {}
+
+	// adds the time the last frame took and returns how many ticks to run for it
+	int Advance(float frameTime) {
+		accumulator += std::max(frameTime, 0.f);
+		int ticks = std::min((int)(accumulator / tickLength), maxTicksPerFrame);
+		accumulator -= ticks * tickLength;
+		if (accumulator >= tickLength) {
+			double kept = fmod(accumulator, tickLength);
+			droppedSeconds += accumulator - kept;
+			accumulator = kept;
+		}
+		totalTicks += ticks;
+		lastTicks = ticks;
+		return ticks;
+	}
+
+	float GetTickLength() const { return (float)tickLength; }
+	int GetLastTicks() const { return lastTicks; }
+
+	// how far the time left over is into the next tick. 0 - 1
+	float GetAlpha() const { return (float)std::min(accumulator / tickLength, 1.0); }
+
+private:
+	double tickLength;
+	int maxTicksPerFrame;
+	double accumulator = 0;
+	int lastTicks = 0;
+};
+#endif // SIMULATION_CLOCK_HPP
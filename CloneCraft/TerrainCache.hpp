@@ -0,0 +1,245 @@
+#ifndef TERRAIN_CACHE_HPP
+#define TERRAIN_CACHE_HPP
+
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// everything a terrain tile was generated from. a slot only matches if all of it is the same
+struct TerrainTileKey {
+	int32_t seed;
+	int32_t tileX;
+	int32_t tileZ;
+	int32_t tileChunks; // chunks across the tile
+	int32_t biomes; // 1 if the biomes were applied
+};
+
+// A file of fixed size tile slots that's memory mapped, so reading a tile back is a copy out of the page cache
+// and writing one is a copy into it. Each key can only go in the one slot its hash picks and a new tile just
+// overwrites whatever was there, so the file never grows past slotCount slots. Every slot keeps its key and
+// a checksum in front of its data, so a slot that was overwritten since, or only half written when the game
+// closed, reads as a miss and the tile gets generated again.
+class TerrainTileFile {
+public:
+	static const uint32_t FILE_MAGIC = 0x54434354; // "TCCT"
+	static const uint32_t SLOT_MAGIC = 0x544C4954; // "TILT"
+	static const uint32_t VERSION = 1; // bump when the generator changes what a tile holds, to throw the old tiles out
+
+	TerrainTileFile() {}
+	~TerrainTileFile() { Close(); }
+	TerrainTileFile(const TerrainTileFile&) = delete;
+	TerrainTileFile& operator=(const TerrainTileFile&) = delete;
+
+	// opens path, or makes it, with slotCount slots of dataSize bytes. a file made with a different layout or
+	// version is emptied first. returns false if it can't be opened or mapped, and nothing else changes.
+	bool Open(const std::string& path, int slotCount, int dataSize) {
+		Close();
+		if (slotCount <= 0 || dataSize <= 0) {
+			return false;
+		}
+
+		slots = slotCount;
+		slotDataSize = dataSize;
+		size = sizeof(FileHeader) + (unsigned long long)slotCount * slotSize();
+
+		if (!mapFile(path)) {
+			Close();
+			return false;
+		}
+
+		FileHeader* header = (FileHeader*)base;
+		if (header->magic != FILE_MAGIC || header->version != VERSION || header->slotCount != (uint32_t)slotCount || header->dataSize != (uint32_t)dataSize) {
+			memset(base, 0, (size_t)size);
+			header->magic = FILE_MAGIC;
+			header->version = VERSION;
+			header->slotCount = slotCount;
+			header->dataSize = dataSize;
+		}
+		return true;
+	}
+
+	void Close() {
+		#ifdef _WIN32
+		if (base) {
+			UnmapViewOfFile(base);
+		}
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+		#else
+		if (base) {
+			munmap(base, (size_t)size);
+		}
+		if (file >= 0) {
+			close(file);
+		}
+		file = -1;
+		#endif
+		base = nullptr;
+	}
+
+	bool IsOpen() const { return base != nullptr; }
+	int GetDataSize() const { return slotDataSize; }
+
+	// copies the tile for key into data if its slot still holds it
+	bool Read(const TerrainTileKey& key, unsigned char* data) const {
+		if (!base) {
+			return false;
+		}
+
+		const unsigned char* slot = slotFor(key);
+		SlotHeader header;
+		memcpy(&header, slot, sizeof(header));
+		if (header.magic != SLOT_MAGIC || memcmp(&header.key, &key, sizeof(key)) != 0) {
+			return false;
+		}
+
+		const unsigned char* slotData = slot + sizeof(SlotHeader);
+		if (header.checksum != checksum(key, slotData, slotDataSize)) {
+			return false;
+		}
+
+		memcpy(data, slotData, slotDataSize);
+		return true;
+	}
+
+	// puts the tile in its slot over whatever was there
+	void Write(const TerrainTileKey& key, const unsigned char* data) {
+		if (!base) {
+			return;
+		}
+
+		unsigned char* slot = slotFor(key);
+		SlotHeader header;
+		header.magic = 0; // written last, so a slot that's only half written never looks whole
+		header.checksum = checksum(key, data, slotDataSize);
+		header.key = key;
+		memcpy(slot, &header, sizeof(header));
+		memcpy(slot + sizeof(SlotHeader), data, slotDataSize);
+		header.magic = SLOT_MAGIC;
+		memcpy(slot, &header.magic, sizeof(header.magic));
+	}
+
+private:
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slotCount;
+		uint32_t dataSize;
+	};
+
+	struct SlotHeader {
+		uint32_t magic;
+		uint32_t checksum;
+		TerrainTileKey key;
+	};
+
+	unsigned char* base = nullptr;
+	unsigned long long size = 0;
+	int slots = 0;
+	int slotDataSize = 0;
+	#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	#else
+	int file = -1;
+	#endif
+
+	unsigned long long slotSize() const {
+		// keep every slot 8 byte aligned
+		return (sizeof(SlotHeader) + slotDataSize + 7) & ~7ull;
+	}
+
+	unsigned char* slotFor(const TerrainTileKey& key) const {
+		uint32_t hash = fnv1a(2166136261u, &key, sizeof(key));
+		return base + sizeof(FileHeader) + (hash % (uint32_t)slots) * slotSize();
+	}
+
+	static uint32_t fnv1a(uint32_t hash, const void* bytes, size_t count) {
+		const unsigned char* p = (const unsigned char*)bytes;
+		for (size_t i = 0; i < count; i++) {
+			hash = (hash ^ p[i]) * 16777619u;
+		}
+		return hash;
+	}
+
+	static uint32_t checksum(const TerrainTileKey& key, const unsigned char* data, int count) {
+		return fnv1a(fnv1a(2166136261u, &key, sizeof(key)), data, count);
+	}
+
+	// a file of exactly size bytes mapped read write. a file of the wrong size is cut to nothing first, so
+	// the part that gets added back reads as zeros
+	bool mapFile(const std::string& path) {
+		#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			return false;
+		}
+		if ((unsigned long long)fileSize.QuadPart != size) {
+			LARGE_INTEGER position;
+			position.QuadPart = 0;
+			if (!SetFilePointerEx(file, position, NULL, FILE_BEGIN) || !SetEndOfFile(file)) {
+				return false;
+			}
+			position.QuadPart = (LONGLONG)size;
+			if (!SetFilePointerEx(file, position, NULL, FILE_BEGIN) || !SetEndOfFile(file)) {
+				return false;
+			}
+		}
+
+		mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+		if (!mapping) {
+			return false;
+		}
+		base = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+		return base != nullptr;
+		#else
+		file = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (file < 0) {
+			return false;
+		}
+
+		struct stat info;
+		if (fstat(file, &info) != 0) {
+			return false;
+		}
+		if ((unsigned long long)info.st_size != size) {
+			if (ftruncate(file, 0) != 0 || ftruncate(file, (off_t)size) != 0) {
+				return false;
+			}
+		}
+
+		void* mapped = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		if (mapped == MAP_FAILED) {
+			return false;
+		}
+		base = (unsigned char*)mapped;
+		return true;
+		#endif
+	}
+};
+#endif // TERRAIN_CACHE_HPP
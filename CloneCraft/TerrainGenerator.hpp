@@ -7,13 +7,45 @@
 #endif
 #include "noise/noise.h"
 #include "noiseutils.h"
-#include <time.h>
+#include "NoiseProgram.hpp"
+#include "Biome.hpp"
+#include "TerrainCache.hpp"
+#include <chrono>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+struct TerrainStats {
+	double lastMilliseconds = 0;
+	double totalMilliseconds = 0;
+	unsigned long long chunks = 0;
+	unsigned long long regions = 0; // tiles of chunks sampled from the noise in one go
+	unsigned long long memoryHits = 0; // lookups that found their tile already cached in memory
+	unsigned long long diskHits = 0; // tiles read back from the tile file instead of being sampled
+
+	double chunksPerSecond() const {
+		return totalMilliseconds > 0 ? chunks / (totalMilliseconds / 1000.0) : 0;
+	}
+};
 
 class TerrainGenerator {
 public:
-	TerrainGenerator(){}
+	TerrainStats stats; // GetHeights timings
 
 	module::Perlin myModule;
+	NoiseProgram program; // myModule compiled, GetHeights uses it when AppGlobals::builtInNoise is on
+	module::Perlin densityModule; // the 3d noise GetSolid carves the heightmap with
+	NoiseProgram densityProgram;
+	BiomeMap biomeMap; // reshapes the heights and picks the surface blocks when AppGlobals::biomes is on
+
+	// GetSolid works the density out on a lattice of points this many blocks apart and interpolates in between
+	static const int DENSITY_CELL_WIDTH = 4;
+	static const int DENSITY_CELL_HEIGHT = 8;
+	static const int LATTICE_WIDTH = AppGlobals::CHUNK_WIDTH / DENSITY_CELL_WIDTH + 1;
+	static const int LATTICE_HEIGHT = AppGlobals::CHUNK_HEIGHT / DENSITY_CELL_HEIGHT + 1;
+	static const int DENSITY_SCALE = 32; // blocks per unit of 3d noise
+	static const int DENSITY_SQUASH = 16; // blocks above or below the heightmap that cancel out one unit of 3d noise
+	static constexpr double DENSITY_LATTICE_TOLERANCE = 0.05; // fraction of solid blocks the lattice can get wrong before BenchmarkDensity fails
 	utils::NoiseMap heightMap;
 	utils::NoiseMapBuilderPlane heightMapBuilder;
 	utils::RendererImage renderer;
@@ -30,13 +62,7 @@ public:
 		double lowBoundZ = chunkZ / scalar;
 		double highBoundZ = (chunkZ + 1) / scalar;
 
-		// if there is no seed, create one from the current time
-		if (AppGlobals::seed == -1) {
-			AppGlobals::seed = time(NULL);
-		}
-		
-		// apply the seed
-		myModule.SetSeed(AppGlobals::seed);
+		applySeed();
 
 		// create the heightmap
 		heightMapBuilder.SetSourceModule(myModule);
@@ -61,8 +87,1024 @@ public:
 		return &image;
 	}
 
+	// the height noise over a rectangle of chunks as one picture, coloured with the terrain gradient, a pixel for
+	// every blocksPerPixel blocks. it's a preview of the lay of the land for map exports, not what chunks are built
+	// from, so unlike GetTerrain it doesn't have to match GetHeights. myModule is a plain Perlin that keeps no
+	// state between calls, so rows can be filled on threadCount threads at once
+	void RenderNoisePreview(int lowChunkX, int lowChunkZ, int chunksWide, int chunksHigh, int blocksPerPixel, int threadCount, utils::Image& preview) {
+		double scalar = static_cast<double>(25.0000000000);
+		applySeed();
+
+		utils::NoiseMap noiseMap;
+		utils::NoiseMapBuilderPlane builder;
+		builder.SetSourceModule(myModule);
+		builder.SetDestNoiseMap(noiseMap);
+		builder.SetDestSize(chunksWide * AppGlobals::CHUNK_WIDTH / blocksPerPixel, chunksHigh * AppGlobals::CHUNK_WIDTH / blocksPerPixel);
+		builder.SetBounds(lowChunkX / scalar, (lowChunkX + chunksWide) / scalar, lowChunkZ / scalar, (lowChunkZ + chunksHigh) / scalar);
+		builder.SetThreadCount(threadCount);
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		builder.Build();
+		auto midTime = std::chrono::high_resolution_clock::now();
+
+		utils::RendererImage previewRenderer;
+		previewRenderer.SetSourceNoiseMap(noiseMap);
+		previewRenderer.SetDestImage(preview);
+		previewRenderer.BuildTerrainGradient();
+		previewRenderer.EnableColorTable(true); // a step of the table off the exact color doesn't matter in a preview
+		previewRenderer.SetThreadCount(threadCount);
+		previewRenderer.Render();
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		double megapixels = (double)noiseMap.GetWidth() * noiseMap.GetHeight() / 1e6;
+		double buildSeconds = std::chrono::duration<double>(midTime - startTime).count();
+		double renderSeconds = std::chrono::duration<double>(endTime - midTime).count();
+		std::string threads = threadCount == utils::THREAD_COUNT_ALL_CORES ? "a thread per core" : std::to_string(threadCount) + (threadCount == 1 ? " thread" : " threads");
+		printf("  noise preview: %dx%d pixels on %s. noise map %.2f s (%.1f megapixels/s), image %.2f s (%.1f megapixels/s)\n",
+			noiseMap.GetWidth(), noiseMap.GetHeight(), threads.c_str(), buildSeconds, megapixels / buildSeconds, renderSeconds, megapixels / renderSeconds);
+	}
+
+	// the height of each column in a chunk, sampled straight from the noise module. with AppGlobals::biomes off
+	// it gives exactly the same heights as GetTerrain without building a noise map or an image.
+	//
+	// heights are sampled a tile of AppGlobals::terrainRegionChunks chunks across at a time, and the tiles are
+	// kept in a least recently used cache of AppGlobals::terrainCacheTiles, so going back to chunks that were
+	// unloaded slices them out of a tile again instead of sampling the noise. with AppGlobals::terrainCacheFile
+	// set, tiles are also kept in that file and read back from it, in this run or a later one.
+	void GetHeights(int chunkX, int chunkZ, int (&heights)[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH]) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		const int W = AppGlobals::CHUNK_WIDTH;
+
+		applySeed();
+		const unsigned char* first = tileColumns(chunkX, chunkZ);
+		int tileWidth = cachedTileChunks * W;
+		for (int z = 0; z < W; z++) {
+			for (int x = 0; x < W; x++) {
+				heights[x][z] = first[z * tileWidth + x];
+			}
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		stats.lastMilliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		stats.totalMilliseconds += stats.lastMilliseconds;
+		stats.chunks++;
+	}
+
+	// times GetTerrain against GetHeights with libnoise and with the built in noise, over the same square of
+	// chunks, and checks they all agree. then times going back over chunks whose tiles are still cached.
+	// returns how many columns, values and blocks came out wrong across this and the benchmarks it runs after
+	int Benchmark(int chunksAcross) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		int heights[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+		int mismatches = 0;
+		TerrainStats oldStats = stats;
+		bool oldBuiltInNoise = AppGlobals::builtInNoise;
+		bool oldBiomes = AppGlobals::biomes;
+		int oldRegionChunks = AppGlobals::terrainRegionChunks;
+
+		// GetTerrain doesn't know about biomes, so they're off for everything compared against it. the tile file
+		// is left out until the end so every pass samples the noise
+		AppGlobals::biomes = false;
+		useTileFile = false;
+
+		auto timeChunks = [&](bool useImage, bool useBuiltInNoise, int regionChunks, bool keepTiles) {
+			AppGlobals::builtInNoise = useBuiltInNoise;
+			AppGlobals::terrainRegionChunks = regionChunks;
+			if (!keepTiles) {
+				clearTiles();
+			}
+			auto startTime = std::chrono::high_resolution_clock::now();
+			for (int x = 0; x < chunksAcross; x++) {
+				for (int z = 0; z < chunksAcross; z++) {
+					if (useImage) {
+						GetTerrain(x, z);
+					}
+					else {
+						GetHeights(x, z, heights);
+					}
+				}
+			}
+			auto endTime = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<double>(endTime - startTime).count();
+		};
+
+		double imageSeconds = timeChunks(true, false, 1, false);
+		double directSeconds = timeChunks(false, false, 1, false);
+		double builtInSeconds = timeChunks(false, true, 1, false);
+		double regionSeconds = timeChunks(false, true, 4, false);
+		double bigRegionSeconds = timeChunks(false, true, 8, false);
+
+		AppGlobals::biomes = true;
+		biomeMap.Clear();
+		BiomeStats oldBiomeStats = biomeMap.stats;
+		double biomeSeconds = timeChunks(false, true, 4, false);
+		BiomeStats biomeStats = biomeMap.stats;
+		biomeMap.stats = oldBiomeStats;
+
+		// the same chunks again with their tiles still in memory, then read back from the file if there is one
+		TerrainStats cacheStats = stats;
+		double memorySeconds = timeChunks(false, true, 4, true);
+		unsigned long long memoryHits = stats.memoryHits - cacheStats.memoryHits;
+		double diskSeconds = 0;
+		unsigned long long diskHits = 0;
+		useTileFile = true;
+		AppGlobals::terrainRegionChunks = oldRegionChunks; // so the file gets slots for the tiles the game will use
+		openTileFile();
+		if (tileFile.IsOpen() && tileFile.GetDataSize() == 4 * W * 4 * W * 2) {
+			timeChunks(false, true, 4, false); // makes sure every tile is in the file
+			cacheStats = stats;
+			diskSeconds = timeChunks(false, true, 4, false);
+			diskHits = stats.diskHits - cacheStats.diskHits;
+		}
+		useTileFile = false;
+		AppGlobals::biomes = false;
+
+		// every column from the image, from libnoise chunk by chunk and from the built in noise a region at a time
+		int columns = chunksAcross * chunksAcross * W * W;
+		std::vector<int> imageHeights(columns);
+		std::vector<int> directHeights(columns);
+		std::vector<int> builtInHeights(columns);
+		auto collect = [&](bool useImage, bool useBuiltInNoise, int regionChunks, std::vector<int>& out) {
+			AppGlobals::builtInNoise = useBuiltInNoise;
+			AppGlobals::terrainRegionChunks = regionChunks;
+			clearTiles();
+			int* column = out.data();
+			for (int x = 0; x < chunksAcross; x++) {
+				for (int z = 0; z < chunksAcross; z++) {
+					utils::Image* img = useImage ? GetTerrain(x, z) : nullptr;
+					if (!useImage) {
+						GetHeights(x, z, heights);
+					}
+					for (int i = 0; i < W; i++) {
+						for (int j = 0; j < W; j++) {
+							*column++ = useImage ? img->GetValue(i, j).red : heights[i][j];
+						}
+					}
+				}
+			}
+		};
+		collect(true, false, 1, imageHeights);
+		collect(false, false, 1, directHeights);
+		collect(false, true, 4, builtInHeights);
+		for (int i = 0; i < columns; i++) {
+			mismatches += imageHeights[i] != directHeights[i] || directHeights[i] != builtInHeights[i];
+		}
+
+		stats = oldStats;
+		AppGlobals::builtInNoise = oldBuiltInNoise;
+		AppGlobals::terrainRegionChunks = oldRegionChunks;
+		AppGlobals::biomes = oldBiomes;
+		useTileFile = true;
+		clearTiles();
+
+		int chunks = chunksAcross * chunksAcross;
+		printf("terrain benchmark: %d chunks\n", chunks);
+		printf("  image pipeline:          %10.1f chunks/s\n", chunks / imageSeconds);
+		printf("  direct heights, libnoise:%10.1f chunks/s  (%.2fx)\n", chunks / directSeconds, imageSeconds / directSeconds);
+		printf("  direct heights, built in:%10.1f chunks/s  (%.2fx)\n", chunks / builtInSeconds, imageSeconds / builtInSeconds);
+		printf("  4x4 chunk regions:       %10.1f chunks/s  (%.2fx)\n", chunks / regionSeconds, imageSeconds / regionSeconds);
+		printf("  8x8 chunk regions:       %10.1f chunks/s  (%.2fx)\n", chunks / bigRegionSeconds, imageSeconds / bigRegionSeconds);
+		printf("  4x4 regions with biomes: %10.1f chunks/s  (%.2fx the time without, %llu biome tiles built, %llu reused)\n", chunks / biomeSeconds, biomeSeconds / regionSeconds, biomeStats.tilesBuilt - oldBiomeStats.tilesBuilt, biomeStats.tileHits - oldBiomeStats.tileHits);
+		printf("  revisit, tiles in memory:%10.1f chunks/s  (%.2fx generating them, %llu hits)\n", chunks / memorySeconds, biomeSeconds / memorySeconds, memoryHits);
+		if (diskSeconds > 0) {
+			printf("  revisit, tiles on disk:  %10.1f chunks/s  (%.2fx generating them, %llu tiles read)\n", chunks / diskSeconds, biomeSeconds / diskSeconds, diskHits);
+		}
+		printf("  mismatched columns: %d\n", mismatches);
+
+		mismatches += BenchmarkProgram(chunksAcross);
+		mismatches += BenchmarkDensity(chunksAcross);
+		return mismatches;
+	}
+
+	// the biome of each column in a chunk, which decides its surface blocks. they come out of the same cached
+	// tile as the heights. all plains with biomes off.
+	void GetBiomes(int chunkX, int chunkZ, Biome (&biomes)[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH]) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+
+		if (!AppGlobals::biomes) {
+			for (int x = 0; x < W; x++) {
+				for (int z = 0; z < W; z++) {
+					biomes[x][z] = Biome::Plains;
+				}
+			}
+			return;
+		}
+
+		applySeed();
+		const unsigned char* first = tileColumns(chunkX, chunkZ);
+		int tileWidth = cachedTileChunks * W;
+		first += tileWidth * tileWidth; // the biomes come after the heights
+		for (int z = 0; z < W; z++) {
+			for (int x = 0; x < W; x++) {
+				biomes[x][z] = static_cast<Biome>(first[z * tileWidth + x]);
+			}
+		}
+	}
+
+	// which blocks in a chunk are solid when the heightmap is carved up by 3d noise, for overhangs and caves.
+	// a block is solid where (height - y) / DENSITY_SQUASH + noise is above 0. solid is indexed
+	// [(x * CHUNK_WIDTH + z) * CHUNK_HEIGHT + y] so each column is contiguous.
+	//
+	// with interpolate on, the density is only sampled on a lattice with a point every DENSITY_CELL_WIDTH blocks
+	// across and DENSITY_CELL_HEIGHT up, and filled in trilinearly, which is about 80 times fewer noise samples
+	// than sampling every block. the lattice points sit on chunk borders, so neighbouring chunks line up.
+	void GetSolid(int chunkX, int chunkZ, std::vector<unsigned char>& solid, bool interpolate = true) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		applySeed();
+		solid.resize(W * W * H);
+
+		if (!interpolate) {
+			int heights[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+			GetHeights(chunkX, chunkZ, heights);
+
+			densityX.resize(W * W * H);
+			densityY.resize(W * W * H);
+			densityZ.resize(W * W * H);
+			for (int x = 0; x < W; x++) {
+				for (int z = 0; z < W; z++) {
+					for (int y = 0; y < H; y++) {
+						int i = (x * W + z) * H + y;
+						densityX[i] = (double)(chunkX * W + x) / DENSITY_SCALE;
+						densityY[i] = (double)y / DENSITY_SCALE;
+						densityZ[i] = (double)(chunkZ * W + z) / DENSITY_SCALE;
+					}
+				}
+			}
+			sampleDensityNoise(densityX.data());
+
+			for (int x = 0; x < W; x++) {
+				for (int z = 0; z < W; z++) {
+					for (int y = 0; y < H; y++) {
+						int i = (x * W + z) * H + y;
+						solid[i] = density(heights[x][z], y, densityX[i]) > 0.0;
+					}
+				}
+			}
+			return;
+		}
+
+		// the heightmap at the lattice columns. the last one in each direction is the next chunk's first column
+		double xs[AppGlobals::CHUNK_WIDTH * 2];
+		double zs[AppGlobals::CHUNK_WIDTH * 2];
+		columnCoords(chunkX, 2, xs);
+		columnCoords(chunkZ, 2, zs);
+
+		double latticeXs[LATTICE_WIDTH * LATTICE_WIDTH];
+		double latticeYs[LATTICE_WIDTH * LATTICE_WIDTH] = {};
+		double latticeZs[LATTICE_WIDTH * LATTICE_WIDTH];
+		double latticeHeights[LATTICE_WIDTH * LATTICE_WIDTH];
+		for (int i = 0; i < LATTICE_WIDTH; i++) {
+			for (int j = 0; j < LATTICE_WIDTH; j++) {
+				latticeXs[i * LATTICE_WIDTH + j] = xs[i * DENSITY_CELL_WIDTH];
+				latticeZs[i * LATTICE_WIDTH + j] = zs[j * DENSITY_CELL_WIDTH];
+			}
+		}
+		if (AppGlobals::builtInNoise) {
+			program.GetValues(latticeXs, latticeYs, latticeZs, latticeHeights, LATTICE_WIDTH * LATTICE_WIDTH);
+		}
+		else {
+			for (int i = 0; i < LATTICE_WIDTH * LATTICE_WIDTH; i++) {
+				latticeHeights[i] = myModule.GetValue(latticeXs[i], 0, latticeZs[i]);
+			}
+		}
+
+		// the density at every lattice point, stored [(i * LATTICE_WIDTH + j) * LATTICE_HEIGHT + k]
+		const int LATTICE_POINTS = LATTICE_WIDTH * LATTICE_WIDTH * LATTICE_HEIGHT;
+		densityX.resize(LATTICE_POINTS);
+		densityY.resize(LATTICE_POINTS);
+		densityZ.resize(LATTICE_POINTS);
+		for (int i = 0; i < LATTICE_WIDTH; i++) {
+			for (int j = 0; j < LATTICE_WIDTH; j++) {
+				for (int k = 0; k < LATTICE_HEIGHT; k++) {
+					int point = (i * LATTICE_WIDTH + j) * LATTICE_HEIGHT + k;
+					densityX[point] = (double)(chunkX * W + i * DENSITY_CELL_WIDTH) / DENSITY_SCALE;
+					densityY[point] = (double)(k * DENSITY_CELL_HEIGHT) / DENSITY_SCALE;
+					densityZ[point] = (double)(chunkZ * W + j * DENSITY_CELL_WIDTH) / DENSITY_SCALE;
+				}
+			}
+		}
+		sampleDensityNoise(densityX.data());
+		if (AppGlobals::biomes) {
+			// the lattice columns are every DENSITY_CELL_WIDTH blocks from the chunk's corner up to the next chunk's
+			biomeScales.resize((W + 1) * (W + 1));
+			biomeBiases.resize((W + 1) * (W + 1));
+			biomeMap.GetColumns(chunkX * W, chunkZ * W, W + 1, W + 1, biomeScales.data(), biomeBiases.data(), nullptr);
+			for (int i = 0; i < LATTICE_WIDTH; i++) {
+				for (int j = 0; j < LATTICE_WIDTH; j++) {
+					int column = j * DENSITY_CELL_WIDTH * (W + 1) + i * DENSITY_CELL_WIDTH;
+					double& value = latticeHeights[i * LATTICE_WIDTH + j];
+					value = (float)value * biomeScales[column] + biomeBiases[column];
+				}
+			}
+		}
+		for (int column = 0; column < LATTICE_WIDTH * LATTICE_WIDTH; column++) {
+			int height = toHeight((float)latticeHeights[column]);
+			for (int k = 0; k < LATTICE_HEIGHT; k++) {
+				int point = column * LATTICE_HEIGHT + k;
+				densityX[point] = density(height, k * DENSITY_CELL_HEIGHT, densityX[point]);
+			}
+		}
+
+		// blend the 4 lattice columns around each block column, then step up it a cell at a time
+		const double* lattice = densityX.data();
+		double column[LATTICE_HEIGHT];
+		for (int x = 0; x < W; x++) {
+			int i = x / DENSITY_CELL_WIDTH;
+			double tx = (double)(x % DENSITY_CELL_WIDTH) / DENSITY_CELL_WIDTH;
+
+			for (int z = 0; z < W; z++) {
+				int j = z / DENSITY_CELL_WIDTH;
+				double tz = (double)(z % DENSITY_CELL_WIDTH) / DENSITY_CELL_WIDTH;
+				const double* c00 = lattice + (i * LATTICE_WIDTH + j) * LATTICE_HEIGHT;
+				const double* c01 = lattice + (i * LATTICE_WIDTH + j + 1) * LATTICE_HEIGHT;
+				const double* c10 = lattice + ((i + 1) * LATTICE_WIDTH + j) * LATTICE_HEIGHT;
+				const double* c11 = lattice + ((i + 1) * LATTICE_WIDTH + j + 1) * LATTICE_HEIGHT;
+
+				for (int k = 0; k < LATTICE_HEIGHT; k++) {
+					double front = c00[k] + (c10[k] - c00[k]) * tx;
+					double back = c01[k] + (c11[k] - c01[k]) * tx;
+					column[k] = front + (back - front) * tz;
+				}
+
+				unsigned char* out = &solid[(x * W + z) * H];
+				for (int k = 0; k < LATTICE_HEIGHT - 1; k++) {
+					double value = column[k];
+					double step = (column[k + 1] - column[k]) / DENSITY_CELL_HEIGHT;
+					for (int y = 0; y < DENSITY_CELL_HEIGHT; y++) {
+						out[k * DENSITY_CELL_HEIGHT + y] = value > 0.0;
+						value += step;
+					}
+				}
+			}
+		}
+	}
+
+	// the heights of single columns at world block coords xs[i], zs[i], worked out straight from the noise
+	// without sampling or caching a tile. they come out exactly as GetHeights would give them.
+	void GetColumnHeights(const int* xs, const int* zs, int count, int* heights) {
+		applySeed();
+		queryX.resize(count);
+		queryY.assign(count, 0.0);
+		queryZ.resize(count);
+		queryValues.resize(count);
+		for (int i = 0; i < count; i++) {
+			queryX[i] = columnCoord(xs[i]);
+			queryZ[i] = columnCoord(zs[i]);
+		}
+
+		if (AppGlobals::builtInNoise) {
+			program.GetValues(queryX.data(), queryY.data(), queryZ.data(), queryValues.data(), count);
+		}
+		else {
+			for (int i = 0; i < count; i++) {
+				queryValues[i] = myModule.GetValue(queryX[i], 0, queryZ[i]);
+			}
+		}
+
+		for (int i = 0; i < count; i++) {
+			float value = (float)queryValues[i];
+			if (AppGlobals::biomes) {
+				float scale, bias;
+				biomeMap.GetColumns(xs[i], zs[i], 1, 1, &scale, &bias, nullptr);
+				value = value * scale + bias;
+			}
+			heights[i] = toHeight(value);
+		}
+	}
+
+	int GetColumnHeight(int x, int z) {
+		int height;
+		GetColumnHeights(&x, &z, 1, &height);
+		return height;
+	}
+
+	// the biome of a single column, the same as GetBiomes. plains with biomes off
+	Biome GetColumnBiome(int x, int z) {
+		if (!AppGlobals::biomes) {
+			return Biome::Plains;
+		}
+
+		applySeed();
+		Biome biome;
+		biomeMap.GetColumns(x, z, 1, 1, nullptr, nullptr, &biome);
+		return biome;
+	}
+
+	// one column of GetSolid at world block coords x, z, from just the 4 lattice columns around it. every step
+	// is done the same way GetSolid does it, so it comes out exactly the same. solid has CHUNK_HEIGHT entries
+	void GetSolidColumn(int x, int z, unsigned char* solid) {
+		const int CORNERS = 4;
+		applySeed();
+
+		// the lattice columns at the cell's corners, in the order 00, 01, 10, 11
+		int cellX = floorDiv(x, DENSITY_CELL_WIDTH);
+		int cellZ = floorDiv(z, DENSITY_CELL_WIDTH);
+		int cornerX[CORNERS], cornerZ[CORNERS];
+		double heightX[CORNERS], heightY[CORNERS] = {}, heightZ[CORNERS], cornerHeights[CORNERS];
+		for (int c = 0; c < CORNERS; c++) {
+			cornerX[c] = (cellX + c / 2) * DENSITY_CELL_WIDTH;
+			cornerZ[c] = (cellZ + c % 2) * DENSITY_CELL_WIDTH;
+			heightX[c] = columnCoord(cornerX[c]);
+			heightZ[c] = columnCoord(cornerZ[c]);
+		}
+		if (AppGlobals::builtInNoise) {
+			program.GetValues(heightX, heightY, heightZ, cornerHeights, CORNERS);
+		}
+		else {
+			for (int c = 0; c < CORNERS; c++) {
+				cornerHeights[c] = myModule.GetValue(heightX[c], 0, heightZ[c]);
+			}
+		}
+
+		double densities[CORNERS * LATTICE_HEIGHT];
+		double pointX[CORNERS * LATTICE_HEIGHT], pointY[CORNERS * LATTICE_HEIGHT], pointZ[CORNERS * LATTICE_HEIGHT];
+		for (int c = 0; c < CORNERS; c++) {
+			for (int k = 0; k < LATTICE_HEIGHT; k++) {
+				pointX[c * LATTICE_HEIGHT + k] = (double)cornerX[c] / DENSITY_SCALE;
+				pointY[c * LATTICE_HEIGHT + k] = (double)(k * DENSITY_CELL_HEIGHT) / DENSITY_SCALE;
+				pointZ[c * LATTICE_HEIGHT + k] = (double)cornerZ[c] / DENSITY_SCALE;
+			}
+		}
+		if (AppGlobals::builtInNoise) {
+			densityProgram.GetValues(pointX, pointY, pointZ, densities, CORNERS * LATTICE_HEIGHT);
+		}
+		else {
+			for (int i = 0; i < CORNERS * LATTICE_HEIGHT; i++) {
+				densities[i] = densityModule.GetValue(pointX[i], pointY[i], pointZ[i]);
+			}
+		}
+
+		for (int c = 0; c < CORNERS; c++) {
+			if (AppGlobals::biomes) {
+				float scale, bias;
+				biomeMap.GetColumns(cornerX[c], cornerZ[c], 1, 1, &scale, &bias, nullptr);
+				cornerHeights[c] = (float)cornerHeights[c] * scale + bias;
+			}
+			int height = toHeight((float)cornerHeights[c]);
+			for (int k = 0; k < LATTICE_HEIGHT; k++) {
+				densities[c * LATTICE_HEIGHT + k] = density(height, k * DENSITY_CELL_HEIGHT, densities[c * LATTICE_HEIGHT + k]);
+			}
+		}
+
+		double tx = (double)(x - cellX * DENSITY_CELL_WIDTH) / DENSITY_CELL_WIDTH;
+		double tz = (double)(z - cellZ * DENSITY_CELL_WIDTH) / DENSITY_CELL_WIDTH;
+		const double* c00 = densities;
+		const double* c01 = densities + LATTICE_HEIGHT;
+		const double* c10 = densities + 2 * LATTICE_HEIGHT;
+		const double* c11 = densities + 3 * LATTICE_HEIGHT;
+		double column[LATTICE_HEIGHT];
+		for (int k = 0; k < LATTICE_HEIGHT; k++) {
+			double front = c00[k] + (c10[k] - c00[k]) * tx;
+			double back = c01[k] + (c11[k] - c01[k]) * tx;
+			column[k] = front + (back - front) * tz;
+		}
+
+		for (int k = 0; k < LATTICE_HEIGHT - 1; k++) {
+			double value = column[k];
+			double step = (column[k + 1] - column[k]) / DENSITY_CELL_HEIGHT;
+			for (int y = 0; y < DENSITY_CELL_HEIGHT; y++) {
+				solid[k * DENSITY_CELL_HEIGHT + y] = value > 0.0;
+				value += step;
+			}
+		}
+	}
+
+	// times GetSolid on the lattice against sampling every block, and how often they agree. the lattice is only
+	// ever close, so the blocks that differ only count as mismatches past DENSITY_LATTICE_TOLERANCE
+	int BenchmarkDensity(int chunksAcross) {
+		std::vector<unsigned char> lattice;
+		std::vector<unsigned char> perBlock;
+		long long differing = 0;
+		long long solidBlocks = 0;
+		double latticeSeconds = 0;
+		double perBlockSeconds = 0;
+		int oldRegionChunks = AppGlobals::terrainRegionChunks;
+		TerrainStats oldStats = stats;
+		AppGlobals::terrainRegionChunks = 1;
+
+		for (int x = 0; x < chunksAcross; x++) {
+			for (int z = 0; z < chunksAcross; z++) {
+				auto startTime = std::chrono::high_resolution_clock::now();
+				GetSolid(x, z, lattice, true);
+				auto midTime = std::chrono::high_resolution_clock::now();
+				GetSolid(x, z, perBlock, false);
+				auto endTime = std::chrono::high_resolution_clock::now();
+				latticeSeconds += std::chrono::duration<double>(midTime - startTime).count();
+				perBlockSeconds += std::chrono::duration<double>(endTime - midTime).count();
+
+				for (size_t i = 0; i < lattice.size(); i++) {
+					differing += lattice[i] != perBlock[i];
+					solidBlocks += perBlock[i];
+				}
+			}
+		}
+		AppGlobals::terrainRegionChunks = oldRegionChunks;
+		stats = oldStats;
+
+		int chunks = chunksAcross * chunksAcross;
+		printf("density terrain benchmark: %d chunks\n", chunks);
+		printf("  every block:     %10.1f chunks/s\n", chunks / perBlockSeconds);
+		printf("  %dx%dx%d lattice:  %10.1f chunks/s  (%.2fx)\n", DENSITY_CELL_WIDTH, DENSITY_CELL_HEIGHT, DENSITY_CELL_WIDTH, chunks / latticeSeconds, perBlockSeconds / latticeSeconds);
+		printf("  blocks that differ: %lld of %lld solid (%.2f%%, %.2f%% allowed)\n", differing, solidBlocks, solidBlocks > 0 ? 100.0 * differing / solidBlocks : 0.0, 100.0 * DENSITY_LATTICE_TOLERANCE);
+		return differing > solidBlocks * DENSITY_LATTICE_TOLERANCE ? (int)differing : 0;
+	}
+
+	// builds a mountains and plains style tree of modules and times the compiled program against calling
+	// GetValue on it, checking every value comes out the same. returns how many didn't, plus the values the op
+	// checks got wrong
+	int BenchmarkProgram(int chunksAcross) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		double scalar = static_cast<double>(25.0000000000);
+
+		module::RidgedMulti mountains;
+		mountains.SetSeed(AppGlobals::seed);
+
+		module::Billow plainsBase;
+		plainsBase.SetSeed(AppGlobals::seed + 1);
+		plainsBase.SetFrequency(2.0);
+
+		module::ScaleBias plains;
+		plains.SetSourceModule(0, plainsBase);
+		plains.SetScale(0.125);
+		plains.SetBias(-0.75);
+
+		module::Perlin terrainType;
+		terrainType.SetSeed(AppGlobals::seed + 2);
+		terrainType.SetFrequency(0.5);
+		terrainType.SetPersistence(0.25);
+
+		module::Select selector;
+		selector.SetSourceModule(0, plains);
+		selector.SetSourceModule(1, mountains);
+		selector.SetControlModule(terrainType);
+		selector.SetBounds(0.0, 1000.0);
+		selector.SetEdgeFalloff(0.125);
+
+		module::Turbulence finalTerrain;
+		finalTerrain.SetSourceModule(0, selector);
+		finalTerrain.SetSeed(AppGlobals::seed + 3);
+		finalTerrain.SetFrequency(4.0);
+		finalTerrain.SetPower(0.125);
+
+		NoiseProgram terrainProgram(finalTerrain);
+
+		int count = chunksAcross * W * chunksAcross * W;
+		std::vector<double> xs(count), ys(count, 0.0), zs(count), moduleValues(count), programValues(count);
+		for (int i = 0; i < count; i++) {
+			xs[i] = (i % (chunksAcross * W)) / (scalar * W);
+			zs[i] = (i / (chunksAcross * W)) / (scalar * W);
+		}
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < count; i++) {
+			moduleValues[i] = finalTerrain.GetValue(xs[i], ys[i], zs[i]);
+		}
+		auto midTime = std::chrono::high_resolution_clock::now();
+		terrainProgram.GetValues(xs.data(), ys.data(), zs.data(), programValues.data(), count);
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		int mismatches = 0;
+		for (int i = 0; i < count; i++) {
+			mismatches += moduleValues[i] != programValues[i];
+		}
+
+		double moduleSeconds = std::chrono::duration<double>(midTime - startTime).count();
+		double programSeconds = std::chrono::duration<double>(endTime - midTime).count();
+		printf("module tree benchmark: %d points, %d instructions\n", count, terrainProgram.GetInstructionCount());
+		printf("  GetValue:        %10.1f chunks/s\n", chunksAcross * chunksAcross / moduleSeconds);
+		printf("  compiled program:%10.1f chunks/s  (%.2fx)\n", chunksAcross * chunksAcross / programSeconds, moduleSeconds / programSeconds);
+		printf("  mismatched values: %d\n", mismatches);
+
+		return mismatches + CheckProgramOps();
+	}
+
+	// builds a small tree for each kind of instruction NoiseProgram has and checks the program gives exactly what
+	// GetValue does. the points go either side of 0 and far enough out that the noise has to wrap its coordinates.
+	// returns how many values came out different over all the trees
+	int CheckProgramOps() {
+		static const double COORDS[] = { -40000000.5, -65536.1, -513.5, -17.25, -1.0, -0.001, 0.0, 0.4, 1.0, 3.75, 255.9, 2000000.25, 40000000.5 };
+		const int N = sizeof(COORDS) / sizeof(COORDS[0]);
+
+		std::vector<double> xs, ys, zs;
+		for (int i = 0; i < N; i++) {
+			for (int j = 0; j < N; j++) {
+				for (int k = 0; k < N; k++) {
+					xs.push_back(COORDS[i]);
+					ys.push_back(COORDS[j]);
+					zs.push_back(COORDS[k]);
+				}
+			}
+		}
+		std::vector<double> values(xs.size());
+
+		int trees = 0;
+		int failed = 0;
+		int mismatched = 0;
+		auto check = [&](const char* name, const module::Module& root) {
+			NoiseProgram program(root);
+			program.GetValues(xs.data(), ys.data(), zs.data(), values.data(), (int)values.size());
+
+			int mismatches = 0;
+			for (size_t i = 0; i < values.size(); i++) {
+				double expected = root.GetValue(xs[i], ys[i], zs[i]);
+				bool bothNaN = values[i] != values[i] && expected != expected;
+				mismatches += values[i] != expected && !bothNaN;
+			}
+
+			trees++;
+			if (mismatches > 0) {
+				failed++;
+				mismatched += mismatches;
+				printf("  %s: %d of %d values mismatched\n", name, mismatches, (int)values.size());
+			}
+		};
+
+		// generators, each with its own seed and quality
+		module::Perlin perlin;
+		perlin.SetSeed(-7);
+		perlin.SetNoiseQuality(noise::QUALITY_FAST);
+		check("Perlin, fast", perlin);
+
+		module::Perlin perlinBest;
+		perlinBest.SetSeed(123456);
+		perlinBest.SetNoiseQuality(noise::QUALITY_BEST);
+		perlinBest.SetFrequency(0.37);
+		perlinBest.SetLacunarity(2.5);
+		perlinBest.SetPersistence(0.6);
+		perlinBest.SetOctaveCount(3);
+		check("Perlin, best", perlinBest);
+
+		module::Billow billow;
+		billow.SetSeed(99);
+		billow.SetNoiseQuality(noise::QUALITY_FAST);
+		billow.SetOctaveCount(4);
+		check("Billow, fast", billow);
+
+		module::RidgedMulti ridged;
+		ridged.SetSeed(-31337);
+		ridged.SetNoiseQuality(noise::QUALITY_BEST);
+		ridged.SetFrequency(0.8);
+		ridged.SetLacunarity(1.9);
+		ridged.SetOctaveCount(4);
+		check("RidgedMulti, best", ridged);
+
+		module::Const constant;
+		constant.SetConstValue(0.3125);
+		check("Const", constant);
+
+		// one source
+		module::Abs abs;
+		abs.SetSourceModule(0, perlinBest);
+		check("Abs", abs);
+
+		module::Invert invert;
+		invert.SetSourceModule(0, ridged);
+		check("Invert", invert);
+
+		module::ScaleBias scaleBias;
+		scaleBias.SetSourceModule(0, perlin);
+		scaleBias.SetScale(1.5);
+		scaleBias.SetBias(-0.25);
+		check("ScaleBias", scaleBias);
+
+		module::Clamp clamp;
+		clamp.SetSourceModule(0, perlinBest);
+		clamp.SetBounds(-0.4, 0.35);
+		check("Clamp", clamp);
+
+		module::Exponent exponent;
+		exponent.SetSourceModule(0, billow);
+		exponent.SetExponent(1.7);
+		check("Exponent", exponent);
+
+		// two or three sources
+		module::Add add;
+		add.SetSourceModule(0, perlin);
+		add.SetSourceModule(1, ridged);
+		check("Add", add);
+
+		module::Multiply multiply;
+		multiply.SetSourceModule(0, perlinBest);
+		multiply.SetSourceModule(1, billow);
+		check("Multiply", multiply);
+
+		module::Max max;
+		max.SetSourceModule(0, perlin);
+		max.SetSourceModule(1, billow);
+		check("Max", max);
+
+		module::Min min;
+		min.SetSourceModule(0, perlin);
+		min.SetSourceModule(1, billow);
+		check("Min", min);
+
+		module::Power power;
+		power.SetSourceModule(0, abs);
+		power.SetSourceModule(1, billow);
+		check("Power", power);
+
+		module::Blend blend;
+		blend.SetSourceModule(0, perlin);
+		blend.SetSourceModule(1, ridged);
+		blend.SetSourceModule(2, billow);
+		check("Blend", blend);
+
+		module::Select select;
+		select.SetSourceModule(0, perlin);
+		select.SetSourceModule(1, ridged);
+		select.SetControlModule(perlinBest);
+		select.SetBounds(-0.2, 0.3);
+		select.SetEdgeFalloff(0.125);
+		check("Select", select);
+
+		module::Select hardSelect;
+		hardSelect.SetSourceModule(0, perlin);
+		hardSelect.SetSourceModule(1, constant);
+		hardSelect.SetControlModule(billow);
+		hardSelect.SetBounds(-0.5, 0.1);
+		check("Select, no falloff", hardSelect);
+
+		// the cache is read twice, so the second read comes out of it
+		module::Cache cache;
+		cache.SetSourceModule(0, perlinBest);
+		module::Add addCached;
+		addCached.SetSourceModule(0, cache);
+		addCached.SetSourceModule(1, cache);
+		check("Cache", addCached);
+
+		// moving the point
+		module::ScalePoint scalePoint;
+		scalePoint.SetSourceModule(0, perlin);
+		scalePoint.SetScale(0.5, 2.0, -3.0);
+		check("ScalePoint", scalePoint);
+
+		module::TranslatePoint translatePoint;
+		translatePoint.SetSourceModule(0, ridged);
+		translatePoint.SetTranslation(-100.5, 7.25, 100000.0);
+		check("TranslatePoint", translatePoint);
+
+		module::Displace displace;
+		displace.SetSourceModule(0, perlinBest);
+		displace.SetDisplaceModules(billow, ridged, perlin);
+		check("Displace", displace);
+
+		module::Turbulence turbulence;
+		turbulence.SetSourceModule(0, billow);
+		turbulence.SetSeed(5);
+		turbulence.SetFrequency(3.0);
+		turbulence.SetPower(0.5);
+		turbulence.SetRoughness(4);
+		check("Turbulence", turbulence);
+
+		// a module the program doesn't know, inside one it does, on moved points
+		module::Voronoi voronoi;
+		voronoi.SetSeed(11);
+		voronoi.EnableDistance(true);
+		module::Add addVoronoi;
+		addVoronoi.SetSourceModule(0, voronoi);
+		addVoronoi.SetSourceModule(1, perlin);
+		module::TranslatePoint movedVoronoi;
+		movedVoronoi.SetSourceModule(0, addVoronoi);
+		movedVoronoi.SetTranslation(0.5, -0.25, 3.0);
+		check("Module fallback", movedVoronoi);
+
+		printf("  op checks: %d of %d trees mismatched\n", failed, trees);
+		return mismatched;
+	}
+
 
 private:
+	// the heights and then the biomes of a square of chunks, each tileWidth * tileWidth bytes, row major with x
+	// along a row. the same bytes the tile file keeps
+	struct HeightTile {
+		std::vector<unsigned char> columns;
+		std::list<long long>::iterator use; // where the tile is in tileOrder
+	};
+
+	int appliedSeed = -1;
+	std::unordered_map<long long, HeightTile> tiles;
+	std::list<long long> tileOrder; // most recently used first
+	TerrainTileFile tileFile;
+	bool triedTileFile = false; // only try to open the file once, and carry on without it if that fails
+	bool useTileFile = true; // off while benchmarking, so the passes that should sample the noise do
+	std::vector<float> regionValues;
+	std::vector<Biome> regionBiomes;
+	std::vector<double> densityX, densityY, densityZ; // GetSolid's sample points. x gets the noise written over it
+	int cachedTileChunks = 0; // how many chunks across the cached tiles are
+	bool cachedBiomes = false; // whether the cached tiles have had the biomes applied
+	std::vector<float> biomeScales, biomeBiases;
+	std::vector<double> queryX, queryY, queryZ, queryValues; // GetColumnHeights' sample points
+
+	static long long tileKey(int tileX, int tileZ) {
+		return ((long long)tileX << 32) | (unsigned int)tileZ;
+	}
+
+	// the first of a chunk's columns in the tile it's in, after making sure the tile is cached
+	const unsigned char* tileColumns(int chunkX, int chunkZ) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		int tileChunks = std::max(1, AppGlobals::terrainRegionChunks);
+		int tileX = floorDiv(chunkX, tileChunks);
+		int tileZ = floorDiv(chunkZ, tileChunks);
+		const HeightTile& tile = getTile(tileX, tileZ, tileChunks);
+		return &tile.columns[(chunkZ - tileZ * tileChunks) * W * tileChunks * W + (chunkX - tileX * tileChunks) * W];
+	}
+
+	HeightTile& getTile(int tileX, int tileZ, int tileChunks) {
+		// tiles of a different size don't line up with these ones, and turning biomes on or off changes them
+		if (tileChunks != cachedTileChunks || AppGlobals::biomes != cachedBiomes) {
+			clearTiles();
+			cachedTileChunks = tileChunks;
+			cachedBiomes = AppGlobals::biomes;
+		}
+
+		long long key = tileKey(tileX, tileZ);
+		auto found = tiles.find(key);
+		if (found != tiles.end()) {
+			tileOrder.splice(tileOrder.begin(), tileOrder, found->second.use);
+			stats.memoryHits++;
+			return found->second;
+		}
+
+		while (!tiles.empty() && (int)tiles.size() >= std::max(1, AppGlobals::terrainCacheTiles)) {
+			tiles.erase(tileOrder.back());
+			tileOrder.pop_back();
+		}
+
+		int tileWidth = tileChunks * AppGlobals::CHUNK_WIDTH;
+		int tileSize = tileWidth * tileWidth;
+		HeightTile& tile = tiles[key];
+		tile.columns.resize(tileSize * 2);
+		tileOrder.push_front(key);
+		tile.use = tileOrder.begin();
+
+		if (useTileFile) {
+			openTileFile();
+		}
+		TerrainTileKey fileKey = { AppGlobals::seed, tileX, tileZ, tileChunks, AppGlobals::biomes ? 1 : 0 };
+		bool onDisk = useTileFile && tileFile.IsOpen() && tileFile.GetDataSize() == tileSize * 2;
+		if (onDisk && tileFile.Read(fileKey, tile.columns.data())) {
+			stats.diskHits++;
+			return tile;
+		}
+
+		regionValues.resize(tileSize);
+		regionBiomes.assign(tileSize, Biome::Plains);
+		sampleChunks(tileX * tileChunks, tileZ * tileChunks, tileChunks, regionValues.data());
+		applyBiomes(tileX * tileWidth, tileZ * tileWidth, tileWidth, regionValues.data(), regionBiomes.data());
+		for (int i = 0; i < tileSize; i++) {
+			tile.columns[i] = (unsigned char)toHeight(regionValues[i]);
+			tile.columns[tileSize + i] = static_cast<unsigned char>(regionBiomes[i]);
+		}
+
+		if (onDisk) {
+			tileFile.Write(fileKey, tile.columns.data());
+		}
+		stats.regions++;
+		return tile;
+	}
+
+	void clearTiles() {
+		tiles.clear();
+		tileOrder.clear();
+	}
+
+	// the file gets slots sized for the tiles at the time. tiles of any other size just skip it
+	void openTileFile() {
+		if (triedTileFile || AppGlobals::terrainCacheFile.empty()) {
+			return;
+		}
+
+		triedTileFile = true;
+		int tileWidth = std::max(1, AppGlobals::terrainRegionChunks) * AppGlobals::CHUNK_WIDTH;
+		if (!tileFile.Open(AppGlobals::terrainCacheFile, AppGlobals::terrainCacheFileTiles, tileWidth * tileWidth * 2)) {
+			printf("couldn't open the terrain cache file %s, tiles will only be cached in memory\n", AppGlobals::terrainCacheFile.c_str());
+		}
+	}
+
+	// samples the noise for a square of chunksAcross by chunksAcross chunks into values, row major with x along
+	// a row. each chunk steps from its own bounds the way NoiseMapBuilderPlane would for that chunk alone, so
+	// a column gets the same value whichever square it was sampled in.
+	void sampleChunks(int lowChunkX, int lowChunkZ, int chunksAcross, float* values) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		int width = chunksAcross * W;
+		std::vector<double> xs(width);
+		std::vector<double> zs(width);
+
+		columnCoords(lowChunkX, chunksAcross, xs.data());
+		columnCoords(lowChunkZ, chunksAcross, zs.data());
+
+		if (AppGlobals::builtInNoise) {
+			program.FillGrid(xs.data(), width, zs.data(), width, values);
+		}
+		else {
+			for (int z = 0; z < width; z++) {
+				for (int x = 0; x < width; x++) {
+					values[z * width + x] = (float)myModule.GetValue(xs[x], 0, zs[z]);
+				}
+			}
+		}
+	}
+
+	// reshapes the noise for a square of columns starting at block lowX, lowZ by the biomes they're in, before
+	// it turns into heights, and writes which biome each column is in to biomes
+	void applyBiomes(int lowX, int lowZ, int width, float* values, Biome* biomes) {
+		if (!AppGlobals::biomes) {
+			return;
+		}
+
+		biomeScales.resize(width * width);
+		biomeBiases.resize(width * width);
+		biomeMap.GetColumns(lowX, lowZ, width, width, biomeScales.data(), biomeBiases.data(), biomes);
+		for (int i = 0; i < width * width; i++) {
+			values[i] = values[i] * biomeScales[i] + biomeBiases[i];
+		}
+	}
+
+	// the 3d noise at the points in densityX, densityY and densityZ, written over densityX
+	void sampleDensityNoise(double* out) {
+		int count = (int)densityX.size();
+		if (AppGlobals::builtInNoise) {
+			densityProgram.GetValues(densityX.data(), densityY.data(), densityZ.data(), out, count);
+		}
+		else {
+			for (int i = 0; i < count; i++) {
+				out[i] = densityModule.GetValue(densityX[i], densityY[i], densityZ[i]);
+			}
+		}
+	}
+
+	// above 0 is solid. the noise can push the ground up into overhangs or eat caves out of it
+	static double density(int height, int y, double noise) {
+		return (double)(height - y) / DENSITY_SQUASH + noise;
+	}
+
+	// same bounds and the same running sums as NoiseMapBuilderPlane so the sample points match to the bit
+	static void columnCoords(int lowChunk, int chunksAcross, double* coords) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		double scalar = static_cast<double>(25.0000000000);
+
+		for (int chunk = 0; chunk < chunksAcross; chunk++) {
+			double lowBound = (lowChunk + chunk) / scalar;
+			double delta = ((lowChunk + chunk + 1) / scalar - lowBound) / (double)W;
+			double cur = lowBound;
+			for (int i = 0; i < W; i++) {
+				coords[chunk * W + i] = cur;
+				cur += delta;
+			}
+		}
+	}
+
+	// the noise coord of one column, stepped to with the same running sum columnCoords uses for its chunk
+	static double columnCoord(int block) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		double scalar = static_cast<double>(25.0000000000);
+		int chunk = floorDiv(block, W);
+
+		double lowBound = chunk / scalar;
+		double delta = ((chunk + 1) / scalar - lowBound) / (double)W;
+		double cur = lowBound;
+		for (int i = 0; i < block - chunk * W; i++) {
+			cur += delta;
+		}
+		return cur;
+	}
+
+	// the modules only get told when the seed changes. main picks a seed with resolveSeed before anything is
+	// generated, so this only ever reads it.
+	void applySeed() {
+		if (appliedSeed != AppGlobals::seed) {
+			myModule.SetSeed(AppGlobals::seed);
+			program.Compile(myModule);
+			densityModule.SetSeed(AppGlobals::seed + 1);
+			densityModule.SetOctaveCount(4);
+			densityProgram.Compile(densityModule);
+			biomeMap.SetSeed(AppGlobals::seed);
+			appliedSeed = AppGlobals::seed;
+			clearTiles();
+		}
+	}
+
+	// does everything the grayscale gradient, RendererImage and normalize do to a noise value in one go,
+	// including where they truncate, so a column comes out at exactly the same height.
+	static int toHeight(float value) {
+		unsigned char red;
+		if (value < -1.f) {
+			red = 0;
+		}
+		else if (value >= 1.f) {
+			red = 255;
+		}
+		else {
+			float alpha = (float)((value - -1.0) / (1.0 - -1.0));
+			red = (unsigned char)(((1.0f * alpha) + (0.0f * (1.0f - alpha))) * 255.0f);
+		}
+		red = (unsigned char)((unsigned int)(((double)red / 255.0) * 255.0) & 0xff);
+
+		float slope = 1 * (127 - 0) / (255.f - 0.f);
+		return (unsigned char)(0 + floorf((slope * (red - 0.f)) + 0.5f));
+	}
+
 	// converts the map's range of 0 to 255 into an acceptable range
 	void normalize(utils::Image& img) {
 		for (int x = 0; x < img.GetWidth(); x++) {
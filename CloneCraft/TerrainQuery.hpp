@@ -0,0 +1,217 @@
+#ifndef TERRAIN_QUERY_HPP
+#define TERRAIN_QUERY_HPP
+
+
+#include "Chunk.hpp"
+#include "TerrainGenerator.hpp"
+#include "Caves.hpp"
+#include "ChunkGenerator.hpp"
+#include <unordered_map>
+#include <vector>
+
+struct TerrainQueryStats {
+	unsigned long long loaded = 0; // answered from a generated chunk
+	unsigned long long generated = 0; // worked out from the generator
+};
+
+// Ground heights and blocks anywhere in the world, loaded or not, for things that need to look past the loaded
+// chunks: long raycasts, line of sight, picking spawn points. Inside a generated chunk the answer comes from the
+// chunk, edits and all. Anywhere else it's worked out from the generator for just the columns asked about and
+// never by making a chunk, so it costs the same however far away the point is.
+//
+// Outside the loaded chunks the answer is the terrain as it's filled in and carved, before decorations. Trees,
+// boulders and ores depend on whole chunks, so they aren't there.
+class TerrainQuery {
+public:
+	TerrainQueryStats stats;
+
+	TerrainQuery(std::unordered_map<Vec4, Chunk>& chunkMap, TerrainGenerator& generator, CaveCarver& caves) : chunkMap(chunkMap), generator(generator), caves(caves) {}
+
+	// y of the first block above the highest block that isn't air in column x, z. 0 if the column is empty
+	int GetGroundHeight(int x, int z) {
+		int height;
+		GetGroundHeights(&x, &z, 1, &height);
+		return height;
+	}
+
+	// the same for count columns at xs[i], zs[i]. the columns that aren't loaded go to the generator in one batch
+	void GetGroundHeights(const int* xs, const int* zs, int count, int* heights) {
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		int bedrockTop = ChunkGenerator::bedrockHeight();
+		prepareCaves();
+
+		unloaded.clear();
+		for (int i = 0; i < count; i++) {
+			Chunk* chunk = generatedChunk(xs[i], zs[i]);
+			if (chunk) {
+				heights[i] = chunk->columnTop[localCoord(xs[i])][localCoord(zs[i])];
+				stats.loaded++;
+			}
+			else {
+				unloaded.push_back(i);
+			}
+		}
+		if (unloaded.empty()) {
+			return;
+		}
+		stats.generated += unloaded.size();
+
+		if (AppGlobals::densityTerrain) {
+			unsigned char column[AppGlobals::CHUNK_HEIGHT];
+			for (int i : unloaded) {
+				generator.GetSolidColumn(xs[i], zs[i], column);
+				getColumnSegments(xs[i], zs[i]);
+				int top = H;
+				while (top > bedrockTop && (!column[top - 1] || isCarved(xs[i], top - 1, zs[i], bedrockTop))) {
+					top--;
+				}
+				heights[i] = top;
+			}
+			return;
+		}
+
+		unloadedX.resize(unloaded.size());
+		unloadedZ.resize(unloaded.size());
+		unloadedHeights.resize(unloaded.size());
+		for (size_t i = 0; i < unloaded.size(); i++) {
+			unloadedX[i] = xs[unloaded[i]];
+			unloadedZ[i] = zs[unloaded[i]];
+		}
+		generator.GetColumnHeights(unloadedX.data(), unloadedZ.data(), (int)unloaded.size(), unloadedHeights.data());
+
+		for (size_t i = 0; i < unloaded.size(); i++) {
+			int top = std::max(std::min(unloadedHeights[i] + 1, H), bedrockTop);
+			getColumnSegments(unloadedX[i], unloadedZ[i]);
+			while (top > bedrockTop && isCarved(unloadedX[i], top - 1, unloadedZ[i], bedrockTop)) {
+				top--;
+			}
+			heights[unloaded[i]] = top;
+		}
+	}
+
+	// the block at world coords x, y, z
+	BlockId GetBlock(int x, int y, int z) {
+		BlockId id;
+		GetBlocks(&x, &y, &z, 1, &id);
+		return id;
+	}
+
+	// the same for count blocks at xs[i], ys[i], zs[i]. blocks in the same column one after another only work
+	// the column out once
+	void GetBlocks(const int* xs, const int* ys, const int* zs, int count, BlockId* ids) {
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		int bedrockTop = ChunkGenerator::bedrockHeight();
+		prepareCaves();
+
+		unsigned char column[AppGlobals::CHUNK_HEIGHT];
+		int columnHeight = 0;
+		Biome columnBiome = Biome::Plains;
+		bool haveColumn = false;
+		int columnX = 0, columnZ = 0;
+
+		for (int i = 0; i < count; i++) {
+			int x = xs[i], y = ys[i], z = zs[i];
+			if (y < 0 || y >= H) {
+				ids[i] = BlockId::Air;
+				continue;
+			}
+
+			Chunk* chunk = generatedChunk(x, z);
+			if (chunk) {
+				ids[i] = chunk->getBlock(localCoord(x), y, localCoord(z));
+				stats.loaded++;
+				continue;
+			}
+			stats.generated++;
+
+			if (y < bedrockTop) {
+				ids[i] = BlockId::Bedrock;
+				continue;
+			}
+
+			if (!haveColumn || x != columnX || z != columnZ) {
+				if (AppGlobals::densityTerrain) {
+					generator.GetSolidColumn(x, z, column);
+				}
+				else {
+					columnHeight = generator.GetColumnHeight(x, z);
+				}
+				columnBiome = generator.GetColumnBiome(x, z);
+				getColumnSegments(x, z);
+				haveColumn = true;
+				columnX = x;
+				columnZ = z;
+			}
+
+			// where the top of the solid run the block is in would be, before any caves
+			int runTop;
+			if (AppGlobals::densityTerrain) {
+				if (!column[y]) {
+					ids[i] = BlockId::Air;
+					continue;
+				}
+				runTop = y + 1;
+				while (runTop < H && column[runTop]) {
+					runTop++;
+				}
+			}
+			else {
+				runTop = std::min(columnHeight + 1, H);
+				if (y >= runTop) {
+					ids[i] = BlockId::Air;
+					continue;
+				}
+			}
+
+			if (isCarved(x, y, z, bedrockTop)) {
+				ids[i] = BlockId::Air;
+				continue;
+			}
+
+			// the same layers ChunkGenerator::fillRun puts in
+			const BiomeInfo& info = BIOMES[static_cast<int>(columnBiome)];
+			ids[i] = y == runTop - 1 ? info.surface : y >= runTop - 1 - AppGlobals::dirtDepth ? info.filler : BlockId::Stone;
+		}
+	}
+
+private:
+	std::unordered_map<Vec4, Chunk>& chunkMap;
+	TerrainGenerator& generator;
+	CaveCarver& caves;
+	std::vector<int> unloaded; // indices of the columns that aren't in a generated chunk
+	std::vector<int> unloadedX, unloadedZ, unloadedHeights;
+	std::vector<CaveSegment> columnSegments; // the cave segments that reach the column being looked at
+
+	// only chunks that have been generated. a chunk that's in the map but not filled in yet doesn't count
+	Chunk* generatedChunk(int x, int z) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		auto found = chunkMap.find(Vec4((float)floorDiv(x, W), 0.f, (float)floorDiv(z, W), 0.f));
+		if (found == chunkMap.end() || !found->second.isGenerated) {
+			return nullptr;
+		}
+		return &found->second;
+	}
+
+	static int localCoord(int block) {
+		return block - floorDiv(block, AppGlobals::CHUNK_WIDTH) * AppGlobals::CHUNK_WIDTH;
+	}
+
+	void prepareCaves() {
+		if (AppGlobals::caves) {
+			caves.SetSeed(AppGlobals::seed);
+		}
+	}
+
+	void getColumnSegments(int x, int z) {
+		columnSegments.clear();
+		if (AppGlobals::caves) {
+			caves.GetColumnSegments(x, z, columnSegments);
+		}
+	}
+
+	// for a block in the column getColumnSegments was last called for
+	bool isCarved(int x, int y, int z, int bedrockTop) {
+		return CaveCarver::IsCarved(columnSegments, x, y, z, bedrockTop);
+	}
+};
+#endif // TERRAIN_QUERY_HPP
@@ -5,6 +5,7 @@ struct UniformBufferObject {
 	alignas(16) Mat4 model;
 	alignas(16) Mat4 view;
 	alignas(16) Mat4 proj;
+	alignas(16) Vec4 sky; // x: sky light multiplier for the time of day. 0 - 1
 };
 
 #endif // UNIFORM_BUFFER_OBJECT_HPP
\ No newline at end of file
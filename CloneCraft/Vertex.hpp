@@ -8,6 +8,7 @@ struct Vertex
 {
 	Vec4 pos = { 0.f, 0.f, 0.f, 0.f }; // size 16 bytes
 	Vec4 texCoord = { 0.f, 0.f, 0.f, 0.f }; // size 16 bytes
+	Vec4 light = { 0.f, 0.f, 0.f, 0.f }; // size 16 bytes. x: sky light, y: block light, z: ambient occlusion. all 0 - 1
 
 	static VkVertexInputBindingDescription getBindingDescription()
 	{
@@ -19,9 +20,9 @@ struct Vertex
 		return bindingDescription;
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions()
+	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
 	{
-		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
 
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0;
@@ -33,13 +34,19 @@ struct Vertex
 		attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
 		attributeDescriptions[1].offset = offsetof(Vertex, texCoord);
 
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[2].offset = offsetof(Vertex, light);
+
 		return attributeDescriptions;
 	}
 
 	bool operator==(const Vertex& other) const
 	{
 		return (pos == other.pos &&
-				texCoord == other.texCoord);
+				texCoord == other.texCoord &&
+				light == other.light);
 	}
 
 	bool operator!=(const Vertex& other) const
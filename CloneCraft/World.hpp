@@ -4,11 +4,40 @@
 
 #include "Chunk.hpp"
 #include "Camera.hpp"
-#include "TerrainGenerator.hpp"
+#include "ChunkGenerator.hpp"
+#include "Lighting.hpp"
+#include "Ray.hpp"
+#include "TerrainQuery.hpp"
+#include "WorldSave.hpp"
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <climits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WORLD_RAYCAST_AVX2
+#endif
+
+#define FRUSTUM_CULLING_ENABLED // only draw the chunks, and the sections of them, that the camera can see
+
+// a run of the index buffer to draw in one go
+struct IndexRange {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
 
-//#define FRUSTUM_CULLING_ENABLED // currently broken? 
+// how much of what's loaded made it through frustum culling last frame. sections only count if they have a mesh
+struct CullStats {
+	unsigned int chunks = 0;
+	unsigned int chunksDrawn = 0;
+	unsigned int sections = 0;
+	unsigned int sectionsDrawn = 0;
+	unsigned int draws = 0;
+};
 
 class World {
 public:
@@ -42,12 +71,15 @@ public:
 		}
 	}
 
+	// floors instead of truncating so that negative coords land in the right chunk
 	static Vec4 getBlockXZ(Vec4 worldCoords) {
-		return Vec4((int)worldCoords.x % AppGlobals::CHUNK_WIDTH, (int)worldCoords.y, (int)worldCoords.z % AppGlobals::CHUNK_WIDTH, (int)worldCoords.w);
+		int x = (int)floorf(worldCoords.x);
+		int z = (int)floorf(worldCoords.z);
+		return Vec4(x - floorDiv(x, AppGlobals::CHUNK_WIDTH) * AppGlobals::CHUNK_WIDTH, (int)floorf(worldCoords.y), z - floorDiv(z, AppGlobals::CHUNK_WIDTH) * AppGlobals::CHUNK_WIDTH, 0);
 	}
 
 	static Vec4 getChunkXZ(Vec4 worldCoords) {
-		return Vec4((int)worldCoords.x / AppGlobals::CHUNK_WIDTH, 0, (int)worldCoords.z / AppGlobals::CHUNK_WIDTH, (int)worldCoords.w);
+		return Vec4(floorDiv((int)floorf(worldCoords.x), AppGlobals::CHUNK_WIDTH), 0, floorDiv((int)floorf(worldCoords.z), AppGlobals::CHUNK_WIDTH), 0);
 	}
 
 	BlockId getBlock(Vec4 blockPos) {
@@ -60,8 +92,19 @@ public:
 	bool setBlock(BlockId id, Vec4 blockPos) {
 		auto blockPosition = getBlockXZ(blockPos);
 		auto chunkPosition = getChunkXZ(blockPos);
-
-		if (getChunk(chunkPosition)->SetBlock(id, blockPosition)) {
+		auto chunk = getChunk(chunkPosition);
+		auto oldId = chunk->getBlock(blockPosition);
+
+		if (chunk->SetBlock(id, blockPosition)) {
+			if (chunk->isGenerated && oldId != id) {
+				int x = (int)floorf(blockPos.x);
+				int y = (int)blockPosition.y;
+				int z = (int)floorf(blockPos.z);
+				lightEngine.updateBlock(x, y, z, oldId, id);
+
+				// blocks on the edge of a chunk show or hide faces in the chunk next door
+				markNeighbourDirtyIfOnEdge(chunkPosition, blockPosition);
+			}
 			return true;
 		}
 
@@ -80,14 +123,53 @@ public:
 	void initChunk(Vec4 chunkPos) {
 		auto chunk = getChunk(chunkPos);
 
-		// generate the terrain image
-		auto image = terrainGenerator.GetTerrain(chunkPos.x, chunkPos.z);
+		// a chunk that was generated ahead of time comes out of the save just as the generator would make it
+		if (!worldSave.IsOpen() || !worldSave.Load(*chunk, decorationBlocks)) {
+			chunkGenerator.Generate(*chunk, decorationBlocks);
+		}
+
+		// trees and boulders can reach into the chunks around this one. what lands in here went in with the
+		// rest of the chunk, and whatever neighbours generated earlier left for it goes in below. the rest waits
+		// for its chunk, or goes straight in below if that chunk is already generated.
+		// a chunk generated again while its neighbours kept its blocks already handed them out the first time
+		bool firstDecoration = outgoingBlocks.emplace(chunkPos, decorationBlocks).second;
+		neighbourDecorationBlocks.clear();
+		if (firstDecoration) {
+			for (auto& block : decorationBlocks) {
+				Chunk* neighbour = findChunk(getChunkXZ(Vec4((float)block.x, (float)block.y, (float)block.z, 0.f)));
+				if (neighbour && neighbour->isGenerated) {
+					neighbourDecorationBlocks.push_back(block);
+				}
+			}
+		}
+
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				if (dx == 0 && dz == 0) {
+					continue;
+				}
+
+				auto outgoing = outgoingBlocks.find(Vec4(chunkPos.x + dx, 0.f, chunkPos.z + dz, 0.f));
+				if (outgoing == outgoingBlocks.end()) {
+					continue;
+				}
+				for (auto& block : outgoing->second) {
+					if (getChunkXZ(Vec4((float)block.x, (float)block.y, (float)block.z, 0.f)) == chunkPos) {
+						ChunkGenerator::mergeDecorationBlock(*chunk, block);
+					}
+				}
+			}
+		}
+		chunk->isGenerated = true;
+
+		// light the new chunk. this also lets light flow across the border into generated neighbours
+		lightEngine.initChunk(*chunk);
 
-		// sample the image at x and z coords to get y coord
-		for (int x = 0; x < AppGlobals::CHUNK_WIDTH; x++) {
-			for (int z = 0; z < AppGlobals::CHUNK_WIDTH; z++) {
-				int y = image->GetValue(x, z).red;
-				chunk->SetBlock(BlockId::Grass, Vec4(x, y, z, 0));
+		// generated neighbours get their blocks through setBlock so their light is fixed up too
+		for (auto& block : neighbourDecorationBlocks) {
+			Vec4 blockPos((float)block.x, (float)block.y, (float)block.z, 0.f);
+			if (outranks(block.id, getBlock(blockPos))) {
+				setBlock(block.id, blockPos);
 			}
 		}
 
@@ -103,15 +185,472 @@ public:
 		//}
 
 		generateVerticesAndIndices(chunkPos);
+
+		// the neighbours' border faces and corner shading were built without knowing what was in this chunk
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				Chunk* neighbour = findChunk(Vec4(chunkPos.x + dx, 0.f, chunkPos.z + dz, 0.f));
+				if (neighbour && neighbour != chunk && neighbour->isGenerated) {
+					neighbour->meshDirty = true;
+				}
+			}
+		}
+		remeshDirtyNeighbours(chunkPos);
 	}
 
 	void updateChunk(Vec4 chunkPos) {
 		generateVerticesAndIndices(chunkPos);
+		remeshDirtyNeighbours(chunkPos);
 		forceVertexUpdate = true;
 	}
 
+	// broad phase for collision and picking. false means there's definitely nothing but air in the box, so the
+	// caller can skip looking at blocks one at a time.
+	bool mayHaveBlocksIn(const AABB& box) {
+		int lowX = floorDiv((int)floorf(box.position.x), AppGlobals::CHUNK_WIDTH);
+		int lowZ = floorDiv((int)floorf(box.position.z), AppGlobals::CHUNK_WIDTH);
+		int highX = floorDiv((int)floorf(box.position.x + box.dimensions.x), AppGlobals::CHUNK_WIDTH);
+		int highZ = floorDiv((int)floorf(box.position.z + box.dimensions.z), AppGlobals::CHUNK_WIDTH);
+
+		for (int x = lowX; x <= highX; x++) {
+			for (int z = lowZ; z <= highZ; z++) {
+				Chunk* chunk = findChunk(Vec4((float)x, 0.f, (float)z, 0.f));
+				if (chunk && box.Intersects(chunk->getBounds())) {
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	// the chunk at chunkPos if it's loaded and generated, and null otherwise. never creates one
+	Chunk* findGeneratedChunk(Vec4 chunkPos) {
+		Chunk* chunk = findChunk(chunkPos);
+		return chunk && chunk->isGenerated ? chunk : nullptr;
+	}
+
+	// the first block that isn't air along the ray from origin, up to maxDistance away. steps from block to block in
+	// the order the ray crosses their faces, so every block it goes through is looked at once and no others. chunks
+	// that aren't generated, and layers with nothing in them, count as air without reading their blocks.
+	bool raycast(const Vec4& origin, const Vec4& direction, float maxDistance, RaycastHit& hit) {
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		float o[3] = { origin.x, origin.y, origin.z };
+		float d[3] = { direction.x, direction.y, direction.z };
+		int cell[3], step[3];
+		float tNext[3], tDelta[3];
+		rayStart(o, d, cell, step, tNext, tDelta);
+
+		RayChunk last;
+		int normalAxis = -1;
+		float t = 0.f;
+		for (;;) {
+			// nothing above or below the world, so stop once the ray leaves it for good
+			if ((cell[1] < 0 && step[1] <= 0) || (cell[1] >= H && step[1] >= 0)) {
+				return false;
+			}
+
+			BlockId id = cell[1] >= 0 && cell[1] < H ? rayBlock(cell[0], cell[1], cell[2], last) : BlockId::Air;
+			if (id != BlockId::Air) {
+				setRayHit(hit, cell, normalAxis >= 0 ? -step[normalAxis] : 0, normalAxis, t, id);
+				return true;
+			}
+
+			normalAxis = tNext[0] <= tNext[1] ? (tNext[0] <= tNext[2] ? 0 : 2) : (tNext[1] <= tNext[2] ? 1 : 2);
+			t = tNext[normalAxis];
+			if (t > maxDistance) {
+				return false;
+			}
+			cell[normalAxis] += step[normalAxis];
+			tNext[normalAxis] += tDelta[normalAxis];
+		}
+	}
+
+	// raycast for every ray in the batch, with the same answers. hits[i] is for ray i, and its id is air if the ray
+	// didn't hit anything. returns how many did. with avx2 eight rays step through the grid together: every lane
+	// picks the face it crosses next and moves on at once, and only looking up the blocks is done a lane at a time,
+	// each lane keeping the chunk it's in
+	int raycastBatch(const RayBatch& rays, std::vector<RaycastHit>& hits) {
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		int count = (int)rays.Size();
+		hits.assign(count, RaycastHit());
+		int hitCount = 0;
+
+		#if defined(WORLD_RAYCAST_AVX2)
+		static_assert(AppGlobals::CHUNK_WIDTH == 16, "the lanes find their chunk with a shift");
+		static_assert(sizeof(BlockId) == 1, "the lanes step between layers by sizeof(Layer) BlockIds");
+		const int LANES = 8;
+		static const BlockId air = BlockId::Air;
+		alignas(32) int cell[3][LANES] = {};
+		alignas(32) int step[3][LANES] = {};
+		alignas(32) float tNext[3][LANES] = {};
+		alignas(32) float tDelta[3][LANES] = {};
+		alignas(32) float t[LANES] = {};
+		alignas(32) float maxDistance[LANES] = {};
+		alignas(32) int normalAxis[LANES] = {};
+		alignas(32) int offset[LANES] = {};
+
+		// the chunk each lane is in, and where its blocks start. air for a chunk that isn't generated, which the
+		// offset is cleared for
+		alignas(32) int laneChunk[2][LANES];
+		alignas(32) int laneHasChunk[LANES] = {};
+		const BlockId* laneBlocks[LANES];
+		for (int lane = 0; lane < LANES; lane++) {
+			laneChunk[0][lane] = laneChunk[1][lane] = INT_MIN;
+			laneBlocks[lane] = &air;
+		}
+		int rayIndex[LANES] = {};
+
+		// the chunks the lanes were in lately, by the low bits of their position, so a lane crossing into a
+		// chunk another lane was just in doesn't go through the chunk map
+		const int RECENT_CHUNKS = 64;
+		struct RecentChunk {
+			int x = INT_MIN;
+			int z = INT_MIN;
+			Chunk* chunk = nullptr;
+		} recent[RECENT_CHUNKS];
+
+		// a lane takes the next ray as soon as its last one is done, so every lane has a ray until they run out
+		int nextRay = 0;
+		auto startRay = [&](int lane) {
+			int i = nextRay++;
+			float o[3] = { rays.originX[i], rays.originY[i], rays.originZ[i] };
+			float d[3] = { rays.directionX[i], rays.directionY[i], rays.directionZ[i] };
+			int laneCell[3], laneStep[3];
+			float laneNext[3], laneDelta[3];
+			rayStart(o, d, laneCell, laneStep, laneNext, laneDelta);
+			for (int axis = 0; axis < 3; axis++) {
+				cell[axis][lane] = laneCell[axis];
+				step[axis][lane] = laneStep[axis];
+				tNext[axis][lane] = laneNext[axis];
+				tDelta[axis][lane] = laneDelta[axis];
+			}
+			t[lane] = 0.f;
+			maxDistance[lane] = rays.maxDistance[i];
+			normalAxis[lane] = -1;
+			rayIndex[lane] = i;
+		};
+
+		int active = 0;
+		for (int lane = 0; lane < LANES && nextRay < count; lane++) {
+			startRay(lane);
+			active |= 1 << lane;
+		}
+
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i height = _mm256_set1_epi32(H);
+		while (active) {
+			__m256i cellX = _mm256_load_si256((__m256i*)cell[0]);
+			__m256i cellY = _mm256_load_si256((__m256i*)cell[1]);
+			__m256i cellZ = _mm256_load_si256((__m256i*)cell[2]);
+			__m256i stepY = _mm256_load_si256((__m256i*)step[1]);
+
+			// nothing above or below the world, so a lane stops once its ray leaves it for good
+			__m256i below = _mm256_cmpgt_epi32(zero, cellY);
+			__m256i above = _mm256_cmpgt_epi32(cellY, _mm256_sub_epi32(height, _mm256_set1_epi32(1)));
+			__m256i leaving = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpgt_epi32(stepY, zero), below), _mm256_andnot_si256(_mm256_cmpgt_epi32(zero, stepY), above));
+			int done = active & _mm256_movemask_ps(_mm256_castsi256_ps(leaving));
+			__m256i inWorld = _mm256_andnot_si256(_mm256_or_si256(below, above), _mm256_set1_epi32(-1));
+
+			// only the lanes that crossed into another chunk go looking for it
+			__m256i chunkX = _mm256_srai_epi32(cellX, 4);
+			__m256i chunkZ = _mm256_srai_epi32(cellZ, 4);
+			__m256i sameChunk = _mm256_and_si256(_mm256_cmpeq_epi32(chunkX, _mm256_load_si256((__m256i*)laneChunk[0])), _mm256_cmpeq_epi32(chunkZ, _mm256_load_si256((__m256i*)laneChunk[1])));
+			int moved = active & ~_mm256_movemask_ps(_mm256_castsi256_ps(sameChunk));
+			if (moved) {
+				_mm256_store_si256((__m256i*)laneChunk[0], chunkX);
+				_mm256_store_si256((__m256i*)laneChunk[1], chunkZ);
+				for (int lane = 0; lane < LANES; lane++) {
+					if (moved & (1 << lane)) {
+						int x = laneChunk[0][lane];
+						int z = laneChunk[1][lane];
+						RecentChunk& entry = recent[((x & 7) << 3) | (z & 7)];
+						if (entry.x != x || entry.z != z) {
+							entry.x = x;
+							entry.z = z;
+							entry.chunk = findGeneratedChunk(Vec4((float)x, 0.f, (float)z, 0.f));
+						}
+						Chunk* chunk = entry.chunk;
+						laneBlocks[lane] = chunk ? &chunk->layers[0].blocks[0][0] : &air;
+						laneHasChunk[lane] = chunk ? -1 : 0;
+					}
+				}
+			}
+
+			// each lane's block as an offset from its chunk's first block, then all the reads one after another
+			__m256i column = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(cellX, _mm256_set1_epi32(15)), 4), _mm256_and_si256(cellZ, _mm256_set1_epi32(15)));
+			__m256i blockOffset = _mm256_add_epi32(_mm256_mullo_epi32(cellY, _mm256_set1_epi32((int)sizeof(Layer))), column);
+			__m256i readable = _mm256_and_si256(inWorld, _mm256_load_si256((__m256i*)laneHasChunk));
+			_mm256_store_si256((__m256i*)offset, _mm256_and_si256(blockOffset, readable));
+			__m256i blockIds = _mm256_setr_epi32(
+				static_cast<int>(laneBlocks[0][offset[0]]), static_cast<int>(laneBlocks[1][offset[1]]),
+				static_cast<int>(laneBlocks[2][offset[2]]), static_cast<int>(laneBlocks[3][offset[3]]),
+				static_cast<int>(laneBlocks[4][offset[4]]), static_cast<int>(laneBlocks[5][offset[5]]),
+				static_cast<int>(laneBlocks[6][offset[6]]), static_cast<int>(laneBlocks[7][offset[7]]));
+			__m256i solid = _mm256_andnot_si256(_mm256_cmpeq_epi32(blockIds, zero), readable);
+			int hitLanes = active & ~done & _mm256_movemask_ps(_mm256_castsi256_ps(solid));
+			for (int lane = 0; lane < LANES; lane++) {
+				if (hitLanes & (1 << lane)) {
+					int laneCell[3] = { cell[0][lane], cell[1][lane], cell[2][lane] };
+					int axis = normalAxis[lane];
+					setRayHit(hits[rayIndex[lane]], laneCell, axis >= 0 ? -step[axis][lane] : 0, axis, t[lane], laneBlocks[lane][offset[lane]]);
+					hitCount++;
+				}
+			}
+			done |= hitLanes;
+
+			// the same choice of face as raycast, ties going to x then y
+			__m256 nextX = _mm256_load_ps(tNext[0]);
+			__m256 nextY = _mm256_load_ps(tNext[1]);
+			__m256 nextZ = _mm256_load_ps(tNext[2]);
+			__m256 pickX = _mm256_and_ps(_mm256_cmp_ps(nextX, nextY, _CMP_LE_OQ), _mm256_cmp_ps(nextX, nextZ, _CMP_LE_OQ));
+			__m256 pickY = _mm256_andnot_ps(pickX, _mm256_cmp_ps(nextY, nextZ, _CMP_LE_OQ));
+			__m256 pickZ = _mm256_andnot_ps(_mm256_or_ps(pickX, pickY), _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+			__m256 crossing = _mm256_blendv_ps(_mm256_blendv_ps(nextZ, nextY, pickY), nextX, pickX);
+			_mm256_store_ps(t, crossing);
+			done |= active & _mm256_movemask_ps(_mm256_cmp_ps(crossing, _mm256_load_ps(maxDistance), _CMP_GT_OQ));
+
+			__m256 picks[3] = { pickX, pickY, pickZ };
+			__m256i cells[3] = { cellX, cellY, cellZ };
+			__m256i axis = zero;
+			for (int i = 0; i < 3; i++) {
+				__m256i pick = _mm256_castps_si256(picks[i]);
+				_mm256_store_si256((__m256i*)cell[i], _mm256_add_epi32(cells[i], _mm256_and_si256(_mm256_load_si256((__m256i*)step[i]), pick)));
+				_mm256_store_ps(tNext[i], _mm256_add_ps(_mm256_load_ps(tNext[i]), _mm256_and_ps(_mm256_load_ps(tDelta[i]), picks[i])));
+				axis = _mm256_or_si256(axis, _mm256_and_si256(_mm256_set1_epi32(i), pick));
+			}
+			_mm256_store_si256((__m256i*)normalAxis, axis);
+
+			// the lanes that finished start their next ray from its first block
+			for (int lane = 0; done; lane++, done >>= 1) {
+				if (!(done & 1)) {
+					continue;
+				}
+				if (nextRay < count) {
+					startRay(lane);
+				}
+				else {
+					active &= ~(1 << lane);
+				}
+			}
+		}
+		#else
+		for (int i = 0; i < count; i++) {
+			Vec4 origin(rays.originX[i], rays.originY[i], rays.originZ[i], 0.f);
+			Vec4 direction(rays.directionX[i], rays.directionY[i], rays.directionZ[i], 0.f);
+			hitCount += raycast(origin, direction, rays.maxDistance[i], hits[i]);
+		}
+		#endif
+		return hitCount;
+	}
+
+	const TerrainStats& getTerrainStats() { return chunkGenerator.terrain.stats; }
+	const GenerationStats& getGenerationStats() { return chunkGenerator.stats; }
+
+	// loads chunks from AppGlobals::worldFile instead of generating them, if it's set. a save decides the seed
+	// unless one was picked, so this goes before resolveSeed
+	void openWorldFile() {
+		if (AppGlobals::worldFile.empty()) {
+			return;
+		}
+
+		int fileSeed;
+		if (AppGlobals::seed == -1 && WorldSave::ReadSeed(AppGlobals::worldFile, fileSeed)) {
+			AppGlobals::seed = fileSeed;
+		}
+		resolveSeed();
+		if (!worldSave.Open(AppGlobals::worldFile, AppGlobals::seed)) {
+			printf("not loading chunks from %s: it isn't a save of seed %d with these terrain settings\n", AppGlobals::worldFile.c_str(), AppGlobals::seed);
+		}
+	}
+
+	// ground heights and blocks anywhere, without loading chunks for them
+	TerrainQuery& getTerrainQuery() { return terrainQuery; }
+
+	int benchmarkTerrain(int chunksAcross) {
+		int mismatches = chunkGenerator.terrain.Benchmark(chunksAcross);
+		mismatches += benchmarkFill(chunksAcross);
+		chunkGenerator.caves.SetSeed(AppGlobals::seed);
+		mismatches += chunkGenerator.caves.Benchmark(chunksAcross, ChunkGenerator::bedrockHeight());
+		mismatches += benchmarkQuery(chunksAcross);
+		mismatches += RandomStream::Benchmark(1 << 22);
+		return mismatches;
+	}
+
+	// generates a square of chunks in a world of its own, then casts rays from just above the ground in every
+	// direction one at a time and as a batch, and checks both find the same blocks. returns how many hits didn't
+	int benchmarkRaycast(int chunksAcross, int rayCount) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const float RANGE = 32.f;
+		std::unique_ptr<World> scratch(new World());
+		for (int x = 0; x < chunksAcross; x++) {
+			for (int z = 0; z < chunksAcross; z++) {
+				scratch->initChunk(Vec4((float)x, 0.f, (float)z, 0.f));
+			}
+		}
+
+		std::mt19937 random(AppGlobals::seed);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		RayBatch rays;
+		for (int i = 0; i < rayCount; i++) {
+			float x = unit(random) * chunksAcross * W;
+			float z = unit(random) * chunksAcross * W;
+			int blockX = std::min((int)x, chunksAcross * W - 1);
+			int blockZ = std::min((int)z, chunksAcross * W - 1);
+			Chunk* chunk = scratch->findGeneratedChunk(Vec4((float)(blockX / W), 0.f, (float)(blockZ / W), 0.f));
+			float ground = chunk ? chunk->columnTop[blockX % W][blockZ % W] : 0.f;
+
+			// evenly over the sphere
+			float y = unit(random) * 2.f - 1.f;
+			float angle = unit(random) * 2.f * PI;
+			float across = sqrtf(1.f - y * y);
+			rays.Add(Vec4(x, ground + 0.5f + unit(random) * 16.f, z, 0.f), Vec4(across * cosf(angle), y, across * sinf(angle), 0.f), RANGE);
+		}
+
+		std::vector<RaycastHit> single(rayCount);
+		std::vector<RaycastHit> batch;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		int singleHits = 0;
+		for (int i = 0; i < rayCount; i++) {
+			Vec4 origin(rays.originX[i], rays.originY[i], rays.originZ[i], 0.f);
+			Vec4 direction(rays.directionX[i], rays.directionY[i], rays.directionZ[i], 0.f);
+			singleHits += scratch->raycast(origin, direction, rays.maxDistance[i], single[i]);
+		}
+		auto midTime = std::chrono::high_resolution_clock::now();
+		int batchHits = scratch->raycastBatch(rays, batch);
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		int mismatches = 0;
+		for (int i = 0; i < rayCount; i++) {
+			mismatches += single[i].id != batch[i].id || single[i].block != batch[i].block || single[i].normal != batch[i].normal || single[i].distance != batch[i].distance;
+		}
+
+		double singleSeconds = std::chrono::duration<double>(midTime - startTime).count();
+		double batchSeconds = std::chrono::duration<double>(endTime - midTime).count();
+		printf("raycast benchmark: %d rays up to %.0f blocks long over %d chunks, %d hit something\n", rayCount, RANGE, chunksAcross * chunksAcross, singleHits);
+		printf("  one at a time:   %10.2f million rays/s\n", rayCount / singleSeconds / 1e6);
+		#if defined(WORLD_RAYCAST_AVX2)
+		printf("  batched, avx2:   %10.2f million rays/s  (%.2fx)\n", rayCount / batchSeconds / 1e6, singleSeconds / batchSeconds);
+		#else
+		printf("  batched:         %10.2f million rays/s  (%.2fx, no avx2 so one at a time)\n", rayCount / batchSeconds / 1e6, singleSeconds / batchSeconds);
+		#endif
+		mismatches += singleHits != batchHits;
+		printf("  mismatched hits: %d\n", mismatches);
+		return mismatches;
+	}
+
+	// generates a square of chunks in a world of its own, then puts glowstone down on the ground one block at a
+	// time and takes it away again, timing how fast the light engine relights around each edit. after each pass
+	// the block light is checked against flooding it again from scratch. returns how many blocks were lit wrong
+	int benchmarkLight(int chunksAcross, int lights) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		std::unique_ptr<World> scratch(new World());
+		for (int x = 0; x < chunksAcross; x++) {
+			for (int z = 0; z < chunksAcross; z++) {
+				scratch->initChunk(Vec4((float)x, 0.f, (float)z, 0.f));
+			}
+		}
+
+		// close enough together that most of them light the same blocks as others
+		std::mt19937 random(AppGlobals::seed);
+		std::uniform_int_distribution<int> column(0, chunksAcross * W - 1);
+		std::vector<Vec4> positions;
+		for (int i = 0; i < lights; i++) {
+			int x = column(random);
+			int z = column(random);
+			int y = scratch->findGeneratedChunk(Vec4((float)(x / W), 0.f, (float)(z / W), 0.f))->columnTop[x % W][z % W];
+			if (y < AppGlobals::CHUNK_HEIGHT) {
+				positions.push_back(Vec4((float)x, (float)y, (float)z, 0.f));
+			}
+		}
+
+		int mismatches = 0;
+		auto pass = [&](const char* name, BlockId id, size_t first, size_t step) {
+			LightStats before = scratch->getEditLightStats();
+			int edits = 0;
+			for (size_t i = first; i < positions.size(); i += step) {
+				edits += scratch->setBlock(id, positions[i]);
+			}
+			const LightStats& after = scratch->getEditLightStats();
+			unsigned long long cells = after.totalCells - before.totalCells;
+			double seconds = (after.totalMilliseconds - before.totalMilliseconds) / 1000.0;
+			mismatches += scratch->countBlockLightMismatches(chunksAcross);
+			printf("  %-9s %5d edits  %8.1f cells each  %8.2f million cells/s  %8.1f us per edit\n", name, edits, edits > 0 ? (double)cells / edits : 0.0, seconds > 0 ? cells / seconds / 1e6 : 0.0, edits > 0 ? seconds * 1e6 / edits : 0.0);
+		};
+
+		printf("light benchmark: %d glowstone over %d chunks\n", (int)positions.size(), chunksAcross * chunksAcross);
+		pass("placing", BlockId::Glowstone, 0, 1);
+		pass("removing", BlockId::Air, 0, 2); // every other one, so the rest have to fill the holes back in
+		pass("removing", BlockId::Air, 1, 2);
+		printf("  mismatched light: %d\n", mismatches);
+		return mismatches;
+	}
+
+	const LightStats& getChunkLightStats() { return lightEngine.chunkStats; }
+	const LightStats& getEditLightStats() { return lightEngine.editStats; }
+	const CullStats& getCullStats() { return cullStats; }
+
+	// the parts of the index buffer the frustum can see. a chunk is checked against its bounds first and only
+	// the sections of the ones that pass are checked on their own. sections that sit next to each other in the
+	// buffer are joined into one draw
+	void getVisibleRanges(const ViewFrustum& frustum, std::vector<IndexRange>& ranges) {
+		ranges.clear();
+		cullStats = CullStats();
+
+		for (auto& chunkRange : chunkRanges) {
+			Chunk* chunk = findChunk(chunkRange.chunkPos);
+			if (!chunk) {
+				continue;
+			}
+
+			for (int section = 0; section < Chunk::NUM_SECTIONS; section++) {
+				cullStats.sections += chunkRange.sectionFirstIndex[section + 1] > chunkRange.sectionFirstIndex[section];
+			}
+			cullStats.chunks++;
+
+#ifdef FRUSTUM_CULLING_ENABLED
+			if (!frustum.isBoxInFrustum(chunk->getBounds())) {
+				continue;
+			}
+#endif
+			cullStats.chunksDrawn++;
+
+			for (int section = 0; section < Chunk::NUM_SECTIONS; section++) {
+				uint32_t first = chunkRange.sectionFirstIndex[section];
+				uint32_t count = chunkRange.sectionFirstIndex[section + 1] - first;
+				if (count == 0) {
+					continue;
+				}
+#ifdef FRUSTUM_CULLING_ENABLED
+				if (!frustum.isBoxInFrustum(chunk->getSectionBounds(section))) {
+					continue;
+				}
+#endif
+				cullStats.sectionsDrawn++;
+
+				if (!ranges.empty() && ranges.back().firstIndex + ranges.back().indexCount == first) {
+					ranges.back().indexCount += count;
+				}
+				else {
+					ranges.push_back({ first, count });
+				}
+			}
+		}
+
+		cullStats.draws = (unsigned int)ranges.size();
+	}
+
 private:
-	TerrainGenerator terrainGenerator;
+	ChunkGenerator chunkGenerator;
+	WorldSave worldSave;
+	std::vector<DecorationBlock> decorationBlocks; // trees and boulders the chunk being generated left for its neighbours
+	std::vector<DecorationBlock> neighbourDecorationBlocks; // the ones that land in chunks already generated
+
+	// decoration blocks that land outside the chunk they grew from, by the chunk they grew from. a neighbour
+	// picks out its own when it's generated, so they're kept while anything in the 3x3 around the chunk is
+	// still loaded, because an unloaded neighbour is generated again from scratch. once all 9 are gone nothing
+	// loaded holds any of them, so they're dropped and handed out again the next time the chunk is generated.
+	std::unordered_map<Vec4, std::vector<DecorationBlock>> outgoingBlocks;
 	std::vector<Vec4> chunkLoadList;
 	std::vector<Vec4> visibleChunksList;
 	std::vector<Vec4> renderableChunksList;
@@ -122,9 +661,333 @@ private:
 	Vec4 camChunkCoordsNew;
 	ViewFrustum camFrustum;
 
+	// where each renderable chunk's sections start in the index buffer, as of the last time it was put together
+	struct ChunkRanges {
+		Vec4 chunkPos;
+		uint32_t sectionFirstIndex[Chunk::NUM_SECTIONS + 1];
+	};
+	std::vector<ChunkRanges> chunkRanges;
+	CullStats cullStats;
+
 	std::unordered_map<Vec4, Chunk> chunkMap;
+	LightEngine lightEngine{ chunkMap, blockdb };
+	TerrainQuery terrainQuery{ chunkMap, chunkGenerator.terrain, chunkGenerator.caves };
 	bool forceVertexUpdate = false;
 
+	// a copy of the chunk being meshed with a 1 block border taken from its neighbours, so the mesher
+	// never has to go looking through the chunk map. y runs from -1 to CHUNK_HEIGHT.
+	static const int PADDED_WIDTH = AppGlobals::CHUNK_WIDTH + 2;
+	static const int PADDED_HEIGHT = AppGlobals::CHUNK_HEIGHT + 2;
+	std::vector<unsigned char> paddedOpaque = std::vector<unsigned char>(PADDED_WIDTH * PADDED_WIDTH * PADDED_HEIGHT);
+	std::vector<unsigned char> paddedLight = std::vector<unsigned char>(PADDED_WIDTH * PADDED_WIDTH * PADDED_HEIGHT);
+	std::vector<BlockId> paddedBlocks = std::vector<BlockId>(PADDED_WIDTH * PADDED_WIDTH * PADDED_HEIGHT);
+
+
+	// the chunk a ray was last in, so it only goes looking for a chunk when it crosses into another one
+	struct RayChunk {
+		Chunk* chunk = nullptr;
+		int x = 0;
+		int z = 0;
+		bool found = false;
+	};
+
+	// the block at x, y, z for a ray, with y inside the world. air if its chunk isn't generated
+	BlockId rayBlock(int x, int y, int z, RayChunk& last) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		int chunkX = floorDiv(x, W);
+		int chunkZ = floorDiv(z, W);
+		if (!last.found || chunkX != last.x || chunkZ != last.z) {
+			last.chunk = findGeneratedChunk(Vec4((float)chunkX, 0.f, (float)chunkZ, 0.f));
+			last.x = chunkX;
+			last.z = chunkZ;
+			last.found = true;
+		}
+		if (!last.chunk || last.chunk->layers[y].blockCount == 0) {
+			return BlockId::Air;
+		}
+		return last.chunk->getBlock(x - chunkX * W, y, z - chunkZ * W);
+	}
+
+	// the block a ray starts in, which way it steps on each axis, and how far along it the next face on each axis
+	// is and the faces after that are apart
+	static void rayStart(const float o[3], const float d[3], int cell[3], int step[3], float tNext[3], float tDelta[3]) {
+		for (int i = 0; i < 3; i++) {
+			cell[i] = (int)floorf(o[i]);
+			step[i] = d[i] > 0 ? 1 : (d[i] < 0 ? -1 : 0);
+			tDelta[i] = step[i] ? 1.f / fabsf(d[i]) : INFINITY;
+			tNext[i] = step[i] > 0 ? (cell[i] + 1 - o[i]) * tDelta[i] : (step[i] < 0 ? (o[i] - cell[i]) * tDelta[i] : INFINITY);
+		}
+	}
+
+	// normal is the sign on normalAxis, which is -1 if the ray started in the block
+	static void setRayHit(RaycastHit& hit, const int cell[3], int normal, int normalAxis, float t, BlockId id) {
+		float n[3] = {};
+		if (normalAxis >= 0) {
+			n[normalAxis] = (float)normal;
+		}
+		hit.block = Vec4((float)cell[0], (float)cell[1], (float)cell[2], 0.f);
+		hit.normal = Vec4(n[0], n[1], n[2], 0.f);
+		hit.distance = t;
+		hit.id = id;
+	}
+
+
+	// floods the block light of a square of chunks starting at chunk 0, 0 from nothing, the slow and obvious way,
+	// and counts the blocks where the light engine has something else
+	int countBlockLightMismatches(int chunksAcross) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		const int across = chunksAcross * W;
+		auto cellIndex = [&](int x, int y, int z) { return ((size_t)y * across + z) * across + x; };
+		auto blockAt = [&](int x, int y, int z) { return findGeneratedChunk(Vec4((float)(x / W), 0.f, (float)(z / W), 0.f))->getBlock(x % W, y, z % W); };
+
+		// every light source, then each level spreads one less into the blocks around it that aren't lit more already
+		std::vector<unsigned char> expected((size_t)across * across * H, 0);
+		std::vector<size_t> byLevel[LightEngine::MAX_LIGHT + 1];
+		for (int x = 0; x < across; x++) {
+			for (int z = 0; z < across; z++) {
+				for (int y = 0; y < H; y++) {
+					unsigned char emitted = blockdb.blockDataFor(blockAt(x, y, z)).getLightEmission();
+					if (emitted > 0) {
+						expected[cellIndex(x, y, z)] = emitted;
+						byLevel[emitted].push_back(cellIndex(x, y, z));
+					}
+				}
+			}
+		}
+
+		for (int level = LightEngine::MAX_LIGHT; level > 1; level--) {
+			for (size_t i = 0; i < byLevel[level].size(); i++) {
+				size_t cell = byLevel[level][i];
+				if (expected[cell] != level) {
+					continue;
+				}
+
+				int x = (int)(cell % across);
+				int z = (int)(cell / across % across);
+				int y = (int)(cell / across / across);
+				for (int face = 0; face < 6; face++) {
+					int nx = x + FACE_OFFSETS[face][0];
+					int ny = y + FACE_OFFSETS[face][1];
+					int nz = z + FACE_OFFSETS[face][2];
+					if (nx < 0 || nx >= across || ny < 0 || ny >= H || nz < 0 || nz >= across || blockdb.blockDataFor(blockAt(nx, ny, nz)).isOpaque()) {
+						continue;
+					}
+
+					size_t neighbour = cellIndex(nx, ny, nz);
+					if (expected[neighbour] < level - 1) {
+						expected[neighbour] = level - 1;
+						byLevel[level - 1].push_back(neighbour);
+					}
+				}
+			}
+		}
+
+		int mismatches = 0;
+		for (int x = 0; x < across; x++) {
+			for (int z = 0; z < across; z++) {
+				Chunk* chunk = findGeneratedChunk(Vec4((float)(x / W), 0.f, (float)(z / W), 0.f));
+				for (int y = 0; y < H; y++) {
+					mismatches += chunk->getBlockLight(x % W, y, z % W) != expected[cellIndex(x, y, z)];
+				}
+			}
+		}
+		return mismatches;
+	}
+
+	// times asking the terrain query for every block and ground height in a square of chunks that aren't loaded
+	// against generating them, and checks the answers against the filled and carved chunks. decorations are
+	// left off the chunks since the query doesn't know about them. returns how many blocks and heights differ
+	int benchmarkQuery(int chunksAcross) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		int chunks = chunksAcross * chunksAcross;
+		int heights[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+		Biome biomes[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+		long long differingBlocks = 0;
+		long long differingHeights = 0;
+		double generateSeconds = 0;
+		double columnSeconds = 0;
+		double blockSeconds = 0;
+		TerrainStats oldStats = chunkGenerator.terrain.stats;
+		int xs[AppGlobals::CHUNK_WIDTH * AppGlobals::CHUNK_WIDTH], zs[AppGlobals::CHUNK_WIDTH * AppGlobals::CHUNK_WIDTH];
+		int groundHeights[AppGlobals::CHUNK_WIDTH * AppGlobals::CHUNK_WIDTH];
+		std::vector<int> blockX(H), blockY(H), blockZ(H);
+		std::vector<BlockId> blockIds(H);
+		std::vector<unsigned char> solidBlocks;
+
+		// far from anything loaded
+		int offset = 1 << 16;
+		for (int chunkX = offset; chunkX < offset + chunksAcross; chunkX++) {
+			for (int chunkZ = offset; chunkZ < offset + chunksAcross; chunkZ++) {
+				auto startTime = std::chrono::high_resolution_clock::now();
+				std::unique_ptr<Chunk> chunk(new Chunk(Vec4((float)chunkX, 0.f, (float)chunkZ, 0.f)));
+				chunkGenerator.terrain.GetBiomes(chunkX, chunkZ, biomes);
+				if (AppGlobals::densityTerrain) {
+					chunkGenerator.terrain.GetSolid(chunkX, chunkZ, solidBlocks);
+					chunkGenerator.fillStrata(*chunk, solidBlocks, biomes);
+				}
+				else {
+					chunkGenerator.terrain.GetHeights(chunkX, chunkZ, heights);
+					chunkGenerator.fillStrata(*chunk, heights, biomes);
+				}
+				if (AppGlobals::caves) {
+					chunkGenerator.caves.SetSeed(AppGlobals::seed);
+					chunkGenerator.caves.Carve(*chunk, ChunkGenerator::bedrockHeight());
+				}
+				auto midTime = std::chrono::high_resolution_clock::now();
+
+				for (int x = 0; x < W; x++) {
+					for (int z = 0; z < W; z++) {
+						xs[x * W + z] = chunkX * W + x;
+						zs[x * W + z] = chunkZ * W + z;
+					}
+				}
+				terrainQuery.GetGroundHeights(xs, zs, W * W, groundHeights);
+				auto columnTime = std::chrono::high_resolution_clock::now();
+
+				for (int x = 0; x < W; x++) {
+					for (int z = 0; z < W; z++) {
+						for (int y = 0; y < H; y++) {
+							blockX[y] = chunkX * W + x;
+							blockY[y] = y;
+							blockZ[y] = chunkZ * W + z;
+						}
+						terrainQuery.GetBlocks(blockX.data(), blockY.data(), blockZ.data(), H, blockIds.data());
+						for (int y = 0; y < H; y++) {
+							differingBlocks += blockIds[y] != chunk->getBlock(x, y, z);
+						}
+						differingHeights += groundHeights[x * W + z] != chunk->columnTop[x][z];
+					}
+				}
+				auto endTime = std::chrono::high_resolution_clock::now();
+
+				generateSeconds += std::chrono::duration<double>(midTime - startTime).count();
+				columnSeconds += std::chrono::duration<double>(columnTime - midTime).count();
+				blockSeconds += std::chrono::duration<double>(endTime - columnTime).count();
+			}
+		}
+		chunkGenerator.terrain.stats = oldStats;
+
+		long long columns = (long long)chunks * W * W;
+		printf("terrain query benchmark: %d chunks that aren't loaded\n", chunks);
+		printf("  generating the chunks:   %10.1f columns/s\n", columns / generateSeconds);
+		printf("  ground heights:          %10.1f columns/s  (%.2fx)\n", columns / columnSeconds, generateSeconds / columnSeconds);
+		printf("  every block of a column: %10.1f columns/s  (%.2fx)\n", columns / blockSeconds, generateSeconds / blockSeconds);
+		printf("  differing blocks: %lld  differing heights: %lld\n", differingBlocks, differingHeights);
+		return (int)(differingBlocks + differingHeights);
+	}
+
+	// times filling chunks the way it used to be done, with one grass block per column, against filling every
+	// block under the surface with runs, the same with decorations on top, and the same fill a block at a time
+	// through SetBlock. includes sampling the terrain, but not lighting or meshing. returns how many layers the
+	// runs and SetBlock fill differently, which should be none
+	int benchmarkFill(int chunksAcross) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		int heights[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+		Biome biomes[AppGlobals::CHUNK_WIDTH][AppGlobals::CHUNK_WIDTH];
+		std::vector<unsigned char> solidBlocks;
+		long long blocks = 0;
+
+		// mode 0 is surface grass only, 1 strata with runs, 2 strata through SetBlock, 3 density strata and 4 strata with decorations
+		auto fillChunk = [&](int chunkX, int chunkZ, int mode) {
+			std::unique_ptr<Chunk> chunk(new Chunk(Vec4((float)chunkX, 0.f, (float)chunkZ, 0.f)));
+			if (mode != 0) {
+				chunkGenerator.terrain.GetBiomes(chunkX, chunkZ, biomes);
+			}
+
+			if (mode == 3) {
+				chunkGenerator.terrain.GetSolid(chunkX, chunkZ, solidBlocks);
+				chunkGenerator.fillStrata(*chunk, solidBlocks, biomes);
+			}
+			else {
+				chunkGenerator.terrain.GetHeights(chunkX, chunkZ, heights);
+			}
+
+			if (mode == 0) {
+				for (int x = 0; x < W; x++) {
+					for (int z = 0; z < W; z++) {
+						chunk->SetBlock(BlockId::Grass, Vec4(x, heights[x][z], z, 0));
+					}
+				}
+			}
+			else if (mode == 1) {
+				chunkGenerator.fillStrata(*chunk, heights, biomes);
+			}
+			else if (mode == 4) {
+				chunkGenerator.fillStrata(*chunk, heights, biomes);
+				chunkGenerator.decorator.Decorate(*chunk, biomes, decorationBlocks);
+				for (auto& block : decorationBlocks) {
+					if (getChunkXZ(Vec4((float)block.x, (float)block.y, (float)block.z, 0.f)) == chunk->position) {
+						ChunkGenerator::mergeDecorationBlock(*chunk, block);
+					}
+				}
+			}
+			else if (mode == 2) {
+				for (int x = 0; x < W; x++) {
+					for (int z = 0; z < W; z++) {
+						for (int y = 0; y <= heights[x][z]; y++) {
+							const BiomeInfo& info = BIOMES[static_cast<int>(biomes[x][z])];
+							BlockId id = y < ChunkGenerator::bedrockHeight() ? BlockId::Bedrock :
+								y == heights[x][z] ? info.surface :
+								y >= heights[x][z] - AppGlobals::dirtDepth ? info.filler : BlockId::Stone;
+							chunk->SetBlock(id, Vec4(x, y, z, 0));
+						}
+					}
+				}
+			}
+			return chunk;
+		};
+
+		auto timeChunks = [&](int mode) {
+			blocks = 0;
+			auto startTime = std::chrono::high_resolution_clock::now();
+			for (int chunkX = 0; chunkX < chunksAcross; chunkX++) {
+				for (int chunkZ = 0; chunkZ < chunksAcross; chunkZ++) {
+					std::unique_ptr<Chunk> chunk = fillChunk(chunkX, chunkZ, mode);
+					for (int y = 0; y < H; y++) {
+						blocks += chunk->layers[y].blockCount;
+					}
+				}
+			}
+			auto endTime = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<double>(endTime - startTime).count();
+		};
+
+		int chunks = chunksAcross * chunksAcross;
+		printf("chunk fill benchmark: %d chunks\n", chunks);
+
+		double surfaceSeconds = timeChunks(0);
+		long long surfaceBlocks = blocks;
+		printf("  surface grass only:      %10.1f chunks/s  %lld blocks\n", chunks / surfaceSeconds, surfaceBlocks);
+
+		double runSeconds = timeChunks(1);
+		printf("  strata, runs:            %10.1f chunks/s  %lld blocks (%.1fx the blocks, %.2fx the time)\n", chunks / runSeconds, blocks, (double)blocks / surfaceBlocks, runSeconds / surfaceSeconds);
+
+		double decoratedSeconds = timeChunks(4);
+		printf("  strata and decorations:  %10.1f chunks/s  (%.2fx the time)\n", chunks / decoratedSeconds, decoratedSeconds / surfaceSeconds);
+
+		double setBlockSeconds = timeChunks(2);
+		printf("  strata, SetBlock:        %10.1f chunks/s  (%.2fx the time)\n", chunks / setBlockSeconds, setBlockSeconds / surfaceSeconds);
+
+		double densitySeconds = timeChunks(3);
+		printf("  density strata, runs:    %10.1f chunks/s  %lld blocks\n", chunks / densitySeconds, blocks);
+
+		int differing = 0;
+		for (int chunkX = 0; chunkX < chunksAcross; chunkX++) {
+			for (int chunkZ = 0; chunkZ < chunksAcross; chunkZ++) {
+				std::unique_ptr<Chunk> runs = fillChunk(chunkX, chunkZ, 1);
+				std::unique_ptr<Chunk> oneByOne = fillChunk(chunkX, chunkZ, 2);
+				for (int y = 0; y < H; y++) {
+					differing += memcmp(runs->layers[y].blocks, oneByOne->layers[y].blocks, sizeof(runs->layers[y].blocks)) != 0 ||
+						runs->layers[y].blockCount != oneByOne->layers[y].blockCount;
+				}
+			}
+		}
+		printf("  layers that differ between runs and SetBlock: %d\n", differing);
+		return differing;
+	}
 
 	void updateLoadList() {
 		int numOfChunksLoaded = 0;
@@ -140,18 +1003,14 @@ private:
 		for (float x = lowChunkXZ.x; x <= highChunkXZ.x; x++) {
 			for (float z = lowChunkXZ.z; z <= highChunkXZ.z; z++) {
 				Vec4 chunkPos(x, 0.f, z, 0.f);
-				// if the chunk is in the view frustum (if frustum culling is enabled)
-				#ifdef FRUSTUM_CULLING_ENABLED 
-				if (camFrustum.isBoxInFrustum(c.bbox))
-					#endif
-				{
-					// if the chunk is not already loaded
-					if (!getChunk(chunkPos)->isLoaded) {
-						// if the chunk is not already in the load list
-						if (!ChunkAlreadyExistsIn(chunkLoadList, chunkPos)) {
-							// put the chunk into the load list
-							chunkLoadList.push_back(chunkPos);
-						}
+				// everything in range is loaded and meshed whichever way the camera faces. what's out of view is
+				// skipped when it's drawn, so turning around doesn't need a new mesh
+				// if the chunk is not already loaded
+				if (!getChunk(chunkPos)->isLoaded) {
+					// if the chunk is not already in the load list
+					if (!ChunkAlreadyExistsIn(chunkLoadList, chunkPos)) {
+						// put the chunk into the load list
+						chunkLoadList.push_back(chunkPos);
 					}
 				}
 			}
@@ -188,10 +1047,6 @@ private:
 	void updateVisibleList() {
 		// for each chunk in the potentially visible list
 		for (int i = 0; i < visibleChunksList.size(); i++) {
-			#ifdef FRUSTUM_CULLING_ENABLED 
-			// if the chunk is in the view frustum (if frustum culling is enabled)
-			if ( camFrustum.isBoxInFrustum(c.bbox)) 
-			#endif
 			{
 				// if the chunk is loaded
 				if (getChunk(visibleChunksList[i])->isLoaded) {
@@ -215,21 +1070,11 @@ private:
 						i--;
 					}
 				}
-				// if the chunk is in the frustum but not yet loaded
+				// if the chunk is not yet loaded
 				else {
 					// do nothing. ie: wait for the chunk to be loaded in the next few frames.
 				}
 			}
-			#ifdef FRUSTUM_CULLING_ENABLED 
-			// if the chunk is not in the frustum at all
-			else {
-				// remove the chunk from the visible list because it is not visible to the player and should not be rendered
-				visibleChunksList.erase(visibleChunksList.begin() + i);
-
-				// subtract 1 from the index since the container size changed
-				i--;
-			}
-			#endif
 		}
 	}
 
@@ -271,12 +1116,149 @@ private:
 		if (chunkExistsAt(chunkPos)) {
 			chunkMap.erase(chunkPos);
 		}
+
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				Vec4 source(chunkPos.x + dx, 0.f, chunkPos.z + dz, 0.f);
+				if (outgoingBlocks.count(source) && !anyChunkAround(source)) {
+					outgoingBlocks.erase(source);
+				}
+			}
+		}
+	}
+
+	// whether the chunk or any of the 8 around it is loaded
+	bool anyChunkAround(Vec4 chunkPos) {
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				if (chunkExistsAt(Vec4(chunkPos.x + dx, 0.f, chunkPos.z + dz, 0.f))) {
+					return true;
+				}
+			}
+		}
+		return false;
 	}
 
 	bool chunkExistsAt(Vec4 chunkPos) {
 		return chunkMap.find(chunkPos) != chunkMap.end();
 	}
 
+	// like getChunk but never creates one
+	Chunk* findChunk(Vec4 chunkPos) {
+		auto it = chunkMap.find(chunkPos);
+		return it != chunkMap.end() ? &it->second : nullptr;
+	}
+
+	void markNeighbourDirtyIfOnEdge(Vec4 chunkPos, Vec4 blockPos) {
+		int dx = blockPos.x == 0 ? -1 : (blockPos.x == AppGlobals::CHUNK_WIDTH - 1 ? 1 : 0);
+		int dz = blockPos.z == 0 ? -1 : (blockPos.z == AppGlobals::CHUNK_WIDTH - 1 ? 1 : 0);
+
+		// corners touch the diagonal chunk too because of ambient occlusion
+		for (int x = (dx < 0 ? dx : 0); x <= (dx > 0 ? dx : 0); x++) {
+			for (int z = (dz < 0 ? dz : 0); z <= (dz > 0 ? dz : 0); z++) {
+				if (x == 0 && z == 0) {
+					continue;
+				}
+
+				Chunk* neighbour = findChunk(Vec4(chunkPos.x + x, 0.f, chunkPos.z + z, 0.f));
+				if (neighbour) {
+					neighbour->meshDirty = true;
+				}
+			}
+		}
+	}
+
+	// light can spread at most 15 blocks, so an edit or a new chunk can only dirty the chunks touching it
+	void remeshDirtyNeighbours(Vec4 chunkPos) {
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				Chunk* chunk = findChunk(Vec4(chunkPos.x + dx, 0.f, chunkPos.z + dz, 0.f));
+				if (chunk && chunk->isLoaded && chunk->meshDirty) {
+					generateVerticesAndIndices(chunk->position);
+					forceVertexUpdate = true;
+				}
+			}
+		}
+	}
+
+	static int paddedIndex(int x, int y, int z) {
+		return ((y + 1) * PADDED_WIDTH + (z + 1)) * PADDED_WIDTH + (x + 1);
+	}
+
+	static int paddedOffset(const int (&offset)[3]) {
+		return (offset[1] * PADDED_WIDTH + offset[2]) * PADDED_WIDTH + offset[0];
+	}
+
+	// classic voxel ambient occlusion. 3 is fully lit, 0 is a vertex tucked into a corner. if both sides
+	// are solid the corner can't be seen so it doesn't matter what's there.
+	int vertexAO(int sample, const AONeighbours& neighbours) {
+		static const unsigned char AO_TABLE[2][2][2] = {
+			{ { 3, 2 }, { 2, 1 } },
+			{ { 2, 1 }, { 0, 0 } },
+		};
+
+		int side1 = sample + paddedOffset(neighbours.side1);
+		int side2 = sample + paddedOffset(neighbours.side2);
+		int corner = side1 + paddedOffset(neighbours.side2);
+		return AO_TABLE[paddedOpaque[side1]][paddedOpaque[side2]][paddedOpaque[corner]];
+	}
+
+	// copies the blocks, opacity and light of a chunk and the border around it into the padded buffers
+	void fillPaddedChunk(Chunk& chunk) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		const unsigned char openSky = LightEngine::MAX_LIGHT << 4;
+
+		Chunk* neighbours[3][3];
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				Chunk* neighbour = findChunk(Vec4(chunk.position.x + dx, 0.f, chunk.position.z + dz, 0.f));
+				neighbours[dx + 1][dz + 1] = (neighbour && neighbour->isGenerated) ? neighbour : nullptr;
+			}
+		}
+		neighbours[1][1] = &chunk;
+
+		for (int y = -1; y <= H; y++) {
+			for (int z = -1; z <= W; z++) {
+				for (int x = -1; x <= W; x++) {
+					int i = paddedIndex(x, y, z);
+
+					// nothing is ever seen from below the world. above it is open sky.
+					if (y < 0) {
+						paddedBlocks[i] = BlockId::Air;
+						paddedOpaque[i] = 1;
+						paddedLight[i] = 0;
+						continue;
+					}
+					if (y >= H) {
+						paddedBlocks[i] = BlockId::Air;
+						paddedOpaque[i] = 0;
+						paddedLight[i] = openSky;
+						continue;
+					}
+
+					int cx = x < 0 ? 0 : (x >= W ? 2 : 1);
+					int cz = z < 0 ? 0 : (z >= W ? 2 : 1);
+					Chunk* source = neighbours[cx][cz];
+
+					// treat chunks that don't exist yet as open air. they get remeshed when it arrives
+					if (!source) {
+						paddedBlocks[i] = BlockId::Air;
+						paddedOpaque[i] = 0;
+						paddedLight[i] = openSky;
+						continue;
+					}
+
+					int lx = x - (cx - 1) * W;
+					int lz = z - (cz - 1) * W;
+					paddedBlocks[i] = source->getBlock(lx, y, lz);
+					paddedOpaque[i] = blockdb.blockDataFor(paddedBlocks[i]).isOpaque() ? 1 : 0;
+					paddedLight[i] = source->layers[y].light[lx][lz];
+				}
+			}
+		}
+	}
+
 	double sqDistanceToChunk(Chunk& chunk) {
 		return ((camChunkCoordsNew.x - chunk.position.x) * (camChunkCoordsNew.x - chunk.position.x)) + ((camChunkCoordsNew.z - chunk.position.z) * (camChunkCoordsNew.z - chunk.position.z));
 	}
@@ -300,13 +1282,16 @@ private:
 		chunk->vertices.clear();
 		chunk->indices.clear();
 
-		for (float y = 0; y < AppGlobals::CHUNK_HEIGHT; y++) {
-			for (float x = 0; x < AppGlobals::CHUNK_WIDTH; x++) {
-				for (float z = 0; z < AppGlobals::CHUNK_WIDTH; z++) {
-					// infer the block position using its coordinates
-					Vec4 blockPosition( x, y, z, 0.f);
+		fillPaddedChunk(*chunk);
+
+		for (int y = 0; y < AppGlobals::CHUNK_HEIGHT; y++) {
+			if (y % Chunk::SECTION_HEIGHT == 0) {
+				chunk->sectionFirstIndex[y / Chunk::SECTION_HEIGHT] = (unsigned int)chunk->indices.size();
+			}
 
-					auto blockId = chunk->getBlock(blockPosition);
+			for (int x = 0; x < AppGlobals::CHUNK_WIDTH; x++) {
+				for (int z = 0; z < AppGlobals::CHUNK_WIDTH; z++) {
+					auto blockId = chunk->getBlock(x, y, z);
 
 					// dont render air
 					if (blockId == BlockId::Air) {
@@ -314,38 +1299,92 @@ private:
 					}
 
 					// get the block's data
-					auto verts = blockdb.blockDataFor(blockId).getVertices();
-					auto inds = blockdb.blockDataFor(blockId).getIndices();
-
-					// save the offset for the indices
-					auto offset = chunk->vertices.size();
-
-					// account for the block position and chunk position and store the new verts for later
-					for (int i = 0; i < verts.size(); i++) {
-						Vertex v(verts[i]);
-						v.pos.x += blockPosition.x;
-						v.pos.y += blockPosition.y;
-						v.pos.z += blockPosition.z;
-						v.pos.x += chunk->position.x * AppGlobals::CHUNK_WIDTH; // coords are now in world coords format. 
-						v.pos.z += chunk->position.z * AppGlobals::CHUNK_WIDTH;
-						chunk->vertices.push_back(v);
-					}
+					auto& blockData = blockdb.blockDataFor(blockId);
 
-					// account for the offset into vertices vector and store the indices for later
-					for (int i = 0; i < inds.size(); i++) {
-						unsigned int ind(inds[i] + offset);
-						chunk->indices.push_back(ind);
+					for (int face = 0; face < static_cast<int>(BlockFace::NUM_FACES); face++) {
+						auto& faceMesh = blockData.getFace(static_cast<BlockFace>(face));
+						if (faceMesh.indices.empty()) {
+							continue;
+						}
+
+						// faces take their light from the block they face. inner geometry from the block itself.
+						int sample = paddedIndex(x, y, z);
+						if (face != static_cast<int>(BlockFace::Inner)) {
+							sample = paddedIndex(x + FACE_OFFSETS[face][0], y + FACE_OFFSETS[face][1], z + FACE_OFFSETS[face][2]);
+
+							// dont render faces that are hidden behind an opaque block or covered by the side of a
+							// shaped one. below the world counts as opaque.
+							if (paddedOpaque[sample] || blockData.isFaceHiddenBy(static_cast<BlockFace>(face), blockdb.blockDataFor(paddedBlocks[sample]))) {
+								continue;
+							}
+						}
+
+						Vec4 light((paddedLight[sample] >> 4) / 15.f, (paddedLight[sample] & 0x0F) / 15.f, 1.f, 0.f);
+						bool isInner = face == static_cast<int>(BlockFace::Inner);
+						int quadAO[4] = { 3, 3, 3, 3 };
+
+						// save the offset for the indices
+						auto offset = chunk->vertices.size();
+
+						// account for the block position and chunk position and store the new verts for later
+						for (int i = 0; i < faceMesh.vertices.size(); i++) {
+							Vertex v(faceMesh.vertices[i]);
+							v.pos.x += x;
+							v.pos.y += y;
+							v.pos.z += z;
+							v.pos.x += chunk->position.x * AppGlobals::CHUNK_WIDTH; // coords are now in world coords format. 
+							v.pos.z += chunk->position.z * AppGlobals::CHUNK_WIDTH;
+							v.light = light;
+
+							if (!isInner) {
+								int ao = vertexAO(sample, faceMesh.aoNeighbours[i]);
+								v.light.z = ao / 3.f;
+								if (i < 4) {
+									quadAO[i] = ao;
+								}
+							}
+
+							chunk->vertices.push_back(v);
+						}
+
+						// account for the offset into vertices vector and store the indices for later
+						if (faceMesh.isQuad) {
+							// split the quad along the diagonal with the brighter corners. otherwise the darkness
+							// from one corner gets smeared along the diagonal and faces look different depending
+							// on which way they were triangulated.
+							const unsigned int* q = faceMesh.quad;
+							int a = quadAO[q[0]] + quadAO[q[2]];
+							int b = quadAO[q[1]] + quadAO[q[3]];
+							unsigned int order[6] = { q[0], q[1], q[2], q[0], q[2], q[3] };
+							if (b > a) {
+								unsigned int flipped[6] = { q[1], q[2], q[3], q[1], q[3], q[0] };
+								std::copy(flipped, flipped + 6, order);
+							}
+
+							for (int i = 0; i < 6; i++) {
+								chunk->indices.push_back(order[i] + offset);
+							}
+						}
+						else {
+							for (int i = 0; i < faceMesh.indices.size(); i++) {
+								unsigned int ind(faceMesh.indices[i] + offset);
+								chunk->indices.push_back(ind);
+							}
+						}
 					}
 				}
 			}
 		}
+		chunk->sectionFirstIndex[Chunk::NUM_SECTIONS] = (unsigned int)chunk->indices.size();
 		assert(chunk->vertices.size() > 0);
 		chunk->isLoaded = true;
+		chunk->meshDirty = false;
 	}
 
 	void updateVerticesAndIndices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
 		vertices.clear();
 		indices.clear();
+		chunkRanges.clear();
 
 		// for each chunk in the render list
 		for (int i = 0; i < renderableChunksList.size(); i++) {
@@ -362,6 +1401,14 @@ private:
 			// save the offset for the indices
 			auto offset = vertices.size();
 
+			// and where its sections end up in the index buffer
+			ChunkRanges ranges;
+			ranges.chunkPos = renderableChunksList[i];
+			for (int section = 0; section <= Chunk::NUM_SECTIONS; section++) {
+				ranges.sectionFirstIndex[section] = (uint32_t)indices.size() + chunk->sectionFirstIndex[section];
+			}
+			chunkRanges.push_back(ranges);
+
 			vertices.insert(vertices.end(), verts.begin(), verts.end());
 
 			// account for the offset into the vertices vector and store the indices for later
@@ -0,0 +1,346 @@
+#ifndef WORLD_SAVE_HPP
+#define WORLD_SAVE_HPP
+
+
+#include "Chunk.hpp"
+#include "Decorator.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A file of generated chunks, so a world that was generated ahead of time doesn't have to be generated again when
+// it's played. Chunks are only ever added to the end, one record each, and a chunk that's saved again is found by
+// its newest record. The file is scanned for where the records are when it's opened and a record is only read
+// when its chunk is loaded.
+//
+// A record holds the chunk's blocks as runs up each column, which is what the fill makes anyway, and the
+// decoration blocks the chunk left for its neighbours, so they come out the same as if it was just generated.
+// Light isn't saved since it's worked out when the chunk is loaded.
+class WorldSave {
+public:
+	static const uint32_t FILE_MAGIC = 0x57534343; // "CCSW"
+	static const uint32_t RECORD_MAGIC = 0x4B4E4843; // "CHNK"
+	static const uint32_t VERSION = 2; // bump when what the header or a record holds changes
+
+	WorldSave() {}
+	~WorldSave() { Close(); }
+	WorldSave(const WorldSave&) = delete;
+	WorldSave& operator=(const WorldSave&) = delete;
+
+	// the seed a save was made with. false if path isn't a save this version can read, or was made with other
+	// terrain settings
+	static bool ReadSeed(const std::string& path, int& seed) {
+		FILE* in = fopen(path.c_str(), "rb");
+		if (!in) {
+			return false;
+		}
+		FileHeader header;
+		bool read = fread(&header, sizeof(header), 1, in) == 1 && isValid(header);
+		fclose(in);
+		if (read) {
+			seed = header.seed;
+		}
+		return read;
+	}
+
+	// opens path, or makes it if there's nothing there. returns false, and leaves the file alone, if it's a save
+	// of a different seed, version or terrain settings, or isn't a save at all
+	bool Open(const std::string& path, int seed) {
+		Close();
+		file = fopen(path.c_str(), "r+b");
+		if (!file) {
+			file = fopen(path.c_str(), "w+b");
+			if (!file) {
+				return false;
+			}
+			FileHeader header = currentHeader(seed);
+			if (fwrite(&header, sizeof(header), 1, file) != 1) {
+				Close();
+				return false;
+			}
+			end = sizeof(header);
+			return true;
+		}
+
+		FileHeader header;
+		if (fread(&header, sizeof(header), 1, file) != 1 || !isValid(header) || header.seed != seed) {
+			Close();
+			return false;
+		}
+		scan();
+		return true;
+	}
+
+	void Close() {
+		if (file) {
+			fclose(file);
+		}
+		file = nullptr;
+		records.clear();
+		end = 0;
+	}
+
+	bool IsOpen() const { return file != nullptr; }
+	size_t GetChunkCount() const { return records.size(); }
+	long long GetSize() const { return end; }
+
+	bool Has(int chunkX, int chunkZ) const {
+		return records.find(key(chunkX, chunkZ)) != records.end();
+	}
+
+	// where the chunk's newest record starts, or -1 if it isn't saved. records are only ever added, so this
+	// changes whenever the chunk is saved again
+	long long GetRecordOffset(int chunkX, int chunkZ) const {
+		auto found = records.find(key(chunkX, chunkZ));
+		return found == records.end() ? -1 : found->second;
+	}
+
+	// every saved chunk, in no particular order
+	void GetChunks(std::vector<std::pair<int, int>>& chunks) const {
+		chunks.clear();
+		for (auto& record : records) {
+			chunks.push_back({ (int)(int32_t)(record.first >> 32), (int)(int32_t)(uint32_t)record.first });
+		}
+	}
+
+	// makes the record for a generated chunk and the decoration blocks it left for the chunks around it. doesn't
+	// touch the file, so records can be made on any thread and appended on one.
+	static void Encode(Chunk& chunk, const std::vector<DecorationBlock>& outgoing, std::vector<unsigned char>& record) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		record.resize(sizeof(RecordHeader));
+
+		// (id, length - 1) for each run of the same block from the bottom of the column to the top. the air
+		// under and over the column's range doesn't need looking at
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				int bottom = chunk.columnBottom[x][z];
+				int top = chunk.columnTop[x][z];
+				addRuns(record, BlockId::Air, 0, bottom);
+				int y = bottom;
+				while (y < top) {
+					BlockId id = chunk.getBlock(x, y, z);
+					int runTop = y + 1;
+					while (runTop < top && chunk.getBlock(x, runTop, z) == id) {
+						runTop++;
+					}
+					addRuns(record, id, y, runTop);
+					y = runTop;
+				}
+				addRuns(record, BlockId::Air, top, H);
+			}
+		}
+
+		for (auto& block : outgoing) {
+			unsigned char bytes[DECORATION_BLOCK_SIZE];
+			int32_t coords[3] = { block.x, block.y, block.z };
+			memcpy(bytes, coords, sizeof(coords));
+			bytes[DECORATION_ID_OFFSET] = static_cast<unsigned char>(block.id);
+			record.insert(record.end(), bytes, bytes + DECORATION_BLOCK_SIZE);
+		}
+
+		RecordHeader header;
+		header.magic = RECORD_MAGIC;
+		header.chunkX = (int32_t)chunk.position.x;
+		header.chunkZ = (int32_t)chunk.position.z;
+		header.payloadSize = (uint32_t)(record.size() - sizeof(RecordHeader));
+		header.outgoingCount = (uint32_t)outgoing.size();
+		header.checksum = fnv1a(2166136261u, record.data() + sizeof(RecordHeader), header.payloadSize);
+		memcpy(record.data(), &header, sizeof(header));
+	}
+
+	// adds a record made by Encode to the end of the file
+	bool Append(const std::vector<unsigned char>& record) {
+		if (!file || record.size() < sizeof(RecordHeader)) {
+			return false;
+		}
+
+		RecordHeader header;
+		memcpy(&header, record.data(), sizeof(header));
+		if (!seek(end) || fwrite(record.data(), 1, record.size(), file) != record.size()) {
+			return false;
+		}
+		records[key(header.chunkX, header.chunkZ)] = end;
+		end += record.size();
+		return true;
+	}
+
+	// fills in a chunk that's all air from its newest record and hands back the decoration blocks it left for its
+	// neighbours. false if the chunk isn't saved or its record is damaged, and then the chunk is left all air to be
+	// generated. the whole record is checked before any of it goes in the chunk.
+	bool Load(Chunk& chunk, std::vector<DecorationBlock>& outgoing) {
+		const int W = AppGlobals::CHUNK_WIDTH;
+		const int H = AppGlobals::CHUNK_HEIGHT;
+		outgoing.clear();
+
+		auto found = records.find(key((int)chunk.position.x, (int)chunk.position.z));
+		if (found == records.end()) {
+			return false;
+		}
+
+		RecordHeader header;
+		if (!seek(found->second) || fread(&header, sizeof(header), 1, file) != 1) {
+			return false;
+		}
+		payload.resize(header.payloadSize);
+		if (fread(payload.data(), 1, payload.size(), file) != payload.size() || header.checksum != fnv1a(2166136261u, payload.data(), header.payloadSize)) {
+			return false;
+		}
+
+		if ((size_t)header.outgoingCount * DECORATION_BLOCK_SIZE > payload.size()) {
+			return false;
+		}
+		size_t blockBytes = payload.size() - (size_t)header.outgoingCount * DECORATION_BLOCK_SIZE;
+
+		// every column's runs have to be real blocks and end right at the top of the world, and take up exactly
+		// the bytes before the decoration blocks
+		size_t at = 0;
+		for (int column = 0; column < W * W; column++) {
+			int y = 0;
+			while (y < H) {
+				if (at + 2 > blockBytes || !isBlockId(payload[at]) || y + payload[at + 1] + 1 > H) {
+					return false;
+				}
+				y += payload[at + 1] + 1;
+				at += 2;
+			}
+		}
+		if (at != blockBytes) {
+			return false;
+		}
+		for (uint32_t i = 0; i < header.outgoingCount; i++) {
+			if (!isBlockId(payload[blockBytes + i * DECORATION_BLOCK_SIZE + DECORATION_ID_OFFSET])) {
+				return false;
+			}
+		}
+
+		at = 0;
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				int y = 0;
+				while (y < H) {
+					BlockId id = static_cast<BlockId>(payload[at]);
+					int runTop = y + payload[at + 1] + 1;
+					if (id != BlockId::Air) {
+						chunk.fillColumn(x, z, y, runTop, id);
+					}
+					y = runTop;
+					at += 2;
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < header.outgoingCount; i++) {
+			const unsigned char* bytes = &payload[blockBytes + i * DECORATION_BLOCK_SIZE];
+			int32_t coords[3];
+			memcpy(coords, bytes, sizeof(coords));
+			outgoing.push_back({ coords[0], coords[1], coords[2], static_cast<BlockId>(bytes[DECORATION_ID_OFFSET]) });
+		}
+		return true;
+	}
+
+private:
+	// everything besides the seed that changes what the generator makes, so chunks from a save always match the
+	// ones generated next to them
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		int32_t seed;
+		int32_t chunkHeight;
+		uint32_t terrainFlags; // TERRAIN_ flags
+		int32_t dirtDepth;
+		int32_t bedrockDepth;
+	};
+
+	static const uint32_t TERRAIN_DENSITY = 1;
+	static const uint32_t TERRAIN_BIOMES = 2;
+	static const uint32_t TERRAIN_CAVES = 4;
+
+	struct RecordHeader {
+		uint32_t magic;
+		int32_t chunkX;
+		int32_t chunkZ;
+		uint32_t payloadSize; // the block runs, then the decoration blocks
+		uint32_t outgoingCount;
+		uint32_t checksum; // of the payload
+	};
+
+	static const int DECORATION_BLOCK_SIZE = 13; // x, y, z and the id, packed
+	static const int DECORATION_ID_OFFSET = 12;
+
+	FILE* file = nullptr;
+	long long end = 0; // where the next record goes
+	std::unordered_map<uint64_t, long long> records; // where each chunk's newest record starts
+	std::vector<unsigned char> payload;
+
+	static uint64_t key(int chunkX, int chunkZ) {
+		return ((uint64_t)(uint32_t)chunkX << 32) | (uint32_t)chunkZ;
+	}
+
+	// bottom to top - 1 as runs of at most 256
+	static void addRuns(std::vector<unsigned char>& record, BlockId id, int bottom, int top) {
+		while (top > bottom) {
+			int length = std::min(top - bottom, 256);
+			record.push_back(static_cast<unsigned char>(id));
+			record.push_back((unsigned char)(length - 1));
+			bottom += length;
+		}
+	}
+
+	static FileHeader currentHeader(int seed) {
+		FileHeader header;
+		header.magic = FILE_MAGIC;
+		header.version = VERSION;
+		header.seed = seed;
+		header.chunkHeight = AppGlobals::CHUNK_HEIGHT;
+		header.terrainFlags = (AppGlobals::densityTerrain ? TERRAIN_DENSITY : 0) | (AppGlobals::biomes ? TERRAIN_BIOMES : 0) | (AppGlobals::caves ? TERRAIN_CAVES : 0);
+		header.dirtDepth = AppGlobals::dirtDepth;
+		header.bedrockDepth = AppGlobals::bedrockDepth;
+		return header;
+	}
+
+	static bool isBlockId(unsigned char id) {
+		return id < static_cast<unsigned char>(BlockId::NUM_TYPES);
+	}
+
+	// the seed is checked on its own since a save can pick it
+	static bool isValid(const FileHeader& header) {
+		FileHeader current = currentHeader(header.seed);
+		return header.magic == current.magic && header.version == current.version && header.chunkHeight == current.chunkHeight &&
+			header.terrainFlags == current.terrainFlags && header.dirtDepth == current.dirtDepth && header.bedrockDepth == current.bedrockDepth;
+	}
+
+	static uint32_t fnv1a(uint32_t hash, const unsigned char* bytes, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			hash = (hash ^ bytes[i]) * 16777619u;
+		}
+		return hash;
+	}
+
+	bool seek(long long offset) {
+		#ifdef _WIN32
+		return _fseeki64(file, offset, SEEK_SET) == 0;
+		#else
+		return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+		#endif
+	}
+
+	// finds every record after the header. stops at the first one that doesn't look right, which is where the
+	// game or the pregenerator stopped partway through writing, and the next record goes over it
+	void scan() {
+		end = sizeof(FileHeader);
+		RecordHeader header;
+		while (seek(end) && fread(&header, sizeof(header), 1, file) == 1 && header.magic == RECORD_MAGIC) {
+			long long recordEnd = end + (long long)sizeof(header) + header.payloadSize;
+			if (!seek(recordEnd - 1) || fgetc(file) == EOF) {
+				break;
+			}
+			records[key(header.chunkX, header.chunkZ)] = end;
+			end = recordEnd;
+		}
+	}
+};
+#endif // WORLD_SAVE_HPP
@@ -15,6 +15,34 @@ int main() {
 	auto& window = AppGlobals::window;
 
 	try {
+		AppGlobals::world.openWorldFile();
+		resolveSeed();
+
+		if (AppGlobals::benchmarkTerrain) {
+			int mismatched = AppGlobals::world.benchmarkTerrain(32);
+			if (mismatched > 0) {
+				throw std::runtime_error(std::to_string(mismatched) + " terrain results didn't match");
+			}
+		}
+		if (AppGlobals::benchmarkRaycast) {
+			int mismatched = AppGlobals::world.benchmarkRaycast(8, 1 << 18);
+			if (mismatched > 0) {
+				throw std::runtime_error(std::to_string(mismatched) + " raycast hits didn't match");
+			}
+		}
+		if (AppGlobals::benchmarkLight) {
+			int mismatched = AppGlobals::world.benchmarkLight(8, 512);
+			if (mismatched > 0) {
+				throw std::runtime_error(std::to_string(mismatched) + " blocks were lit wrong");
+			}
+		}
+		if (AppGlobals::benchmarkCollision) {
+			int failed = benchmarkCollision();
+			if (failed > 0) {
+				throw std::runtime_error(std::to_string(failed) + " collision checks failed");
+			}
+		}
+
 		Renderer renderer;
 
 		std::array<VkClearValue, 2> clearValues{};
@@ -30,12 +58,16 @@ int main() {
 				float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 				startTime = std::chrono::high_resolution_clock::now();
 
-				if (time < 0.1f) {
-					renderer.update(time);
-					if (+window.vulkan.StartFrame(clearValues.size(), clearValues.data())) {
-						renderer.Render(time);
-						window.vulkan.EndFrame(true);
-					}
+				// a slow frame still updates and draws. the renderer's clock decides how much of it to catch up on
+				renderer.update(time);
+
+				// the sky darkens with the sky light
+				float skyLight = renderer.GetSkyLight();
+				clearValues[0].color = { (70.0f / 255) * skyLight, (160.0f / 255) * skyLight, (255.0f / 255) * skyLight, (255.0f / 255) };
+
+				if (+window.vulkan.StartFrame(clearValues.size(), clearValues.data())) {
+					renderer.Render(time);
+					window.vulkan.EndFrame(true);
 				}
 			}
 			else {
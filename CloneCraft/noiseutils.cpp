@@ -20,7 +20,18 @@
 // off every 'zig'.)
 //
 
+#include <condition_variable>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOISEUTILS_SSE2
+#endif
 
 #include <noise/interp.h>
 #include <noise/mathconsts.h>
@@ -111,6 +122,214 @@ namespace noise
 
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Row thread pool
+
+namespace noise
+{
+
+	namespace utils
+	{
+
+		// A set of worker threads that fill the rows of a noise map or an image.
+		// The threads are created the first time they're needed and kept around
+		// for the next build, so a build doesn't pay for starting threads.
+		class RowThreadPool
+		{
+
+		public:
+
+			static RowThreadPool& Get()
+			{
+				static RowThreadPool pool;
+				return pool;
+			}
+
+			~RowThreadPool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_stopping = true;
+				}
+				m_wake.notify_all();
+				for (size_t i = 0; i < m_workers.size(); i++)
+				{
+					m_workers[i].join();
+				}
+			}
+
+			// Calls fillRow once for every row, spread over threadCount threads
+			// including this one, and returns when every row is done.  Rows
+			// finish in any order, but pCallback is still called for each row in
+			// order, one call at a time.  If fillRow throws, the remaining rows
+			// are skipped and the exception is rethrown here.
+			void ForEachRow(int rowCount, int threadCount,
+							const std::function<void(int)>& fillRow, NoiseMapCallback pCallback)
+			{
+				// only one build at a time gets the workers
+				std::lock_guard<std::mutex> jobLock(m_jobMutex);
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				while ((int)m_workers.size() < threadCount - 1)
+				{
+					m_workers.push_back(std::thread(&RowThreadPool::WorkerLoop, this));
+				}
+
+				m_pFillRow = &fillRow;
+				m_pCallback = pCallback;
+				m_rowCount = rowCount;
+				m_nextRow = 0;
+				m_nextReportedRow = 0;
+				m_rowDone.assign(rowCount, false);
+				m_error = NULL;
+				m_freeSlots = threadCount - 1;
+				m_jobId++;
+				m_wake.notify_all();
+
+				m_activeThreads++;
+				FillRows(lock);
+				m_activeThreads--;
+
+				// workers that haven't woken up yet have nothing left to do
+				m_freeSlots = 0;
+				m_finished.wait(lock, [this] { return m_activeThreads == 0; });
+
+				m_pFillRow = NULL;
+				if (m_error != NULL)
+				{
+					std::exception_ptr error = m_error;
+					m_error = NULL;
+					std::rethrow_exception(error);
+				}
+			}
+
+		private:
+
+			RowThreadPool() :
+				m_activeThreads(0),
+				m_freeSlots(0),
+				m_jobId(0),
+				m_nextReportedRow(0),
+				m_nextRow(0),
+				m_pCallback(NULL),
+				m_pFillRow(NULL),
+				m_rowCount(0),
+				m_stopping(false)
+			{
+			}
+
+			void WorkerLoop()
+			{
+				unsigned int lastJobId = 0;
+				std::unique_lock<std::mutex> lock(m_mutex);
+				for (;;)
+				{
+					m_wake.wait(lock, [&] { return m_stopping || (m_jobId != lastJobId && m_freeSlots > 0); });
+					if (m_stopping)
+					{
+						return;
+					}
+
+					lastJobId = m_jobId;
+					m_freeSlots--;
+					m_activeThreads++;
+					FillRows(lock);
+					m_activeThreads--;
+					if (m_activeThreads == 0)
+					{
+						m_finished.notify_all();
+					}
+				}
+			}
+
+			// Takes rows until there are none left.  The lock is held except
+			// while a row is being filled.
+			void FillRows(std::unique_lock<std::mutex>& lock)
+			{
+				while (m_nextRow < m_rowCount && m_error == NULL)
+				{
+					int row = m_nextRow++;
+					lock.unlock();
+					try
+					{
+						(*m_pFillRow)(row);
+					}
+					catch (...)
+					{
+						lock.lock();
+						if (m_error == NULL)
+						{
+							m_error = std::current_exception();
+						}
+						continue;
+					}
+					lock.lock();
+
+					m_rowDone[row] = true;
+					while (m_nextReportedRow < m_rowCount && m_rowDone[m_nextReportedRow])
+					{
+						if (m_pCallback != NULL)
+						{
+							m_pCallback(m_nextReportedRow);
+						}
+						m_nextReportedRow++;
+					}
+				}
+			}
+
+			int m_activeThreads;
+			std::exception_ptr m_error;
+			std::condition_variable m_finished;
+			int m_freeSlots;
+			unsigned int m_jobId;
+			std::mutex m_jobMutex;
+			std::mutex m_mutex;
+			int m_nextReportedRow;
+			int m_nextRow;
+			NoiseMapCallback m_pCallback;
+			const std::function<void(int)>* m_pFillRow;
+			int m_rowCount;
+			std::vector<bool> m_rowDone;
+			bool m_stopping;
+			std::condition_variable m_wake;
+			std::vector<std::thread> m_workers;
+
+		};
+
+		// Calls fillRow for every row of a width by rowCount map, on the pool if
+		// it's big enough to be worth it and on this thread otherwise.
+		void FillRows(int width, int rowCount, int threadCount,
+					  const std::function<void(int)>& fillRow, NoiseMapCallback pCallback)
+		{
+			if (threadCount == THREAD_COUNT_ALL_CORES)
+			{
+				threadCount = (int)std::thread::hardware_concurrency();
+			}
+			if (threadCount > rowCount)
+			{
+				threadCount = rowCount;
+			}
+
+			if (threadCount <= 1 || width * rowCount < MIN_PARALLEL_POINTS)
+			{
+				for (int row = 0; row < rowCount; row++)
+				{
+					fillRow(row);
+					if (pCallback != NULL)
+					{
+						pCallback(row);
+					}
+				}
+				return;
+			}
+
+			RowThreadPool::Get().ForEachRow(rowCount, threadCount, fillRow, pCallback);
+		}
+
+	}
+
+}
+
 using namespace noise;
 
 using namespace noise::utils;
@@ -120,7 +339,9 @@ using namespace noise::utils;
 
 GradientColor::GradientColor()
 {
+	m_gradientPointCount = 0;
 	m_pGradientPoints = NULL;
+	m_isColorTableValid = false;
 }
 
 GradientColor::~GradientColor()
@@ -136,6 +357,29 @@ void GradientColor::AddGradientPoint(double gradientPos,
 	// remain sorted by gradient position.
 	int insertionPos = FindInsertionPos(gradientPos);
 	InsertAtPos(insertionPos, gradientPos, gradientColor);
+	m_isColorTableValid = false;
+}
+
+void GradientColor::BakeColorTable()
+{
+	assert(m_gradientPointCount >= 2);
+
+	if (m_isColorTableValid)
+	{
+		return;
+	}
+
+	double lowPos = m_pGradientPoints[0].pos;
+	double highPos = m_pGradientPoints[m_gradientPointCount - 1].pos;
+	double step = (highPos - lowPos) / (double)(COLOR_TABLE_SIZE - 1);
+	for (int i = 0; i < COLOR_TABLE_SIZE; i++)
+	{
+		GetColor(lowPos + step * i, m_colorTable[i]);
+	}
+
+	m_colorTableLowPos = (float)lowPos;
+	m_colorTableScale = (float)(1.0 / step);
+	m_isColorTableValid = true;
 }
 
 void GradientColor::Clear()
@@ -143,6 +387,42 @@ void GradientColor::Clear()
 	delete[] m_pGradientPoints;
 	m_pGradientPoints = NULL;
 	m_gradientPointCount = 0;
+	m_isColorTableValid = false;
+}
+
+void GradientColor::GetColorTableIndices(const float* pGradientPos,
+										 int* pIndices, int count) const
+{
+	assert(m_isColorTableValid);
+
+	// Scale each position to the table, round to the nearest entry and clamp.
+	// The clamp happens before the conversion to an integer so that far away
+	// positions can't overflow.  NaNs end up at the last entry, which is the
+	// color GetColor() gives them too.
+	const float highIndex = (float)(COLOR_TABLE_SIZE - 1);
+	int i = 0;
+
+#ifdef NOISEUTILS_SSE2
+	const __m128 lowPos = _mm_set1_ps(m_colorTableLowPos);
+	const __m128 scale = _mm_set1_ps(m_colorTableScale);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 high = _mm_set1_ps(highIndex);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 index = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pGradientPos + i), lowPos), scale), half);
+		index = _mm_max_ps(_mm_min_ps(index, high), zero);
+		_mm_storeu_si128((__m128i*)(pIndices + i), _mm_cvttps_epi32(index));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float index = (pGradientPos[i] - m_colorTableLowPos) * m_colorTableScale + 0.5f;
+		index = index < highIndex ? index : highIndex;
+		index = index > 0.0f ? index : 0.0f;
+		pIndices[i] = (int)index;
+	}
 }
 
 int GradientColor::FindInsertionPos(double gradientPos)
@@ -168,6 +448,12 @@ int GradientColor::FindInsertionPos(double gradientPos)
 }
 
 const Color& GradientColor::GetColor(double gradientPos) const
+{
+	GetColor(gradientPos, m_workingColor);
+	return m_workingColor;
+}
+
+void GradientColor::GetColor(double gradientPos, Color& color) const
 {
 	assert(m_gradientPointCount >= 2);
 
@@ -194,8 +480,8 @@ const Color& GradientColor::GetColor(double gradientPos) const
 	// now.
 	if (index0 == index1)
 	{
-		m_workingColor = m_pGradientPoints[index1].color;
-		return m_workingColor;
+		color = m_pGradientPoints[index1].color;
+		return;
 	}
 
 	// Compute the alpha value used for linear interpolation.
@@ -206,8 +492,7 @@ const Color& GradientColor::GetColor(double gradientPos) const
 	// Now perform the linear interpolation given the alpha value.
 	const Color& color0 = m_pGradientPoints[index0].color;
 	const Color& color1 = m_pGradientPoints[index1].color;
-	LinearInterpColor(color0, color1, (float)alpha, m_workingColor);
-	return m_workingColor;
+	LinearInterpColor(color0, color1, (float)alpha, color);
 }
 
 void GradientColor::InsertAtPos(int insertionPos, double gradientPos,
@@ -822,7 +1107,8 @@ NoiseMapBuilder::NoiseMapBuilder() :
 	m_destHeight(0),
 	m_destWidth(0),
 	m_pDestNoiseMap(NULL),
-	m_pSourceModule(NULL)
+	m_pSourceModule(NULL),
+	m_threadCount(1)
 {
 }
 
@@ -866,26 +1152,29 @@ void NoiseMapBuilderCylinder::Build()
 	double heightExtent = m_upperHeightBound - m_lowerHeightBound;
 	double xDelta = angleExtent / (double)m_destWidth;
 	double yDelta = heightExtent / (double)m_destHeight;
-	double curAngle = m_lowerAngleBound;
+
+	// Step through the heights up front so every row starts from the same
+	// height it would if the rows were filled one after another.
+	std::vector<double> rowHeights(m_destHeight);
 	double curHeight = m_lowerHeightBound;
+	for (int y = 0; y < m_destHeight; y++)
+	{
+		rowHeights[y] = curHeight;
+		curHeight += yDelta;
+	}
 
 	// Fill every point in the noise map with the output values from the model.
-	for (int y = 0; y < m_destHeight; y++)
+	FillRows(m_destWidth, m_destHeight, m_threadCount, [&](int y)
 	{
 		float* pDest = m_pDestNoiseMap->GetSlabPtr(y);
-		curAngle = m_lowerAngleBound;
+		double curAngle = m_lowerAngleBound;
 		for (int x = 0; x < m_destWidth; x++)
 		{
-			float curValue = (float)cylinderModel.GetValue(curAngle, curHeight);
+			float curValue = (float)cylinderModel.GetValue(curAngle, rowHeights[y]);
 			*pDest++ = curValue;
 			curAngle += xDelta;
 		}
-		curHeight += yDelta;
-		if (m_pCallback != NULL)
-		{
-			m_pCallback(y);
-		}
-	}
+	}, m_pCallback);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -924,14 +1213,23 @@ void NoiseMapBuilderPlane::Build()
 	double zExtent = m_upperZBound - m_lowerZBound;
 	double xDelta = xExtent / (double)m_destWidth;
 	double zDelta = zExtent / (double)m_destHeight;
-	double xCur = m_lowerXBound;
-	double zCur = m_lowerZBound;
 
-	// Fill every point in the noise map with the output values from the model.
+	// Step through the z coordinates up front so every row starts from the
+	// same z it would if the rows were filled one after another.
+	std::vector<double> rowZs(m_destHeight);
+	double nextZ = m_lowerZBound;
 	for (int z = 0; z < m_destHeight; z++)
+	{
+		rowZs[z] = nextZ;
+		nextZ += zDelta;
+	}
+
+	// Fill every point in the noise map with the output values from the model.
+	FillRows(m_destWidth, m_destHeight, m_threadCount, [&](int z)
 	{
 		float* pDest = m_pDestNoiseMap->GetSlabPtr(z);
-		xCur = m_lowerXBound;
+		double xCur = m_lowerXBound;
+		double zCur = rowZs[z];
 		for (int x = 0; x < m_destWidth; x++)
 		{
 			float finalValue;
@@ -955,12 +1253,7 @@ void NoiseMapBuilderPlane::Build()
 			*pDest++ = finalValue;
 			xCur += xDelta;
 		}
-		zCur += zDelta;
-		if (m_pCallback != NULL)
-		{
-			m_pCallback(z);
-		}
-	}
+	}, m_pCallback);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -998,33 +1291,38 @@ void NoiseMapBuilderSphere::Build()
 	double latExtent = m_northLatBound - m_southLatBound;
 	double xDelta = lonExtent / (double)m_destWidth;
 	double yDelta = latExtent / (double)m_destHeight;
-	double curLon = m_westLonBound;
+
+	// Step through the latitudes up front so every row starts from the same
+	// latitude it would if the rows were filled one after another.
+	std::vector<double> rowLats(m_destHeight);
 	double curLat = m_southLatBound;
+	for (int y = 0; y < m_destHeight; y++)
+	{
+		rowLats[y] = curLat;
+		curLat += yDelta;
+	}
 
 	// Fill every point in the noise map with the output values from the model.
-	for (int y = 0; y < m_destHeight; y++)
+	FillRows(m_destWidth, m_destHeight, m_threadCount, [&](int y)
 	{
 		float* pDest = m_pDestNoiseMap->GetSlabPtr(y);
-		curLon = m_westLonBound;
+		double curLon = m_westLonBound;
 		for (int x = 0; x < m_destWidth; x++)
 		{
-			float curValue = (float)sphereModel.GetValue(curLat, curLon);
+			float curValue = (float)sphereModel.GetValue(rowLats[y], curLon);
 			*pDest++ = curValue;
 			curLon += xDelta;
 		}
-		curLat += yDelta;
-		if (m_pCallback != NULL)
-		{
-			m_pCallback(y);
-		}
-	}
+	}, m_pCallback);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 // RendererImage class
 
 RendererImage::RendererImage() :
+	m_isColorTableEnabled(false),
 	m_isLightEnabled(false),
+	m_isPlainColorTableValid(false),
 	m_isWrapEnabled(false),
 	m_lightAzimuth(45.0),
 	m_lightBrightness(1.0),
@@ -1033,9 +1331,11 @@ RendererImage::RendererImage() :
 	m_lightElev(45.0),
 	m_lightIntensity(1.0),
 	m_pBackgroundImage(NULL),
+	m_pCallback(NULL),
 	m_pDestImage(NULL),
 	m_pSourceNoiseMap(NULL),
-	m_recalcLightValues(true)
+	m_recalcLightValues(true),
+	m_threadCount(1)
 {
 	BuildGrayscaleGradient();
 };
@@ -1044,6 +1344,7 @@ void RendererImage::AddGradientPoint(double gradientPos,
 									 const Color& gradientColor)
 {
 	m_gradient.AddGradientPoint(gradientPos, gradientColor);
+	m_isPlainColorTableValid = false;
 }
 
 void RendererImage::BuildGrayscaleGradient()
@@ -1122,14 +1423,7 @@ double RendererImage::CalcLightIntensity(double center, double left,
 	// Recalculate the sine and cosine of the various light values if
 	// necessary so it does not have to be calculated each time this method is
 	// called.
-	if (m_recalcLightValues)
-	{
-		m_cosAzimuth = cos(m_lightAzimuth * DEG_TO_RAD);
-		m_sinAzimuth = sin(m_lightAzimuth * DEG_TO_RAD);
-		m_cosElev = cos(m_lightElev * DEG_TO_RAD);
-		m_sinElev = sin(m_lightElev * DEG_TO_RAD);
-		m_recalcLightValues = false;
-	}
+	RecalcLightValues();
 
 	// Now do the lighting calculations.
 	const double I_MAX = 1.0;
@@ -1146,9 +1440,22 @@ double RendererImage::CalcLightIntensity(double center, double left,
 	return intensity;
 }
 
+void RendererImage::RecalcLightValues() const
+{
+	if (m_recalcLightValues)
+	{
+		m_cosAzimuth = cos(m_lightAzimuth * DEG_TO_RAD);
+		m_sinAzimuth = sin(m_lightAzimuth * DEG_TO_RAD);
+		m_cosElev = cos(m_lightElev * DEG_TO_RAD);
+		m_sinElev = sin(m_lightElev * DEG_TO_RAD);
+		m_recalcLightValues = false;
+	}
+}
+
 void RendererImage::ClearGradient()
 {
 	m_gradient.Clear();
+	m_isPlainColorTableValid = false;
 }
 
 void RendererImage::Render()
@@ -1183,7 +1490,32 @@ void RendererImage::Render()
 		m_pDestImage->SetSize(width, height);
 	}
 
-	for (int y = 0; y < height; y++)
+	// Work out the light direction and bake the color tables now so the rows
+	// only ever read them.
+	RecalcLightValues();
+
+	const Color* pColorTable = NULL;
+	bool isPlain = false;
+	if (m_isColorTableEnabled)
+	{
+		m_gradient.BakeColorTable();
+		pColorTable = m_gradient.GetColorTable();
+
+		// Without a light source or a background image, every pixel is the
+		// same blend of its color onto white, so blend the table instead.
+		isPlain = !m_isLightEnabled && m_pBackgroundImage == NULL;
+		if (isPlain && !m_isPlainColorTableValid)
+		{
+			Color white(255, 255, 255, 255);
+			for (int i = 0; i < COLOR_TABLE_SIZE; i++)
+			{
+				m_plainColorTable[i] = CalcDestColor(pColorTable[i], white, 1.0);
+			}
+			m_isPlainColorTableValid = true;
+		}
+	}
+
+	FillRows(width, height, m_threadCount, [&](int y)
 	{
 		const Color* pBackground = NULL;
 		if (m_pBackgroundImage != NULL)
@@ -1192,12 +1524,39 @@ void RendererImage::Render()
 		}
 		const float* pSource = m_pSourceNoiseMap->GetConstSlabPtr(y);
 		Color* pDest = m_pDestImage->GetSlabPtr(y);
+
+		// First find every pixel's color in the table in one go.
+		std::vector<int> colorIndices;
+		if (pColorTable != NULL)
+		{
+			colorIndices.resize(width);
+			m_gradient.GetColorTableIndices(pSource, &colorIndices[0], width);
+		}
+
+		if (isPlain)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				pDest[x] = m_plainColorTable[colorIndices[x]];
+			}
+			return;
+		}
+
+		// Then light and blend them.
 		for (int x = 0; x < width; x++)
 		{
 
 			// Get the color based on the value at the current point in the noise
 			// map.
-			Color destColor = m_gradient.GetColor(*pSource);
+			Color destColor;
+			if (pColorTable != NULL)
+			{
+				destColor = pColorTable[colorIndices[x]];
+			}
+			else
+			{
+				m_gradient.GetColor(*pSource, destColor);
+			}
 
 			// If lighting is enabled, calculate the light intensity based on the
 			// rate of change at the current point in the noise map.
@@ -1317,7 +1676,7 @@ void RendererImage::Render()
 				++pBackground;
 			}
 		}
-	}
+	}, m_pCallback);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1326,8 +1685,10 @@ void RendererImage::Render()
 RendererNormalMap::RendererNormalMap() :
 	m_bumpHeight(1.0),
 	m_isWrapEnabled(false),
+	m_pCallback(NULL),
 	m_pDestImage(NULL),
-	m_pSourceNoiseMap(NULL)
+	m_pSourceNoiseMap(NULL),
+	m_threadCount(1)
 {
 };
 
@@ -1368,7 +1729,7 @@ void RendererNormalMap::Render()
 	int width = m_pSourceNoiseMap->GetWidth();
 	int height = m_pSourceNoiseMap->GetHeight();
 
-	for (int y = 0; y < height; y++)
+	FillRows(width, height, m_threadCount, [&](int y)
 	{
 		const float* pSource = m_pSourceNoiseMap->GetConstSlabPtr(y);
 		Color* pDest = m_pDestImage->GetSlabPtr(y);
@@ -1431,5 +1792,5 @@ void RendererNormalMap::Render()
 			++pSource;
 			++pDest;
 		}
-	}
+	}, m_pCallback);
 }
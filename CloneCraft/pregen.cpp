@@ -0,0 +1,266 @@
+// Generates a world ahead of time, without a window, so the game can load the chunks from the save instead of
+// generating them while it's played. Uses every core by giving each thread its own ChunkGenerator.
+//
+//   pregen <radius> [--circle] [--center <chunkX> <chunkZ>] [--threads <n>] [--seed <n>] [--out <file>]
+//
+// Chunks already in the save are skipped, so a bigger radius only generates the ring that's new.
+#define CLONECRAFT_HEADLESS
+#include "AppGlobals.hpp"
+#include "ChunkGenerator.hpp"
+#include "WorldSave.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+struct PregenSettings {
+	int radius = 16; // in chunks, from the center chunk
+	bool circle = false; // a circle of chunks instead of a square
+	int centerX = 0;
+	int centerZ = 0;
+	int threads = 0; // 0 for one per core
+	std::string path = "world.ccw";
+};
+
+// a terrain tile's worth of chunks. a thread takes a whole tile at a time so every tile is only sampled by the
+// one thread that caches it
+struct PregenBatch {
+	int distance; // squared, in chunks, from the center to the batch's nearest chunk
+	std::vector<std::pair<int, int>> chunks;
+};
+
+// the largest the process has been, in bytes
+static unsigned long long peakMemory() {
+	#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+	#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	#ifdef __APPLE__
+	return (unsigned long long)usage.ru_maxrss;
+	#else
+	return (unsigned long long)usage.ru_maxrss * 1024;
+	#endif
+	#endif
+}
+
+static void printUsage() {
+	printf("usage: pregen <radius> [--circle] [--center <chunkX> <chunkZ>] [--threads <n>] [--seed <n>] [--out <file>]\n");
+}
+
+static bool parseSettings(int argc, char** argv, PregenSettings& settings) {
+	bool haveRadius = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--circle") {
+			settings.circle = true;
+		}
+		else if (arg == "--center" && i + 2 < argc) {
+			settings.centerX = atoi(argv[++i]);
+			settings.centerZ = atoi(argv[++i]);
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			settings.threads = atoi(argv[++i]);
+		}
+		else if (arg == "--seed" && i + 1 < argc) {
+			AppGlobals::seed = atoi(argv[++i]);
+		}
+		else if (arg == "--out" && i + 1 < argc) {
+			settings.path = argv[++i];
+		}
+		else if (!haveRadius && !arg.empty() && arg[0] != '-') {
+			settings.radius = atoi(arg.c_str());
+			haveRadius = true;
+		}
+		else {
+			return false;
+		}
+	}
+	return haveRadius && settings.radius >= 0 && settings.threads >= 0;
+}
+
+// the chunks in the radius that aren't saved yet, grouped by terrain tile and nearest tile first
+static std::vector<PregenBatch> makeBatches(const PregenSettings& settings, const WorldSave& save, int& chunkCount) {
+	int tileChunks = std::max(1, AppGlobals::terrainRegionChunks);
+	std::unordered_map<uint64_t, size_t> batchIndex;
+	std::vector<PregenBatch> batches;
+	chunkCount = 0;
+
+	for (int dx = -settings.radius; dx <= settings.radius; dx++) {
+		for (int dz = -settings.radius; dz <= settings.radius; dz++) {
+			int distance = dx * dx + dz * dz;
+			int chunkX = settings.centerX + dx;
+			int chunkZ = settings.centerZ + dz;
+			if ((settings.circle && distance > settings.radius * settings.radius) || save.Has(chunkX, chunkZ)) {
+				continue;
+			}
+
+			uint64_t tile = ((uint64_t)(uint32_t)floorDiv(chunkX, tileChunks) << 32) | (uint32_t)floorDiv(chunkZ, tileChunks);
+			auto found = batchIndex.find(tile);
+			if (found == batchIndex.end()) {
+				found = batchIndex.emplace(tile, batches.size()).first;
+				batches.push_back({ distance, {} });
+			}
+			PregenBatch& batch = batches[found->second];
+			batch.distance = std::min(batch.distance, distance);
+			batch.chunks.push_back({ chunkX, chunkZ });
+			chunkCount++;
+		}
+	}
+
+	std::stable_sort(batches.begin(), batches.end(), [](const PregenBatch& a, const PregenBatch& b) { return a.distance < b.distance; });
+	return batches;
+}
+
+int main(int argc, char** argv) {
+	PregenSettings settings;
+	if (!parseSettings(argc, argv, settings)) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	// carry on with a save's seed unless another one was asked for
+	int fileSeed;
+	if (AppGlobals::seed == -1 && WorldSave::ReadSeed(settings.path, fileSeed)) {
+		AppGlobals::seed = fileSeed;
+	}
+	resolveSeed();
+
+	WorldSave save;
+	if (!save.Open(settings.path, AppGlobals::seed)) {
+		printf("can't open %s as a save of seed %d with these terrain settings\n", settings.path.c_str(), AppGlobals::seed);
+		return EXIT_FAILURE;
+	}
+
+	int chunkCount;
+	std::vector<PregenBatch> batches = makeBatches(settings, save, chunkCount);
+	int threadCount = settings.threads > 0 ? settings.threads : std::max(1, (int)std::thread::hardware_concurrency());
+	threadCount = std::max(1, std::min(threadCount, (int)batches.size()));
+	printf("generating %d chunks in a %s of radius %d around chunk %d, %d with seed %d on %d threads (%zu already saved)\n",
+		chunkCount, settings.circle ? "circle" : "square", settings.radius, settings.centerX, settings.centerZ, AppGlobals::seed, threadCount, save.GetChunkCount());
+
+	// the threads generate and encode, and this thread writes what they finish in the order they finish it
+	std::atomic<size_t> nextBatch(0);
+	std::mutex recordMutex;
+	std::condition_variable recordReady;
+	std::deque<std::vector<unsigned char>> records;
+	int finishedThreads = 0;
+	std::vector<GenerationStats> threadStats(threadCount);
+	std::vector<double> encodeMilliseconds(threadCount, 0.0);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; t++) {
+		threads.push_back(std::thread([&, t]() {
+			ChunkGenerator generator;
+			std::vector<DecorationBlock> outgoing;
+			std::vector<unsigned char> record;
+
+			for (size_t b = nextBatch++; b < batches.size(); b = nextBatch++) {
+				for (auto& position : batches[b].chunks) {
+					std::unique_ptr<Chunk> chunk(new Chunk(Vec4((float)position.first, 0.f, (float)position.second, 0.f)));
+					generator.Generate(*chunk, outgoing);
+
+					auto encodeStart = std::chrono::high_resolution_clock::now();
+					WorldSave::Encode(*chunk, outgoing, record);
+					encodeMilliseconds[t] += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - encodeStart).count();
+
+					std::lock_guard<std::mutex> lock(recordMutex);
+					records.push_back(std::move(record));
+					record.clear();
+					recordReady.notify_one();
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(recordMutex);
+			threadStats[t] = generator.stats;
+			finishedThreads++;
+			recordReady.notify_one();
+		}));
+	}
+
+	int written = 0;
+	double writeMilliseconds = 0;
+	bool writeFailed = false;
+	auto lastReport = startTime;
+	std::vector<std::vector<unsigned char>> writing;
+	for (;;) {
+		bool done;
+		{
+			std::unique_lock<std::mutex> lock(recordMutex);
+			recordReady.wait_for(lock, std::chrono::milliseconds(250), [&] { return !records.empty() || finishedThreads == threadCount; });
+			writing.assign(std::make_move_iterator(records.begin()), std::make_move_iterator(records.end()));
+			records.clear();
+			done = finishedThreads == threadCount && writing.empty();
+		}
+
+		auto writeStart = std::chrono::high_resolution_clock::now();
+		for (auto& record : writing) {
+			writeFailed |= !save.Append(record);
+			written++;
+		}
+		auto now = std::chrono::high_resolution_clock::now();
+		writeMilliseconds += std::chrono::duration<double, std::milli>(now - writeStart).count();
+
+		if (done || now - lastReport > std::chrono::milliseconds(500)) {
+			double seconds = std::chrono::duration<double>(now - startTime).count();
+			printf("\r  %d / %d chunks  %.1f%%  %.1f chunks/s   ", written, chunkCount, chunkCount ? 100.0 * written / chunkCount : 100.0, seconds > 0 ? written / seconds : 0.0);
+			fflush(stdout);
+			lastReport = now;
+		}
+		if (done) {
+			break;
+		}
+	}
+	printf("\n");
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	save.Close();
+
+	GenerationStats stats;
+	double encode = 0;
+	for (int t = 0; t < threadCount; t++) {
+		stats.add(threadStats[t]);
+		encode += encodeMilliseconds[t];
+	}
+	double perChunk = stats.chunks ? 1.0 / stats.chunks : 0.0;
+
+	printf("pregen: %llu chunks in %.2f s, %.1f chunks/s\n", stats.chunks, seconds, seconds > 0 ? stats.chunks / seconds : 0.0);
+	printf("  time spent on each stage, added up over every thread:\n");
+	printf("  terrain:     %10.1f ms  %7.3f ms/chunk\n", stats.terrainMilliseconds, stats.terrainMilliseconds * perChunk);
+	printf("  fill:        %10.1f ms  %7.3f ms/chunk\n", stats.fillMilliseconds, stats.fillMilliseconds * perChunk);
+	printf("  caves:       %10.1f ms  %7.3f ms/chunk\n", stats.caveMilliseconds, stats.caveMilliseconds * perChunk);
+	printf("  decorations: %10.1f ms  %7.3f ms/chunk\n", stats.decorationMilliseconds, stats.decorationMilliseconds * perChunk);
+	printf("  encode:      %10.1f ms  %7.3f ms/chunk\n", encode, encode * perChunk);
+	printf("  write:       %10.1f ms  %7.3f ms/chunk  (on the main thread)\n", writeMilliseconds, writeMilliseconds * perChunk);
+	printf("  peak memory: %.1f MB\n", peakMemory() / (1024.0 * 1024.0));
+
+	if (writeFailed) {
+		printf("couldn't write every chunk to %s\n", settings.path.c_str());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,432 @@
+// Draws a top-down map of a world as png tiles, from a save made by pregen or straight from the generator. Level 0
+// is a pixel to a block and every level after it is half the size, so the map can be zoomed like a web map.
+//
+//   worldmap --out <folder> [--save <file>] [<radius>] [--circle] [--center <chunkX> <chunkZ>] [--levels <n>]
+//            [--threads <n>] [--seed <n>] [--full] [--noise <file.bmp>]
+//
+// With a save the map covers every saved chunk, or just the ones in the radius if there is one. Without a save the
+// chunks in the radius are generated. Tiles go to <folder>/<level>/<x>_<z>.png and are written as they're done, so
+// only a tile or so per thread is ever in memory however big the map is.
+//
+// The folder keeps a manifest of what every level 0 tile was drawn from. Running again only draws the tiles whose
+// chunks changed since, or that weren't there, and the tiles above them. --full draws everything again.
+//
+// --noise also draws the height noise under the whole map into one bmp, to see the lay of the land without biomes,
+// caves or anything built on it. it's drawn at a pixel a block, or a pixel for a few blocks if that would be too big.
+#define CLONECRAFT_HEADLESS
+#include "AppGlobals.hpp"
+#include "MapRenderer.hpp"
+#include "WorldSave.hpp"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+struct WorldMapSettings {
+	std::string out;
+	std::string savePath; // empty to generate
+	MapRegion region;
+	int levels = 0; // 0 for enough that the top level is a tile or two across
+	int threads = 0; // 0 for one per core
+	bool full = false;
+	std::string noisePath; // empty for no noise preview
+};
+
+typedef std::pair<int, int> TileCoords;
+
+static const int MANIFEST_VERSION = 1; // bump when tiles are drawn differently, to draw them all again
+static const int MAX_NOISE_PIXELS = 8192; // widest the noise preview gets before it drops to a pixel for several blocks
+
+static void makeDirectory(const std::string& path) {
+	#ifdef _WIN32
+	_mkdir(path.c_str());
+	#else
+	mkdir(path.c_str(), 0755);
+	#endif
+}
+
+static std::string tilePath(const std::string& out, int level, TileCoords tile) {
+	return out + "/" + std::to_string(level) + "/" + std::to_string(tile.first) + "_" + std::to_string(tile.second) + ".png";
+}
+
+static bool fileExists(const std::string& path) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file) {
+		fclose(file);
+	}
+	return file != nullptr;
+}
+
+// calls work(i, thread) for i from 0 to count - 1 spread over threadCount threads
+static void forEachParallel(size_t count, int threadCount, const std::function<void(size_t, int)>& work) {
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; t++) {
+		threads.push_back(std::thread([&, t]() {
+			for (size_t i = next++; i < count; i = next++) {
+				work(i, t);
+			}
+		}));
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+// everything that decides what the whole map looks like. a manifest written with a different one is thrown out
+static std::string manifestHeader(const WorldMapSettings& settings) {
+	char header[256];
+	snprintf(header, sizeof(header), "worldmap %d seed %d %s density %d biomes %d caves %d dirt %d bedrock %d", MANIFEST_VERSION, AppGlobals::seed,
+		settings.savePath.empty() ? "generated" : "saved", (int)AppGlobals::densityTerrain, (int)AppGlobals::biomes, (int)AppGlobals::caves, AppGlobals::dirtDepth, AppGlobals::bedrockDepth);
+	return header;
+}
+
+static std::map<TileCoords, uint32_t> readManifest(const std::string& path, const std::string& header) {
+	std::map<TileCoords, uint32_t> tiles;
+	FILE* file = fopen(path.c_str(), "r");
+	if (!file) {
+		return tiles;
+	}
+
+	char line[256];
+	if (fgets(line, sizeof(line), file) && header + "\n" == line) {
+		int tileX, tileZ;
+		unsigned int fingerprint;
+		while (fscanf(file, "%d %d %u", &tileX, &tileZ, &fingerprint) == 3) {
+			tiles[{ tileX, tileZ }] = fingerprint;
+		}
+	}
+	fclose(file);
+	return tiles;
+}
+
+// written to the side and moved over the old one, so stopping partway never leaves half a manifest
+static bool writeManifest(const std::string& path, const std::string& header, const std::map<TileCoords, uint32_t>& tiles) {
+	std::string temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "w");
+	if (!file) {
+		return false;
+	}
+	fprintf(file, "%s\n", header.c_str());
+	for (auto& tile : tiles) {
+		fprintf(file, "%d %d %u\n", tile.first.first, tile.first.second, tile.second);
+	}
+	fclose(file);
+	remove(path.c_str());
+	return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+static void printUsage() {
+	printf("usage: worldmap --out <folder> [--save <file>] [<radius>] [--circle] [--center <chunkX> <chunkZ>] [--levels <n>] [--threads <n>] [--seed <n>] [--full] [--noise <file.bmp>]\n");
+}
+
+static bool parseSettings(int argc, char** argv, WorldMapSettings& settings) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--out" && i + 1 < argc) {
+			settings.out = argv[++i];
+		}
+		else if (arg == "--save" && i + 1 < argc) {
+			settings.savePath = argv[++i];
+		}
+		else if (arg == "--circle") {
+			settings.region.circle = true;
+		}
+		else if (arg == "--center" && i + 2 < argc) {
+			settings.region.centerX = atoi(argv[++i]);
+			settings.region.centerZ = atoi(argv[++i]);
+		}
+		else if (arg == "--levels" && i + 1 < argc) {
+			settings.levels = atoi(argv[++i]);
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			settings.threads = atoi(argv[++i]);
+		}
+		else if (arg == "--seed" && i + 1 < argc) {
+			AppGlobals::seed = atoi(argv[++i]);
+		}
+		else if (arg == "--full") {
+			settings.full = true;
+		}
+		else if (arg == "--noise" && i + 1 < argc) {
+			settings.noisePath = argv[++i];
+		}
+		else if (settings.region.radius < 0 && !arg.empty() && arg[0] != '-') {
+			settings.region.radius = atoi(arg.c_str());
+		}
+		else {
+			return false;
+		}
+	}
+	// the generator needs to know where to stop
+	bool bounded = !settings.savePath.empty() || settings.region.radius >= 0;
+	return !settings.out.empty() && bounded && settings.levels >= 0 && settings.threads >= 0;
+}
+
+int main(int argc, char** argv) {
+	WorldMapSettings settings;
+	if (!parseSettings(argc, argv, settings)) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	if (!settings.savePath.empty()) {
+		int fileSeed;
+		if (!WorldSave::ReadSeed(settings.savePath, fileSeed)) {
+			printf("%s isn't a save made with these terrain settings\n", settings.savePath.c_str());
+			return EXIT_FAILURE;
+		}
+		AppGlobals::seed = fileSeed;
+	}
+	resolveSeed();
+
+	int threadCount = settings.threads > 0 ? settings.threads : std::max(1, (int)std::thread::hardware_concurrency());
+
+	// every thread reads the save through its own handle
+	std::vector<std::unique_ptr<WorldSave>> saves;
+	std::vector<std::unique_ptr<MapRenderer>> renderers;
+	for (int t = 0; t < threadCount; t++) {
+		WorldSave* save = nullptr;
+		if (!settings.savePath.empty()) {
+			saves.emplace_back(new WorldSave());
+			save = saves.back().get();
+			if (!save->Open(settings.savePath, AppGlobals::seed)) {
+				printf("can't open %s\n", settings.savePath.c_str());
+				return EXIT_FAILURE;
+			}
+		}
+		renderers.emplace_back(new MapRenderer(save, settings.region));
+	}
+
+	// the level 0 tiles with anything in them, and the ones that had something last time
+	std::set<TileCoords> tiles;
+	const int T = MapRenderer::TILE_CHUNKS;
+	if (saves.empty()) {
+		const MapRegion& region = settings.region;
+		for (int chunkX = region.centerX - region.radius; chunkX <= region.centerX + region.radius; chunkX++) {
+			for (int chunkZ = region.centerZ - region.radius; chunkZ <= region.centerZ + region.radius; chunkZ++) {
+				if (region.Contains(chunkX, chunkZ)) {
+					tiles.insert({ floorDiv(chunkX, T), floorDiv(chunkZ, T) });
+				}
+			}
+		}
+	}
+	else {
+		std::vector<std::pair<int, int>> chunks;
+		saves[0]->GetChunks(chunks);
+		for (auto& chunk : chunks) {
+			if (settings.region.Contains(chunk.first, chunk.second)) {
+				tiles.insert({ floorDiv(chunk.first, T), floorDiv(chunk.second, T) });
+			}
+		}
+	}
+
+	std::string manifestPath = settings.out + "/manifest.txt";
+	std::string header = manifestHeader(settings);
+	std::map<TileCoords, uint32_t> oldManifest;
+	if (!settings.full) {
+		oldManifest = readManifest(manifestPath, header);
+	}
+	for (auto& tile : oldManifest) {
+		tiles.insert(tile.first);
+	}
+	if (tiles.empty()) {
+		printf("nothing to draw\n");
+		return EXIT_FAILURE;
+	}
+
+	int levels = settings.levels;
+	if (levels == 0) {
+		int lowX = tiles.begin()->first, highX = lowX, lowZ = tiles.begin()->second, highZ = lowZ;
+		for (auto& tile : tiles) {
+			lowX = std::min(lowX, tile.first);
+			highX = std::max(highX, tile.first);
+			lowZ = std::min(lowZ, tile.second);
+			highZ = std::max(highZ, tile.second);
+		}
+		int span = std::max(highX - lowX, highZ - lowZ) + 1;
+		levels = 1;
+		while ((1 << (levels - 1)) < span) {
+			levels++;
+		}
+	}
+
+	makeDirectory(settings.out);
+	for (int level = 0; level < levels; level++) {
+		makeDirectory(settings.out + "/" + std::to_string(level));
+	}
+	printf("drawing a map of %s with seed %d into %s, %d levels on %d threads\n",
+		settings.savePath.empty() ? "generated chunks" : settings.savePath.c_str(), AppGlobals::seed, settings.out.c_str(), levels, threadCount);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	// level 0 from chunks. a tile whose fingerprint hasn't changed and is still on disk is left alone
+	std::vector<TileCoords> levelTiles(tiles.begin(), tiles.end());
+	std::vector<uint32_t> fingerprints(levelTiles.size());
+	std::vector<unsigned char> changed(levelTiles.size(), 0);
+	std::atomic<int> drawn(0), removed(0);
+	forEachParallel(levelTiles.size(), threadCount, [&](size_t i, int t) {
+		TileCoords tile = levelTiles[i];
+		std::string path = tilePath(settings.out, 0, tile);
+		uint32_t fingerprint = renderers[t]->Fingerprint(tile.first, tile.second);
+		fingerprints[i] = fingerprint;
+
+		auto old = oldManifest.find(tile);
+		if (fingerprint != 0 && old != oldManifest.end() && old->second == fingerprint && fileExists(path)) {
+			return;
+		}
+		changed[i] = 1;
+
+		std::vector<unsigned char> rgba;
+		if (fingerprint != 0 && renderers[t]->RenderTile(tile.first, tile.second, rgba)) {
+			stbi_write_png(path.c_str(), MapRenderer::TILE_PIXELS, MapRenderer::TILE_PIXELS, 4, rgba.data(), MapRenderer::TILE_PIXELS * 4);
+			drawn++;
+		}
+		else {
+			fingerprints[i] = 0;
+			remove(path.c_str());
+			removed++;
+		}
+	});
+
+	std::map<TileCoords, uint32_t> manifest;
+	std::set<TileCoords> dirty;
+	for (size_t i = 0; i < levelTiles.size(); i++) {
+		if (fingerprints[i] != 0) {
+			manifest[levelTiles[i]] = fingerprints[i];
+		}
+		if (changed[i]) {
+			dirty.insert(levelTiles[i]);
+		}
+	}
+	auto levelTime = std::chrono::high_resolution_clock::now();
+	printf("  level 0: %d tiles drawn, %d removed, %zu unchanged  %.2f s\n", drawn.load(), removed.load(), levelTiles.size() - drawn - removed, std::chrono::duration<double>(levelTime - startTime).count());
+	long long pixels = (long long)drawn * MapRenderer::TILE_PIXELS * MapRenderer::TILE_PIXELS;
+
+	// every level after is drawn from the four tiles under it, read back from disk, so it's only ever redrawn
+	// when one of those changed or it's missing
+	for (int level = 1; level < levels; level++) {
+		std::set<TileCoords> parents;
+		for (auto& tile : levelTiles) {
+			parents.insert({ floorDiv(tile.first, 2), floorDiv(tile.second, 2) });
+		}
+		std::set<TileCoords> parentsDirty;
+		for (auto& tile : dirty) {
+			parentsDirty.insert({ floorDiv(tile.first, 2), floorDiv(tile.second, 2) });
+		}
+		levelTiles.assign(parents.begin(), parents.end());
+		changed.assign(levelTiles.size(), 0);
+		drawn = 0;
+		removed = 0;
+
+		forEachParallel(levelTiles.size(), threadCount, [&](size_t i, int t) {
+			TileCoords tile = levelTiles[i];
+			std::string path = tilePath(settings.out, level, tile);
+			if (!parentsDirty.count(tile) && fileExists(path)) {
+				return;
+			}
+			changed[i] = 1;
+
+			unsigned char* children[4] = {};
+			bool any = false;
+			for (int child = 0; child < 4; child++) {
+				TileCoords childTile(tile.first * 2 + (child & 1), tile.second * 2 + (child >> 1));
+				int width, height, channels;
+				children[child] = stbi_load(tilePath(settings.out, level - 1, childTile).c_str(), &width, &height, &channels, 4);
+				if (children[child] && (width != MapRenderer::TILE_PIXELS || height != MapRenderer::TILE_PIXELS)) {
+					stbi_image_free(children[child]);
+					children[child] = nullptr;
+				}
+				any |= children[child] != nullptr;
+			}
+
+			if (any) {
+				std::vector<unsigned char> rgba;
+				MapRenderer::Downsample(children, rgba);
+				stbi_write_png(path.c_str(), MapRenderer::TILE_PIXELS, MapRenderer::TILE_PIXELS, 4, rgba.data(), MapRenderer::TILE_PIXELS * 4);
+				drawn++;
+			}
+			else {
+				remove(path.c_str());
+				removed++;
+			}
+			for (int child = 0; child < 4; child++) {
+				stbi_image_free(children[child]);
+			}
+		});
+
+		dirty.clear();
+		for (size_t i = 0; i < levelTiles.size(); i++) {
+			if (changed[i]) {
+				dirty.insert(levelTiles[i]);
+			}
+		}
+		auto now = std::chrono::high_resolution_clock::now();
+		printf("  level %d: %d tiles drawn, %d removed, %zu unchanged  %.2f s\n", level, drawn.load(), removed.load(), levelTiles.size() - drawn - removed, std::chrono::duration<double>(now - levelTime).count());
+		levelTime = now;
+		pixels += (long long)drawn * MapRenderer::TILE_PIXELS * MapRenderer::TILE_PIXELS;
+	}
+
+	if (!writeManifest(manifestPath, header, manifest)) {
+		printf("couldn't write %s\n", manifestPath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	if (!settings.noisePath.empty()) {
+		int lowX = tiles.begin()->first, highX = lowX, lowZ = tiles.begin()->second, highZ = lowZ;
+		for (auto& tile : tiles) {
+			lowX = std::min(lowX, tile.first);
+			highX = std::max(highX, tile.first);
+			lowZ = std::min(lowZ, tile.second);
+			highZ = std::max(highZ, tile.second);
+		}
+		int chunksWide = (highX - lowX + 1) * T;
+		int chunksHigh = (highZ - lowZ + 1) * T;
+		int blocksPerPixel = 1;
+		while (std::max(chunksWide, chunksHigh) * AppGlobals::CHUNK_WIDTH / blocksPerPixel > MAX_NOISE_PIXELS) {
+			blocksPerPixel *= 2;
+		}
+
+		// the noise module is safe to share, so this one uses every core too
+		TerrainGenerator terrain;
+		utils::Image preview;
+		terrain.RenderNoisePreview(lowX * T, lowZ * T, chunksWide, chunksHigh, blocksPerPixel, settings.threads > 0 ? settings.threads : utils::THREAD_COUNT_ALL_CORES, preview);
+
+		utils::WriterBMP writer;
+		writer.SetSourceImage(preview);
+		writer.SetDestFilename(settings.noisePath);
+		try {
+			writer.WriteDestFile();
+		}
+		catch (...) {
+			printf("couldn't write %s\n", settings.noisePath.c_str());
+			return EXIT_FAILURE;
+		}
+		printf("  noise preview written to %s, a pixel for every %d blocks\n", settings.noisePath.c_str(), blocksPerPixel);
+	}
+
+	unsigned long long loaded = 0, generated = 0;
+	for (auto& renderer : renderers) {
+		loaded += renderer->loadedChunks;
+		generated += renderer->generatedChunks;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	printf("worldmap: %.1f megapixels in %.2f s, %.1f megapixels/s. %llu chunks loaded, %llu generated\n", pixels / 1e6, seconds, seconds > 0 ? pixels / 1e6 / seconds : 0.0, loaded, generated);
+	return EXIT_SUCCESS;
+}